@@ -0,0 +1,33 @@
+#include <stdlib.h>
+#include <string.h>
+
+// Allocation counter for profiling. The linker redirects malloc/calloc/realloc/strdup
+// calls made from our objects here (-Wl,--wrap=..., see CMakeLists.txt); libc internals
+// are not counted.
+
+long g_alloc_count = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_strdup(s);
+}
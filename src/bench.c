@@ -0,0 +1,400 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+// Microbenchmarks for the scanner's hot kernels, on in-memory inputs.
+// Allocations are counted by the linker-wrapped allocators of alloc_count.c.
+
+#define BENCH_NUM_BINS 200
+#define BENCH_BCACHE_ENTRIES 200
+#define BENCH_RUNS 5
+
+// Shared inputs, built once before timing
+typedef struct {
+    long nframes;
+    char *timing_text;
+    size_t timing_len;
+    double *ts_constant;
+    double *ts_raw;
+    char *cache_text;
+    size_t cache_text_len;
+    BinaryCache *bcache;
+    char *bcache_buf;
+    size_t bcache_len;
+    long bcache_frames;
+    char *header_text;
+    size_t header_len;
+    int header_cards;
+    Stream stream;
+    FILE *devnull;
+} BenchInputs;
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    void (*fn)(BenchInputs *in);
+    double items;   // items (frames, cards, bins) per op
+    double bytes;   // bytes processed per op
+} Benchmark;
+
+typedef struct {
+    char name[64];
+    char unit[16];
+    double ns_per_item;
+    double mb_per_s;
+    double allocs_per_op;
+} BenchResult;
+
+double bench_rng_state = 0.5;
+
+// Deterministic jitter source (logistic map), so inputs are identical across runs
+double bench_jitter() {
+    bench_rng_state = 3.99 * bench_rng_state * (1.0 - bench_rng_state);
+    return bench_rng_state - 0.5;
+}
+
+void build_inputs(BenchInputs *in, long nframes) {
+    memset(in, 0, sizeof(*in));
+    in->nframes = nframes;
+
+    // Timing file text in the logshmim column layout
+    size_t cap = 1024 + (size_t)nframes * 128;
+    in->timing_text = malloc(cap);
+    size_t len = 0;
+    len += snprintf(in->timing_text + len, cap - len,
+                    "# Telemetry stream timing data \n# \n# col1 : datacube frame index\n# col2 : Main index\n"
+                    "# col3 : Time since cube origin (logging)\n# col4 : Absolute time (logging)\n"
+                    "# col5 : Absolute time (acquisition)\n# col6 : stream cnt0 index\n# col7 : stream cnt1 index\n# \n");
+    in->ts_constant = malloc(nframes * sizeof(double));
+    in->ts_raw = malloc(nframes * sizeof(double));
+    double t0 = 1762424400.509073;
+    for (long k = 0; k < nframes; k++) {
+        double t = t0 + k * 0.0004;
+        in->ts_constant[k] = t;
+        in->ts_raw[k] = t + 0.0002 * bench_jitter();
+        len += snprintf(in->timing_text + len, cap - len, "%10ld  %10ld  %15.9f   %20.9f  %17.6f   %10ld   %10ld\n",
+                        k, 7196847 + k, k * 0.0004, t + 0.0003, t, 7196847 + k, 0L);
+    }
+    in->timing_len = len;
+
+    // Text cache of a RAW summary
+    FileSummary raw = {.is_constant = 0, .count = nframes, .start = in->ts_raw[0], .end = in->ts_raw[nframes - 1],
+                       .timestamps = in->ts_raw};
+    FILE *ms = open_memstream(&in->cache_text, &in->cache_text_len);
+    write_cache_fp(ms, &raw);
+    fclose(ms);
+
+    // Night binary cache: 3/4 constant-rate entries, 1/4 RAW entries
+    in->bcache = calloc(1, sizeof(BinaryCache));
+    in->bcache->capacity = BENCH_BCACHE_ENTRIES;
+    in->bcache->entries = calloc(BENCH_BCACHE_ENTRIES, sizeof(BinaryCacheEntry));
+    for (int i = 0; i < BENCH_BCACHE_ENTRIES; i++) {
+        BinaryCacheEntry *e = &in->bcache->entries[i];
+        char key[64];
+        snprintf(key, sizeof(key), "stream%02d/stream%02d_10:%02d:%02d.000000000.txt", i % 4, i % 4, (i / 60) % 60, i % 60);
+        e->key = strdup(key);
+        e->summary.count = nframes;
+        e->summary.start = in->ts_constant[0] + i * nframes * 0.0004;
+        e->summary.end = e->summary.start + (nframes - 1) * 0.0004;
+        if (i % 4 == 3) {
+            e->summary.timestamps = malloc(nframes * sizeof(double));
+            memcpy(e->summary.timestamps, in->ts_raw, nframes * sizeof(double));
+        } else {
+            e->summary.is_constant = 1;
+        }
+        in->bcache_frames += nframes;
+    }
+    in->bcache->count = BENCH_BCACHE_ENTRIES;
+    ms = open_memstream(&in->bcache_buf, &in->bcache_len);
+    write_binary_cache_fp(ms, in->bcache);
+    fclose(ms);
+
+    // Sidecar header: 415 cards, 80 characters + newline each
+    in->header_cards = 415;
+    in->header_text = malloc((size_t)in->header_cards * 81 + 1);
+    char *h = in->header_text;
+    for (int c = 0; c < in->header_cards; c++) {
+        char card[96];
+        if (c == 200) {
+            snprintf(card, sizeof(card), "OBJECT  = 'ABAUR   '           / Target name");
+        } else {
+            snprintf(card, sizeof(card), "D_K%04d =            %9.5f / [mm] Synthetic keyword %d", c, c * 0.125, c);
+        }
+        memset(h, ' ', 80);
+        memcpy(h, card, strlen(card) < 80 ? strlen(card) : 80);
+        h[80] = '\n';
+        h += 81;
+    }
+    in->header_len = h - in->header_text;
+
+    // Stream with a filled timeline for rendering
+    strcpy(in->stream.name, "apapane");
+    in->stream.total_frames = nframes;
+    in->stream.bins = calloc(BENCH_NUM_BINS, sizeof(int));
+    for (int b = 0; b < BENCH_NUM_BINS; b++) {
+        in->stream.bins[b] = (b % 17 == 0) ? 0 : 1000 + b;
+        if (in->stream.bins[b] > in->stream.max_bin_count) in->stream.max_bin_count = in->stream.bins[b];
+    }
+    in->devnull = fopen("/dev/null", "w");
+
+    // Keyword tracking state for header scanning
+    memset(&kscan_ctx, 0, sizeof(kscan_ctx));
+    strcpy(kscan_ctx.target_key_pattern, "OBJECT");
+    regcomp(&kscan_ctx.key_regex, kscan_ctx.target_key_pattern, REG_EXTENDED | REG_NOSUB);
+    init_report(&kscan_ctx.report);
+}
+
+void bench_parse_timing(BenchInputs *in) {
+    TimingParser parser;
+    timing_parser_init(&parser);
+    for (size_t off = 0; off < in->timing_len; off += 65536) {
+        size_t n = in->timing_len - off < 65536 ? in->timing_len - off : 65536;
+        timing_parser_feed(&parser, in->timing_text + off, n);
+    }
+    timing_parser_finish(&parser);
+    free(parser.timestamps);
+}
+
+void bench_detect_constant(BenchInputs *in) {
+    volatile int c = detect_constant_rate(in->ts_constant, in->nframes);
+    (void)c;
+}
+
+void bench_cache_text_encode(BenchInputs *in) {
+    FileSummary raw = {.is_constant = 0, .count = in->nframes, .start = in->ts_raw[0], .end = in->ts_raw[in->nframes - 1],
+                       .timestamps = in->ts_raw};
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *ms = open_memstream(&buf, &len);
+    write_cache_fp(ms, &raw);
+    fclose(ms);
+    free(buf);
+}
+
+void bench_cache_text_decode(BenchInputs *in) {
+    FILE *fp = fmemopen(in->cache_text, in->cache_text_len, "r");
+    FileSummary summary;
+    if (read_cache_fp(fp, &summary) && summary.timestamps) free(summary.timestamps);
+    fclose(fp);
+}
+
+void bench_cache_binary_encode(BenchInputs *in) {
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *ms = open_memstream(&buf, &len);
+    write_binary_cache_fp(ms, in->bcache);
+    fclose(ms);
+    free(buf);
+}
+
+void bench_cache_binary_decode(BenchInputs *in) {
+    FILE *fp = fmemopen(in->bcache_buf, in->bcache_len, "r");
+    BinaryCache *cache = calloc(1, sizeof(BinaryCache));
+    read_binary_cache_fp(fp, cache);
+    fclose(fp);
+    free_binary_cache(cache);
+}
+
+void bench_bin_constant(BenchInputs *in) {
+    int bins[BENCH_NUM_BINS] = {0};
+    int max_bin_count = 0;
+    FileSummary summary = {.is_constant = 1, .count = in->nframes, .start = in->ts_constant[0],
+                           .end = in->ts_constant[in->nframes - 1]};
+    bin_summary(&summary, in->ts_constant[0] - 0.1, in->ts_constant[in->nframes - 1] + 0.1, BENCH_NUM_BINS, bins, &max_bin_count);
+}
+
+void bench_bin_raw(BenchInputs *in) {
+    int bins[BENCH_NUM_BINS] = {0};
+    int max_bin_count = 0;
+    FileSummary summary = {.is_constant = 0, .count = in->nframes, .start = in->ts_raw[0],
+                           .end = in->ts_raw[in->nframes - 1], .timestamps = in->ts_raw};
+    bin_summary(&summary, in->ts_raw[0] - 0.1, in->ts_raw[in->nframes - 1] + 0.1, BENCH_NUM_BINS, bins, &max_bin_count);
+}
+
+void bench_header_scan(BenchInputs *in) {
+    process_header_buffer_for_key(in->header_text, in->header_len, "bench.fits.header", "apapane", 1762424400.0);
+}
+
+void bench_render_row(BenchInputs *in) {
+    render_stream_row(in->devnull, &in->stream, 10, 8, 0.5, BENCH_NUM_BINS);
+}
+
+void run_benchmark(const Benchmark *b, BenchInputs *in, double min_time, BenchResult *r) {
+    // Calibrate batch size to about min_time / BENCH_RUNS per run
+    long iters = 1;
+    for (;;) {
+        double t0 = get_current_time();
+        for (long i = 0; i < iters; i++) b->fn(in);
+        double elapsed = get_current_time() - t0;
+        if (elapsed >= min_time / BENCH_RUNS / 4 || iters >= (1L << 30)) {
+            if (elapsed > 0) iters = (long)(iters * (min_time / BENCH_RUNS) / elapsed) + 1;
+            break;
+        }
+        iters *= 4;
+    }
+
+    double best = -1.0;
+    long allocs = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        long a0 = g_alloc_count;
+        double t0 = get_current_time();
+        for (long i = 0; i < iters; i++) b->fn(in);
+        double per_op = (get_current_time() - t0) / iters;
+        allocs = g_alloc_count - a0;
+        if (best < 0 || per_op < best) best = per_op;
+    }
+
+    strncpy(r->name, b->name, sizeof(r->name) - 1);
+    strncpy(r->unit, b->unit, sizeof(r->unit) - 1);
+    r->ns_per_item = best * 1e9 / b->items;
+    r->mb_per_s = (best > 0) ? b->bytes / best / 1e6 : 0.0;
+    r->allocs_per_op = (double)allocs / iters;
+}
+
+void write_results_json(const char *path, const BenchResult *results, int n, long nframes) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write %s: %s\n", path, strerror(errno));
+        return;
+    }
+    fprintf(fp, "{\n  \"frames_per_file\": %ld,\n  \"benchmarks\": [\n", nframes);
+    for (int i = 0; i < n; i++) {
+        fprintf(fp, "    {\"name\": \"%s\", \"unit\": \"%s\", \"ns_per_item\": %.4f, \"mb_per_s\": %.2f, \"allocs_per_op\": %.2f}%s\n",
+                results[i].name, results[i].unit, results[i].ns_per_item, results[i].mb_per_s,
+                results[i].allocs_per_op, (i + 1 < n) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+}
+
+// Reads the format written by write_results_json (one benchmark object per line)
+int read_results_json(const char *path, BenchResult *results, int max_results) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[1024];
+    int n = 0;
+    while (n < max_results && fgets(line, sizeof(line), fp)) {
+        char *obj = strstr(line, "{\"name\"");
+        if (!obj) continue;
+        BenchResult *r = &results[n];
+        memset(r, 0, sizeof(*r));
+        if (sscanf(obj, "{\"name\": \"%63[^\"]\", \"unit\": \"%15[^\"]\", \"ns_per_item\": %lf, \"mb_per_s\": %lf, \"allocs_per_op\": %lf",
+                   r->name, r->unit, &r->ns_per_item, &r->mb_per_s, &r->allocs_per_op) == 5) {
+            n++;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+void print_help(const char *progname) {
+    fprintf(stderr, "Usage: %s [options]\n", progname);
+    fprintf(stderr, "\nMicrobenchmarks of the scanner kernels on in-memory inputs.\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -filter <TEXT>        Only run benchmarks whose name contains <TEXT>.\n");
+    fprintf(stderr, "  -frames <N>           Frames per synthetic timing file (default 5000).\n");
+    fprintf(stderr, "  -time <S>             Approximate measurement time per benchmark in seconds (default 0.5).\n");
+    fprintf(stderr, "  -json <FILE>          Write results as JSON (use as a baseline for -compare).\n");
+    fprintf(stderr, "  -compare <FILE>       Compare with a baseline JSON; exit status 1 on regression.\n");
+    fprintf(stderr, "  -threshold <F>        Relative slowdown counted as regression (default 0.10).\n");
+    fprintf(stderr, "  -h, --help            Show this help message.\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    const char *json_path = NULL;
+    const char *compare_path = NULL;
+    double threshold = 0.10;
+    double min_time = 0.5;
+    long nframes = 5000;
+
+    for (int i = 1; i < argc; i++) {
+        const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (!next) {
+            print_help(argv[0]);
+            return 1;
+        } else if (strcmp(argv[i], "-filter") == 0) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "-frames") == 0) {
+            nframes = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-time") == 0) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-json") == 0) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "-compare") == 0) {
+            compare_path = argv[++i];
+        } else if (strcmp(argv[i], "-threshold") == 0) {
+            threshold = atof(argv[++i]);
+        } else {
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    if (nframes < 3) nframes = 3;
+
+    BenchInputs in;
+    build_inputs(&in, nframes);
+
+    Benchmark benchmarks[] = {
+        {"parse_timing", "frame", bench_parse_timing, nframes, in.timing_len},
+        {"detect_constant", "frame", bench_detect_constant, nframes, nframes * sizeof(double)},
+        {"cache_text_encode", "frame", bench_cache_text_encode, nframes, in.cache_text_len},
+        {"cache_text_decode", "frame", bench_cache_text_decode, nframes, in.cache_text_len},
+        {"cache_binary_encode", "frame", bench_cache_binary_encode, in.bcache_frames, in.bcache_len},
+        {"cache_binary_decode", "frame", bench_cache_binary_decode, in.bcache_frames, in.bcache_len},
+        {"bin_constant", "frame", bench_bin_constant, nframes, 0},
+        {"bin_raw", "frame", bench_bin_raw, nframes, nframes * sizeof(double)},
+        {"header_scan", "card", bench_header_scan, in.header_cards, in.header_len},
+        {"render_row", "bin", bench_render_row, BENCH_NUM_BINS, 0},
+    };
+    int nbench = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+    BenchResult results[64];
+    int nresults = 0;
+    printf("%-22s %12s %-6s %10s %12s\n", "benchmark", "ns/item", "item", "MB/s", "allocs/op");
+    for (int i = 0; i < nbench; i++) {
+        if (filter && !strstr(benchmarks[i].name, filter)) continue;
+        BenchResult *r = &results[nresults++];
+        memset(r, 0, sizeof(*r));
+        run_benchmark(&benchmarks[i], &in, min_time, r);
+        printf("%-22s %12.3f %-6s %10.1f %12.2f\n", r->name, r->ns_per_item, r->unit, r->mb_per_s, r->allocs_per_op);
+        fflush(stdout);
+    }
+
+    if (json_path) write_results_json(json_path, results, nresults, nframes);
+
+    int regressions = 0;
+    if (compare_path) {
+        BenchResult baseline[64];
+        int nbase = read_results_json(compare_path, baseline, 64);
+        if (nbase < 0) {
+            fprintf(stderr, "Error: Cannot read baseline %s\n", compare_path);
+            return 1;
+        }
+        printf("\nComparison with %s (threshold %.0f%%):\n", compare_path, threshold * 100.0);
+        printf("%-22s %12s %12s %8s %12s\n", "benchmark", "base ns", "ns", "ratio", "allocs");
+        for (int i = 0; i < nresults; i++) {
+            BenchResult *r = &results[i];
+            BenchResult *b = NULL;
+            for (int j = 0; j < nbase; j++) {
+                if (strcmp(baseline[j].name, r->name) == 0) { b = &baseline[j]; break; }
+            }
+            if (!b) {
+                printf("%-22s %12s %12.3f %8s %12s\n", r->name, "-", r->ns_per_item, "new", "-");
+                continue;
+            }
+            double ratio = (b->ns_per_item > 0) ? r->ns_per_item / b->ns_per_item : 1.0;
+            int slower = ratio > 1.0 + threshold;
+            int more_allocs = r->allocs_per_op > b->allocs_per_op + 0.5;
+            printf("%-22s %12.3f %12.3f %8.3f %5.1f->%-5.1f%s\n", r->name, b->ns_per_item, r->ns_per_item, ratio,
+                   b->allocs_per_op, r->allocs_per_op,
+                   slower ? "  REGRESSION" : (more_allocs ? "  MORE ALLOCS" : ""));
+            if (slower || more_allocs) regressions++;
+        }
+        printf("%d regression(s)\n", regressions);
+    }
+
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,540 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <sys/wait.h>
+#include <limits.h>
+
+// Maintenance of the summary caches of whole archives, one worker process per night:
+// reports their size, entry counts, RAW/constant ratio and the fraction of timing files
+// with a cached summary, and optionally moves per-file text caches into the night binary
+// cache (-migrate), drops entries and files whose source no longer exists (-gc) and
+// rewrites night caches sorted and without duplicates (-compact).
+
+// Per-night results, in memory shared with the parent for the totals
+typedef struct {
+    char date[16];
+    pid_t pid;
+    int ok;
+    long timing_files;
+    long cached_files;       // timing files with a binary entry or a per-file cache
+    long bcache_entries;
+    long bcache_raw;
+    long bcache_bytes;
+    long file_caches;        // per-file .cache files
+    long file_cache_bytes;   // allocated on disk (tiny files cost a block and an inode each)
+    long aux_caches;         // per-file .latency, .flux and .keys files
+    long migrated;
+    long duplicates;
+    long stale_entries;      // binary entries without timing file
+    long stale_files;        // per-file caches without source
+    int skipped;             // date directory (or a stream directory) could not be listed
+} CacheNight;
+
+int g_migrate = 0;
+int g_gc = 0;
+int g_compact = 0;
+int g_dry_run = 0;
+int g_gc_nights = 0;
+
+void print_help(const char *progname) {
+    fprintf(stderr, "Usage: %s [options] <dir> [<YYYYMMDD> ...]\n", progname);
+    fprintf(stderr, "\nReports on and maintains the summary caches of a telemetry archive.\n");
+    fprintf(stderr, "\nArguments:\n");
+    fprintf(stderr, "  <dir>                 Root directory for telemetry data (same as for queries).\n");
+    fprintf(stderr, "  <YYYYMMDD>            Nights to process (default: all nights of <dir> and of the cache tree).\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -migrate              Move per-file text caches (.cache) into the night binary caches.\n");
+    fprintf(stderr, "  -gc                   Remove binary cache entries and per-file caches (.cache, .latency, .flux, .keys)\n");
+    fprintf(stderr, "                        whose timing file or cube no longer exists. Nights whose date directory\n");
+    fprintf(stderr, "                        cannot be listed are skipped.\n");
+    fprintf(stderr, "  -gcnights             With -gc, also remove the caches of nights whose date directory no longer exists.\n");
+    fprintf(stderr, "  -compact              Rewrite night binary caches sorted and without duplicate entries.\n");
+    fprintf(stderr, "  -n                    Dry run: report what -migrate/-gc/-compact would change.\n");
+    fprintf(stderr, "  -cacheexport          Night caches in <dir>/<YYYYMMDD>/ instead of local cache/.\n");
+    fprintf(stderr, "  -cacheroot <dir>      Shared cache tree instead of local cache/ (as for queries).\n");
+    fprintf(stderr, "  -j <N>                Nights processed in parallel (default: number of CPUs).\n");
+    fprintf(stderr, "  -h, --help            Show this help message.\n");
+}
+
+int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Index of key in the sorted keys, -1 if absent
+long find_key(char **keys, long nkeys, const char *key) {
+    if (nkeys == 0) return -1;
+    char **res = bsearch(&key, keys, nkeys, sizeof(char *), compare_strings);
+    return res ? res - keys : -1;
+}
+
+// Takes over summary (timestamps included)
+void cache_entry_append(BinaryCache *cache, const char *key, const FileSummary *summary) {
+    if (cache->count == cache->capacity) {
+        cache->capacity = (cache->capacity == 0) ? 100 : cache->capacity * 2;
+        cache->entries = realloc(cache->entries, cache->capacity * sizeof(BinaryCacheEntry));
+    }
+    cache->entries[cache->count].key = strdup(key);
+    cache->entries[cache->count].summary = *summary;
+    cache->count++;
+    cache->dirty = 1;
+}
+
+long file_disk_bytes(const struct stat *st) {
+    return (long)st->st_blocks * 512;
+}
+
+// Per-file caches of one stream in <dir>: .cache files are checked against the timing files
+// of the night (keys), .latency/.flux/.keys against <stream_path>/<name without extension>
+void process_file_caches(CacheNight *night, const char *dir, const char *stream, const char *stream_path,
+                         char **keys, long nkeys, char *key_cached, BinaryCache *bc, int nsorted) {
+    DirList files;
+    dir_list_init(&files);
+    int n = dir_list_read(&files, dir, NULL);
+    for (int i = 0; i < n; i++) {
+        const char *name = dir_list_name(&files, i);
+        size_t len = strlen(name);
+        size_t ext_len = 0;
+        int is_summary = 0;
+        if (len > strlen(CACHE_EXT) && strcmp(name + len - strlen(CACHE_EXT), CACHE_EXT) == 0) {
+            ext_len = strlen(CACHE_EXT);
+            is_summary = 1;
+        } else if (len > strlen(LATENCY_CACHE_EXT) && strcmp(name + len - strlen(LATENCY_CACHE_EXT), LATENCY_CACHE_EXT) == 0) {
+            ext_len = strlen(LATENCY_CACHE_EXT);
+        } else if (len > strlen(FLUX_CACHE_EXT) && strcmp(name + len - strlen(FLUX_CACHE_EXT), FLUX_CACHE_EXT) == 0) {
+            ext_len = strlen(FLUX_CACHE_EXT);
+        } else if (len > strlen(KEYS_CACHE_EXT) && strcmp(name + len - strlen(KEYS_CACHE_EXT), KEYS_CACHE_EXT) == 0) {
+            ext_len = strlen(KEYS_CACHE_EXT);
+        } else {
+            continue;
+        }
+        char path[8192];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (!is_summary) {
+            night->aux_caches++;
+            char source[8192];
+            snprintf(source, sizeof(source), "%s/%.*s", stream_path, (int)(len - ext_len), name);
+            if (access(source, F_OK) != 0) {
+                night->stale_files++;
+                if (g_gc && !g_dry_run) unlink(path);
+            }
+            continue;
+        }
+
+        night->file_caches++;
+        night->file_cache_bytes += file_disk_bytes(&st);
+        char key[4096];
+        snprintf(key, sizeof(key), "%s/%.*s", stream, (int)(len - ext_len), name);
+        long k = find_key(keys, nkeys, key);
+        if (k < 0) {
+            night->stale_files++;
+            if (g_gc && !g_dry_run) unlink(path);
+            continue;
+        }
+        key_cached[k] = 1;
+        if (!g_migrate) continue;
+        if (!bc) {
+            night->migrated++; // dry run
+            continue;
+        }
+        // Looked up in the entries loaded (sorted); the same file cached in both per-file
+        // locations is appended twice, and deduplicated before writing
+        BinaryCacheEntry target;
+        target.key = key;
+        if (nsorted == 0 || !bsearch(&target, bc->entries, nsorted, sizeof(BinaryCacheEntry), compare_bcache_entries)) {
+            FileSummary summary;
+            if (!read_cache(path, &summary)) continue; // unreadable: left for the scanner to replace
+            cache_entry_append(bc, key, &summary);
+        }
+        night->migrated++;
+        if (!g_dry_run) unlink(path);
+    }
+    dir_list_free(&files);
+    if ((g_migrate || g_gc) && !g_dry_run) rmdir(dir); // only when emptied
+}
+
+// Sorts the entries and removes those with the key of the previous one; returns their number
+long drop_duplicate_entries(BinaryCache *bc) {
+    if (bc->count < 2) return 0;
+    qsort(bc->entries, bc->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
+    int kept = 0;
+    for (int i = 0; i < bc->count; i++) {
+        BinaryCacheEntry *e = &bc->entries[i];
+        if (kept > 0 && strcmp(bc->entries[kept - 1].key, e->key) == 0) {
+            free(e->key);
+            free(e->summary.timestamps);
+        } else {
+            bc->entries[kept++] = *e;
+        }
+    }
+    long dropped = bc->count - kept;
+    bc->count = kept;
+    return dropped;
+}
+
+// Exclusive lock on <cache>.lock, as taken by scanners saving the cache (whether or not the
+// cache exists yet); -1 if the directory of the cache does not exist
+int lock_night_cache(const char *bcache_path) {
+    char lock_path[8300];
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", bcache_path);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT, 0666);
+    if (lock_fd >= 0) flock(lock_fd, LOCK_EX);
+    return lock_fd;
+}
+
+// Reports on (and maintains) the caches of <root>/<date>. Runs in a worker process.
+int cache_night(const char *root, CacheNight *night) {
+    double t_start = get_current_time();
+    char date_path[4096];
+    snprintf(date_path, sizeof(date_path), "%s/%s", root, night->date);
+
+    // Timing files of the night, as cache keys "stream/file.txt"
+    DirList streams;
+    DirList files;
+    dir_list_init(&streams);
+    dir_list_init(&files);
+    char **keys = NULL;
+    long nkeys = 0, capacity = 0;
+    int n_stream = dir_list_read(&streams, date_path, NULL);
+    int list_errno = n_stream < 0 ? errno : 0;
+    for (int i = 0; i < n_stream && !list_errno; i++) {
+        if (!dir_list_is_dir(&streams, i, date_path)) continue;
+        const char *stream = dir_list_name(&streams, i);
+        char stream_path[4096];
+        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, stream);
+        int n = dir_list_read(&files, stream_path, TIMING_SUFFIXES);
+        if (n < 0) {
+            list_errno = errno ? errno : EIO;
+            fprintf(stderr, "Warning: %s: cannot list %s: %s\n", night->date, stream_path, strerror(list_errno));
+        }
+        for (int k = 0; k < n; k++) {
+            if (nkeys == capacity) {
+                capacity = (capacity == 0) ? 1024 : capacity * 2;
+                keys = realloc(keys, capacity * sizeof(char *));
+            }
+            const char *name = dir_list_name(&files, k);
+            char key[4096];
+            snprintf(key, sizeof(key), "%s/%.*s.txt", stream, (int)timing_stem_len(name), name);
+            keys[nkeys++] = strdup(key);
+        }
+    }
+    // Without the timing files, every cache entry of the night would look stale: skip the
+    // night (unmounted disk, wrong <dir>), unless it was deleted and -gcnights is given
+    if (list_errno && !(n_stream < 0 && list_errno == ENOENT && g_gc && g_gc_nights)) {
+        if (n_stream < 0) fprintf(stderr, "Warning: %s: cannot list %s: %s\n", night->date, date_path, strerror(list_errno));
+        printf("%s: skipped\n", night->date);
+        fflush(stdout);
+        night->skipped = 1;
+        dir_list_free(&streams);
+        dir_list_free(&files);
+        for (long k = 0; k < nkeys; k++) free(keys[k]);
+        free(keys);
+        return 0;
+    }
+    if (n_stream < 0) n_stream = 0;
+    if (nkeys > 1) qsort(keys, nkeys, sizeof(char *), compare_strings);
+    night->timing_files = nkeys;
+    char *key_cached = calloc(nkeys > 0 ? nkeys : 1, 1);
+
+    // Night binary cache, locked against scanners saving it meanwhile
+    char bcache_path[8192];
+    night_cache_path(date_path, bcache_path, sizeof(bcache_path));
+    int modify = (g_migrate || g_gc || g_compact) && !g_dry_run;
+    int lock_fd = modify ? lock_night_cache(bcache_path) : -1;
+    BinaryCache *bc = calloc(1, sizeof(BinaryCache));
+    strncpy(bc->filepath, bcache_path, sizeof(bc->filepath) - 1);
+    FILE *fp = fopen(bcache_path, "rb");
+    int had_bcache = (fp != NULL);
+    if (fp) {
+        read_binary_cache_fp(fp, bc);
+        night->bcache_bytes = ftell(fp);
+        fclose(fp);
+    }
+
+    // Duplicate and stale entries (removed with -compact and -gc)
+    if (bc->count > 1) qsort(bc->entries, bc->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
+    for (int i = 1; i < bc->count; i++) {
+        if (strcmp(bc->entries[i - 1].key, bc->entries[i].key) == 0) night->duplicates++;
+    }
+    if (g_compact && night->duplicates > 0) {
+        drop_duplicate_entries(bc);
+        bc->dirty = 1;
+    }
+    int kept = 0;
+    for (int i = 0; i < bc->count; i++) {
+        BinaryCacheEntry *e = &bc->entries[i];
+        long k = find_key(keys, nkeys, e->key);
+        if (k >= 0) key_cached[k] = 1;
+        if (k < 0) night->stale_entries++;
+        if (k < 0 && g_gc) {
+            free(e->key);
+            free(e->summary.timestamps);
+            bc->dirty = 1;
+        } else {
+            bc->entries[kept++] = *e;
+        }
+    }
+    bc->count = kept;
+    int nsorted = bc->count;
+
+    // Per-file caches: local tree (<cache root>/<date path>/<stream>) and exported (<stream>/cache)
+    char local_date[8192];
+    snprintf(local_date, sizeof(local_date), "%s/%s", g_cache_root, date_path);
+    DirList local_streams;
+    dir_list_init(&local_streams);
+    int n_local = dir_list_read(&local_streams, local_date, NULL);
+    for (int i = 0; i < n_local; i++) {
+        if (!dir_list_is_dir(&local_streams, i, local_date)) continue;
+        const char *stream = dir_list_name(&local_streams, i);
+        char dir[8300], stream_path[4200];
+        snprintf(dir, sizeof(dir), "%s/%s", local_date, stream);
+        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, stream);
+        process_file_caches(night, dir, stream, stream_path, keys, nkeys, key_cached, modify ? bc : NULL, nsorted);
+    }
+    dir_list_free(&local_streams);
+    for (int i = 0; i < n_stream; i++) {
+        if (!dir_list_is_dir(&streams, i, date_path)) continue;
+        const char *stream = dir_list_name(&streams, i);
+        char dir[4200], stream_path[4200];
+        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, stream);
+        snprintf(dir, sizeof(dir), "%s/%s", stream_path, CACHE_DIR);
+        process_file_caches(night, dir, stream, stream_path, keys, nkeys, key_cached, modify ? bc : NULL, nsorted);
+    }
+    dir_list_free(&streams);
+    dir_list_free(&files);
+    if (bc->count > nsorted) drop_duplicate_entries(bc); // migrated
+
+    int ret = 0;
+    if (modify && (bc->dirty || g_compact)) {
+        if (bc->count == 0) {
+            if (had_bcache && unlink(bcache_path) != 0 && errno != ENOENT) ret = 1;
+        } else {
+            if (!g_cache_export) ensure_path_exists(bcache_path);
+            if (lock_fd < 0) {
+                // No cache directory when the night was read: scanners may have created
+                // the cache since, keep what they added
+                lock_fd = lock_night_cache(bcache_path);
+                if (lock_fd >= 0) merge_binary_cache_from_disk(bc);
+            }
+            char tmp_path[8300];
+            FILE *out = open_cache_tmp(bcache_path, tmp_path, sizeof(tmp_path));
+            if (out) write_binary_cache_fp(out, bc);
+            long bytes = out ? ftell(out) : -1;
+            if (!out || !publish_cache_tmp(out, tmp_path, bcache_path)) {
+                fprintf(stderr, "Error: Failed to write binary cache %s: %s\n", bcache_path, strerror(errno));
+                ret = 1;
+            } else {
+                night->bcache_bytes = bytes;
+            }
+        }
+    }
+    if (lock_fd >= 0) close(lock_fd);
+    if ((g_migrate || g_gc) && !g_dry_run) rmdir(local_date); // only when emptied
+
+    night->bcache_entries = bc->count;
+    for (int i = 0; i < bc->count; i++) {
+        if (!bc->entries[i].summary.is_constant) night->bcache_raw++;
+    }
+    for (long k = 0; k < nkeys; k++) night->cached_files += key_cached[k];
+
+    printf("%s: %ld timing files, %.1f%% cached; binary %ld entries (%ld RAW, %.1f kB); per-file %ld (%.1f kB), "
+           "%ld aux; stale %ld entries, %ld files; %ld duplicate; %ld migrated; %.3f s\n",
+           night->date, night->timing_files,
+           night->timing_files > 0 ? 100.0 * night->cached_files / night->timing_files : 0.0,
+           night->bcache_entries, night->bcache_raw, night->bcache_bytes / 1e3, night->file_caches,
+           night->file_cache_bytes / 1e3, night->aux_caches, night->stale_entries, night->stale_files,
+           night->duplicates, night->migrated, get_current_time() - t_start);
+    fflush(stdout);
+
+    free_binary_cache(bc);
+    for (long k = 0; k < nkeys; k++) free(keys[k]);
+    free(keys);
+    free(key_cached);
+    return ret;
+}
+
+// Adds the date directory names of <path> to the dates, without duplicates
+void add_date_names(const char *path, char ***dates, int *ndates, int *capacity) {
+    DirList list;
+    dir_list_init(&list);
+    int n = dir_list_read(&list, path, NULL);
+    for (int i = 0; i < n; i++) {
+        const char *name = dir_list_name(&list, i);
+        if (!is_date_name(name) || !dir_list_is_dir(&list, i, path)) continue;
+        int dup = 0;
+        for (int j = 0; j < *ndates && !dup; j++) dup = strcmp((*dates)[j], name) == 0;
+        if (dup) continue;
+        if (*ndates == *capacity) {
+            *capacity = (*capacity == 0) ? 64 : *capacity * 2;
+            *dates = realloc(*dates, *capacity * sizeof(char *));
+        }
+        (*dates)[(*ndates)++] = strdup(name);
+    }
+    dir_list_free(&list);
+}
+
+int main(int argc, char *argv[]) {
+    char *root_dir = NULL;
+    int shared_cache = 0;
+    char root_real[PATH_MAX];
+    int jobs = 0;
+    char **dates = NULL;
+    int ndates = 0;
+    int dates_capacity = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "-migrate") == 0) {
+            g_migrate = 1;
+        } else if (strcmp(argv[i], "-gc") == 0) {
+            g_gc = 1;
+        } else if (strcmp(argv[i], "-gcnights") == 0) {
+            g_gc_nights = 1;
+        } else if (strcmp(argv[i], "-compact") == 0) {
+            g_compact = 1;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            g_dry_run = 1;
+        } else if (strcmp(argv[i], "-cacheexport") == 0) {
+            g_cache_export = 1;
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "-cacheroot") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+                return 1;
+            }
+            if (strcmp(argv[i], "-j") == 0) {
+                jobs = atoi(argv[++i]);
+            } else {
+                strncpy(g_cache_root, argv[++i], sizeof(g_cache_root) - 1);
+                shared_cache = 1;
+            }
+        } else if (!root_dir) {
+            root_dir = argv[i];
+        } else if (is_date_name(argv[i])) {
+            if (ndates == dates_capacity) {
+                dates_capacity = (dates_capacity == 0) ? 64 : dates_capacity * 2;
+                dates = realloc(dates, dates_capacity * sizeof(char *));
+            }
+            dates[ndates++] = strdup(argv[i]);
+        } else {
+            fprintf(stderr, "Error: Invalid date %s (expected YYYYMMDD)\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!root_dir) {
+        print_help(argv[0]);
+        return 1;
+    }
+    if (g_gc && !is_directory(root_dir)) {
+        fprintf(stderr, "Error: %s is not a directory, refusing to remove its caches\n", root_dir);
+        return 1;
+    }
+    if (shared_cache) {
+        if (!realpath(root_dir, root_real)) {
+            fprintf(stderr, "Error: Cannot resolve %s: %s\n", root_dir, strerror(errno));
+            return 1;
+        }
+        root_dir = root_real;
+    }
+    g_num_threads = jobs;
+    jobs = get_num_threads();
+
+    // Nights: given on the command line, or those of the archive and of the local cache tree
+    // (caches of removed nights are found there)
+    if (ndates == 0) {
+        add_date_names(root_dir, &dates, &ndates, &dates_capacity);
+        if (!g_cache_export) {
+            char cache_dates[8192];
+            snprintf(cache_dates, sizeof(cache_dates), "%s/%s", g_cache_root, root_dir);
+            add_date_names(cache_dates, &dates, &ndates, &dates_capacity);
+        }
+    }
+    if (ndates > 1) qsort(dates, ndates, sizeof(char *), compare_strings);
+
+    CacheNight *nights = mmap(NULL, (ndates > 0 ? ndates : 1) * sizeof(CacheNight), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (nights == MAP_FAILED) {
+        fprintf(stderr, "Error: mmap failed: %s\n", strerror(errno));
+        return 1;
+    }
+    memset(nights, 0, (ndates > 0 ? ndates : 1) * sizeof(CacheNight));
+    for (int i = 0; i < ndates; i++) strncpy(nights[i].date, dates[i], sizeof(nights[i].date) - 1);
+    printf("Checking %d nights with %d workers\n", ndates, jobs);
+    fflush(stdout);
+
+    int next = 0;
+    int running = 0;
+    int failed = 0;
+    while (next < ndates || running > 0) {
+        if (next < ndates && running < jobs) {
+            CacheNight *night = &nights[next++];
+            pid_t pid = fork();
+            if (pid == 0) {
+                int ret = cache_night(root_dir, night);
+                night->ok = (ret == 0);
+                exit(ret);
+            }
+            if (pid < 0) {
+                fprintf(stderr, "Error: fork failed: %s\n", strerror(errno));
+                failed++;
+                continue;
+            }
+            night->pid = pid;
+            running++;
+            continue;
+        }
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        running--;
+        for (int i = 0; i < ndates; i++) {
+            if (nights[i].pid != pid) continue;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "Error: Processing %s failed\n", nights[i].date);
+                failed++;
+            }
+            break;
+        }
+    }
+
+    CacheNight total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < ndates; i++) {
+        CacheNight *n = &nights[i];
+        total.timing_files += n->timing_files;
+        total.cached_files += n->cached_files;
+        total.bcache_entries += n->bcache_entries;
+        total.bcache_raw += n->bcache_raw;
+        total.bcache_bytes += n->bcache_bytes;
+        total.file_caches += n->file_caches;
+        total.file_cache_bytes += n->file_cache_bytes;
+        total.aux_caches += n->aux_caches;
+        total.migrated += n->migrated;
+        total.duplicates += n->duplicates;
+        total.stale_entries += n->stale_entries;
+        total.stale_files += n->stale_files;
+        total.skipped += n->skipped;
+    }
+    printf("Total: %d nights, %ld timing files, %.1f%% with a cached summary\n", ndates, total.timing_files,
+           total.timing_files > 0 ? 100.0 * total.cached_files / total.timing_files : 0.0);
+    printf("  Binary caches:    %ld entries, %.1f%% RAW, %.1f MB\n", total.bcache_entries,
+           total.bcache_entries > 0 ? 100.0 * total.bcache_raw / total.bcache_entries : 0.0, total.bcache_bytes / 1e6);
+    printf("  Per-file caches:  %ld summaries (%.1f MB on disk), %ld latency/flux/keys\n", total.file_caches,
+           total.file_cache_bytes / 1e6, total.aux_caches);
+    const char *removed = g_dry_run ? " (dry run)" : " (removed)";
+    printf("  Duplicate:        %ld binary entries%s\n", total.duplicates, g_compact ? removed : "");
+    printf("  Stale:            %ld binary entries, %ld per-file caches%s\n", total.stale_entries, total.stale_files,
+           g_gc ? removed : "");
+    if (total.skipped) printf("  Skipped:          %d nights (date or stream directory not readable)\n", total.skipped);
+    if (g_migrate) printf("  Migrated:         %ld per-file caches%s\n", total.migrated, g_dry_run ? " (dry run)" : "");
+
+    munmap(nights, (ndates > 0 ? ndates : 1) * sizeof(CacheNight));
+    for (int i = 0; i < ndates; i++) free(dates[i]);
+    free(dates);
+    return failed > 0 ? 1 : 0;
+}
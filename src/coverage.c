@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+// Coverage (--coverage s1,s2,...): intervals where all the given streams were logging.
+// Each stream's file summaries are turned into a sorted list of covered intervals, frames
+// closer than COVERAGE_MAX_GAP_FRAMES frame periods being merged (within RAW files and
+// across files), and the lists are intersected with a single sweep. Only summaries are used,
+// so the query is answered from the caches.
+
+// Whether stream name is scanned: in g_stream_select, or all streams if it is empty
+int stream_selected(const char *name) {
+    if (g_stream_select[0] == '\0') return 1;
+    size_t len = strlen(name);
+    for (const char *p = g_stream_select; *p;) {
+        const char *comma = strchr(p, ',');
+        size_t n = comma ? (size_t)(comma - p) : strlen(p);
+        if (n == len && strncmp(p, name, len) == 0) return 1;
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    double start;
+    double end;
+    double max_gap; // gaps up to this long are merged (COVERAGE_MAX_GAP_FRAMES periods)
+} CoverInterval;
+
+typedef struct {
+    CoverInterval *iv;
+    int count;
+    int capacity;
+} CoverList;
+
+void cover_list_add(CoverList *l, double start, double end, double max_gap) {
+    if (l->count == l->capacity) {
+        l->capacity = l->capacity ? l->capacity * 2 : 64;
+        l->iv = realloc(l->iv, l->capacity * sizeof(CoverInterval));
+    }
+    l->iv[l->count].start = start;
+    l->iv[l->count].end = end;
+    l->iv[l->count].max_gap = max_gap;
+    l->count++;
+}
+
+int cover_interval_cmp(const void *a, const void *b) {
+    const CoverInterval *ia = a, *ib = b;
+    if (ia->start < ib->start) return -1;
+    if (ia->start > ib->start) return 1;
+    return 0;
+}
+
+// Sorts l and merges overlapping intervals, and intervals separated by less than max_gap
+// (of either side: a single-frame file has none)
+void cover_list_merge(CoverList *l) {
+    if (l->count == 0) return;
+    qsort(l->iv, l->count, sizeof(CoverInterval), cover_interval_cmp);
+    int n = 0;
+    for (int i = 1; i < l->count; i++) {
+        CoverInterval *cur = &l->iv[n];
+        const CoverInterval *next = &l->iv[i];
+        double max_gap = fmax(cur->max_gap, next->max_gap);
+        if (next->start - cur->end <= max_gap) {
+            if (next->end > cur->end) cur->end = next->end;
+            cur->max_gap = max_gap;
+        } else {
+            l->iv[++n] = *next;
+        }
+    }
+    l->count = n + 1;
+}
+
+// Covered intervals of the frames of one file within [tstart, tend]
+void cover_list_add_file(CoverList *l, const FileSummary *summary, double tstart, double tend) {
+    long first = 0, last = -1;
+    if (!summary_frame_range(summary, tstart, tend, &first, &last)) return;
+    double dt = (summary->count > 1) ? (summary->end - summary->start) / (summary->count - 1) : 0.0;
+    double max_gap = COVERAGE_MAX_GAP_FRAMES * dt;
+    if (summary->is_constant) {
+        cover_list_add(l, summary->start + first * dt, summary->start + last * dt, max_gap);
+        return;
+    }
+    // RAW: split at logging gaps
+    const double *t = summary->timestamps;
+    long k0 = first;
+    for (long k = first + 1; k <= last; k++) {
+        if (t[k] - t[k - 1] > max_gap) {
+            cover_list_add(l, t[k0], t[k - 1], max_gap);
+            k0 = k;
+        }
+    }
+    cover_list_add(l, t[k0], t[last], max_gap);
+}
+
+double cover_list_total(const CoverList *l) {
+    double total = 0;
+    for (int i = 0; i < l->count; i++) total += l->iv[i].end - l->iv[i].start;
+    return total;
+}
+
+void print_coverage_interval(double start, double end) {
+    char start_str[64], end_str[64];
+    format_time_iso(start, start_str, sizeof(start_str));
+    format_time_iso(end, end_str, sizeof(end_str));
+    printf("  %-20s %-20s %18.6f %18.6f %12.3f s\n", start_str, end_str, start, end, end - start);
+}
+
+// Intervals of [tstart, tend] covered by every stream of the comma-separated list names
+int coverage_report(StreamList *stream_list, const char *names, double tstart, double tend) {
+    char *list = strdup(names);
+    int nstreams = 0;
+    Stream **streams = NULL;
+    int ret = 0;
+    for (char *save = NULL, *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        Stream *s = NULL;
+        for (int i = 0; i < stream_list->count; i++) {
+            if (strcmp(stream_list->streams[i].name, name) == 0) s = &stream_list->streams[i];
+        }
+        if (!s) {
+            fprintf(stderr, "Error: No files found for stream %s in range\n", name);
+            ret = 1;
+            continue;
+        }
+        streams = realloc(streams, (nstreams + 1) * sizeof(Stream *));
+        streams[nstreams++] = s;
+    }
+    free(list);
+    if (ret || nstreams == 0) {
+        if (nstreams == 0 && !ret) fprintf(stderr, "Error: --coverage requires at least one stream\n");
+        free(streams);
+        return 1;
+    }
+
+    CoverList *lists = calloc(nstreams, sizeof(CoverList));
+    double range = tend - tstart;
+    printf("Coverage %s (%d streams), merging gaps below %d frame periods:\n", names, nstreams, COVERAGE_MAX_GAP_FRAMES);
+    printf("  %-20s %10s %14s\n", "Stream", "Intervals", "Covered");
+    for (int i = 0; i < nstreams; i++) {
+        Stream *s = streams[i];
+        double t_trace = trace_begin();
+        for (int j = 0; j < s->file_count; j++) {
+            FileSummary summary;
+            get_file_data(s->files[j].path, &summary);
+            cover_list_add_file(&lists[i], &summary, tstart, tend);
+            free(summary.timestamps);
+        }
+        cover_list_merge(&lists[i]);
+        trace_span("coverage", "stream", t_trace, s->name, -1, s->file_count, -1);
+        double covered = cover_list_total(&lists[i]);
+        printf("  %-20s %10d %12.3f s %7.2f%%\n", s->name, lists[i].count, covered,
+               range > 0 ? 100.0 * covered / range : 0.0);
+    }
+
+    // Sweep: the candidate interval is the intersection of the current interval of every
+    // list; the list whose current interval ends first moves on
+    int *pos = calloc(nstreams, sizeof(int));
+    long ncommon = 0;
+    double total = 0;
+    printf("\nCommon intervals:\n");
+    printf("  %-20s %-20s %18s %18s %14s\n", "Start", "End", "Start (unix)", "End (unix)", "Duration");
+    int done = 0;
+    for (int i = 0; i < nstreams; i++) {
+        if (lists[i].count == 0) done = 1;
+    }
+    while (!done) {
+        double lo = lists[0].iv[pos[0]].start;
+        double hi = lists[0].iv[pos[0]].end;
+        int first_end = 0;
+        for (int i = 1; i < nstreams; i++) {
+            const CoverInterval *iv = &lists[i].iv[pos[i]];
+            if (iv->start > lo) lo = iv->start;
+            if (iv->end < hi) {
+                hi = iv->end;
+                first_end = i;
+            }
+        }
+        if (lo < hi) {
+            print_coverage_interval(lo, hi);
+            ncommon++;
+            total += hi - lo;
+        }
+        if (++pos[first_end] == lists[first_end].count) done = 1;
+    }
+    printf("Total usable time: %.3f s in %ld intervals (%.2f%% of %.3f s)\n", total, ncommon,
+           range > 0 ? 100.0 * total / range : 0.0, range);
+
+    for (int i = 0; i < nstreams; i++) free(lists[i].iv);
+    free(lists);
+    free(pos);
+    free(streams);
+    return 0;
+}
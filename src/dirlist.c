@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+// Directory listing on getdents64: entries are decoded from one reusable buffer into a
+// name arena (no allocation per entry), hidden entries and non-matching suffixes are
+// dropped in place, and names are sorted byte-wise (same order as alphasort in the C locale).
+
+#define DIRLIST_BUF_SIZE (256 * 1024)
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+void dir_list_init(DirList *dl) {
+    memset(dl, 0, sizeof(*dl));
+}
+
+void dir_list_free(DirList *dl) {
+    free(dl->buf);
+    free(dl->names);
+    free(dl->entries);
+    memset(dl, 0, sizeof(*dl));
+}
+
+// 8 name bytes from <pos>, big-endian, so that integer order is byte-wise name order
+uint64_t dir_list_key(const char *name, size_t len, size_t pos) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; i++) {
+        key <<= 8;
+        if (pos + i < len) key |= (unsigned char)name[pos + i];
+    }
+    return key;
+}
+
+const char *g_dir_list_sort_names; // qsort has no context argument
+
+int compare_dir_entries(const void *a, const void *b) {
+    const DirEntry *ea = (const DirEntry *)a;
+    const DirEntry *eb = (const DirEntry *)b;
+    if (ea->key != eb->key) return ea->key < eb->key ? -1 : 1;
+    return strcmp(g_dir_list_sort_names + ea->name, g_dir_list_sort_names + eb->name);
+}
+
+// Byte-wise LSD radix sort on the keys, then names compared within runs of equal keys
+void dir_list_sort(DirList *dl) {
+    DirEntry *tmp = malloc(dl->count * sizeof(DirEntry));
+    DirEntry *src = dl->entries;
+    DirEntry *dst = tmp;
+    for (int shift = 0; shift < 64; shift += 8) {
+        int counts[257] = {0};
+        for (int i = 0; i < dl->count; i++) counts[((src[i].key >> shift) & 0xff) + 1]++;
+        // Skip bytes identical in all keys (separators, common digits)
+        if (counts[((src[0].key >> shift) & 0xff) + 1] == dl->count) continue;
+        for (int b = 0; b < 256; b++) counts[b + 1] += counts[b];
+        for (int i = 0; i < dl->count; i++) dst[counts[(src[i].key >> shift) & 0xff]++] = src[i];
+        DirEntry *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != dl->entries) memcpy(dl->entries, src, dl->count * sizeof(DirEntry));
+    free(tmp);
+
+    g_dir_list_sort_names = dl->names;
+    for (int i = 0; i < dl->count;) {
+        int j = i + 1;
+        while (j < dl->count && dl->entries[j].key == dl->entries[i].key) j++;
+        if (j - i > 1) qsort(dl->entries + i, j - i, sizeof(DirEntry), compare_dir_entries);
+        i = j;
+    }
+}
+
+#define DIRLIST_MAX_SUFFIXES 8
+
+// Length of the suffix alternative that name ends with, 0 if none
+size_t dir_list_suffix_match(const char *name, size_t len, const char **alt, const size_t *alt_len, int nalt) {
+    for (int k = 0; k < nalt; k++) {
+        if (len > alt_len[k] && memcmp(name + len - alt_len[k], alt[k], alt_len[k]) == 0) return alt_len[k];
+    }
+    return 0;
+}
+
+// Lists <path> into dl (previous contents are replaced). suffix: keep only names ending
+// with it, or with one of its '|'-separated alternatives (NULL keeps all); of names that
+// differ only by alternative suffix (x.txt, x.txt.gz), the first in sort order is kept.
+// Returns the number of entries, or -1 if <path> cannot be read.
+int dir_list_read(DirList *dl, const char *path, const char *suffix) {
+    dl->count = 0;
+    dl->names_size = 0;
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+    PROF_COUNT(scandir_calls, 1);
+    if (!dl->buf) dl->buf = malloc(DIRLIST_BUF_SIZE);
+    const char *alt[DIRLIST_MAX_SUFFIXES];
+    size_t alt_len[DIRLIST_MAX_SUFFIXES];
+    int nalt = 0;
+    for (const char *a = suffix; a && nalt < DIRLIST_MAX_SUFFIXES; nalt++) {
+        const char *bar = strchr(a, '|');
+        alt[nalt] = a;
+        alt_len[nalt] = bar ? (size_t)(bar - a) : strlen(a);
+        a = bar ? bar + 1 : NULL;
+    }
+
+    for (;;) {
+        long nread = syscall(SYS_getdents64, fd, dl->buf, DIRLIST_BUF_SIZE);
+        if (nread <= 0) break;
+        for (long pos = 0; pos < nread;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(dl->buf + pos);
+            pos += d->d_reclen;
+            if (d->d_name[0] == '.') continue;
+            size_t len = strlen(d->d_name);
+            if (suffix && dir_list_suffix_match(d->d_name, len, alt, alt_len, nalt) == 0) continue;
+
+            if (dl->names_size + len + 1 > dl->names_capacity) {
+                dl->names_capacity = (dl->names_capacity == 0) ? 65536 : dl->names_capacity * 2;
+                while (dl->names_capacity < dl->names_size + len + 1) dl->names_capacity *= 2;
+                dl->names = realloc(dl->names, dl->names_capacity);
+            }
+            if (dl->count == dl->capacity) {
+                dl->capacity = (dl->capacity == 0) ? 1024 : dl->capacity * 2;
+                dl->entries = realloc(dl->entries, dl->capacity * sizeof(DirEntry));
+            }
+            DirEntry *e = &dl->entries[dl->count++];
+            e->name = dl->names_size;
+            e->type = d->d_type;
+            memcpy(dl->names + dl->names_size, d->d_name, len + 1);
+            dl->names_size += len + 1;
+        }
+    }
+    close(fd);
+
+    if (dl->count > 1) {
+        // Sort on the 8 bytes following the common prefix (HH:MM:SS for timing files)
+        const char *first = dl->names + dl->entries[0].name;
+        size_t prefix = strlen(first);
+        for (int i = 1; i < dl->count && prefix > 0; i++) {
+            const char *name = dl->names + dl->entries[i].name;
+            size_t k = 0;
+            while (k < prefix && name[k] == first[k]) k++;
+            prefix = k;
+        }
+        for (int i = 0; i < dl->count; i++) {
+            const char *name = dl->names + dl->entries[i].name;
+            dl->entries[i].key = dir_list_key(name, strlen(name), prefix);
+        }
+        dir_list_sort(dl);
+    }
+
+    // Same file under several suffixes (e.g. while a night is being compressed)
+    if (nalt > 1 && dl->count > 1) {
+        int kept = 1;
+        for (int i = 1; i < dl->count; i++) {
+            const char *prev = dl->names + dl->entries[kept - 1].name;
+            const char *name = dl->names + dl->entries[i].name;
+            size_t prev_len = strlen(prev);
+            size_t len = strlen(name);
+            size_t prev_stem = prev_len - dir_list_suffix_match(prev, prev_len, alt, alt_len, nalt);
+            size_t stem = len - dir_list_suffix_match(name, len, alt, alt_len, nalt);
+            if (stem == prev_stem && memcmp(name, prev, stem) == 0) continue;
+            dl->entries[kept++] = dl->entries[i];
+        }
+        dl->count = kept;
+    }
+    return dl->count;
+}
+
+const char *dir_list_name(const DirList *dl, int i) {
+    return dl->names + dl->entries[i].name;
+}
+
+// Whether entry i of a listing of <parent> is a directory: d_type when the filesystem
+// provides it, stat for unknown types and symlinks
+int dir_list_is_dir(const DirList *dl, int i, const char *parent) {
+    unsigned char type = dl->entries[i].type;
+    if (type == DT_DIR) return 1;
+    if (type != DT_UNKNOWN && type != DT_LNK) return 0;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", parent, dir_list_name(dl, i));
+    return is_directory(path);
+}
+
+// Midnight UT of a YYYYMMDD date directory name, or -1 if malformed
+double date_dir_epoch(const char *date_str) {
+    int year, month, day;
+    if (sscanf(date_str, "%4d%2d%2d", &year, &month, &day) != 3) return -1.0;
+    struct tm tm_val;
+    memset(&tm_val, 0, sizeof(tm_val));
+    tm_val.tm_year = year - 1900;
+    tm_val.tm_mon = month - 1;
+    tm_val.tm_mday = day;
+    return (double)timegm(&tm_val);
+}
+
+// Timestamp of sname_HH:MM:SS.sssssssss.txt (or .txt.gz, .txt.zst) given the epoch of its
+// date directory
+double filename_time_from_epoch(const char *filename, size_t len, double date_epoch) {
+    int type = timing_compression(filename, len);
+    size_t suffix = (type == TIMING_GZ) ? 7 : (type == TIMING_ZST) ? 8 : 4;
+    if (len < suffix + 18 || date_epoch < 0) return 0.0;
+    const char *t = filename + len - suffix - 18;
+    const int digits[6] = {0, 1, 3, 4, 6, 7}; // HH:MM:SS
+    for (int k = 0; k < 6; k++) {
+        if (t[digits[k]] < '0' || t[digits[k]] > '9') return 0.0;
+    }
+    int hour = (t[0] - '0') * 10 + (t[1] - '0');
+    int minute = (t[3] - '0') * 10 + (t[4] - '0');
+    int second = (t[6] - '0') * 10 + (t[7] - '0');
+
+    // Fractional seconds: digits after the '.', as an exact integer / 10^n
+    double frac = 0.0;
+    if (t[8] == '.') {
+        long num = 0;
+        double den = 1.0;
+        for (const char *c = t + 9; *c >= '0' && *c <= '9' && den < 1e15; c++) {
+            num = num * 10 + (*c - '0');
+            den *= 10.0;
+        }
+        frac = num / den;
+    }
+    return date_epoch + hour * 3600 + minute * 60 + second + frac;
+}
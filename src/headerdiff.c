@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+// Header diff (--header-diff): every header of a stream is compared with the header of the
+// previous file. A header whose raw content hashes to the same value as the previous one
+// is skipped without being parsed; otherwise both are split into 80-byte cards, matched by
+// keyword (and occurrence, for COMMENT/HISTORY), and only cards whose hash differs are
+// reported.
+
+typedef struct {
+    char *buf;     // raw header: sidecar text, or cards read from the cube
+    size_t len;
+    int is_fits;   // buf holds 80-byte cards without newlines
+    uint64_t hash; // of the raw content
+    char filename[256];
+    double ts;
+} DiffHeader;
+
+typedef struct {
+    const char *card; // 80 bytes, space padded
+    uint64_t key_hash;
+    uint64_t card_hash;
+    int matched;
+} DiffCard;
+
+typedef struct {
+    char *cards; // normalized cards, 80 bytes each
+    DiffCard *entries;
+    int count;
+    int *table; // open addressing on key_hash, -1: empty
+    int table_size;
+} DiffCards;
+
+// 64-bit hash of a byte range, 8 bytes per step
+uint64_t header_hash_bytes(const void *data, size_t len, uint64_t h) {
+    const unsigned char *p = data;
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+        h ^= h >> 29;
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        h = (h ^ *p++) * 0x100000001b3ULL;
+        len--;
+    }
+    return h ^ (h >> 32);
+}
+
+// '=' of a keyword card (also HIERARCH), NULL for commentary cards
+const char *diff_card_equals(const char *card) {
+    if (memcmp(card, "COMMENT ", 8) == 0 || memcmp(card, "HISTORY ", 8) == 0 || memcmp(card, "        ", 8) == 0) return NULL;
+    return memchr(card, '=', FITS_CARD_SIZE);
+}
+
+// Keyword of a card: text before '=', or the first 8 columns (COMMENT, HISTORY, blank)
+void diff_card_key(const char *card, char *key) {
+    const char *eq = diff_card_equals(card);
+    size_t len = eq ? (size_t)(eq - card) : 8;
+    memcpy(key, card, len);
+    while (len > 0 && key[len - 1] == ' ') len--;
+    key[len] = '\0';
+}
+
+// Value of a card as reported: trimmed value, or the card text after the keyword when the
+// card has no value or only its comment changed
+void diff_card_value(const char *card, int with_comment, char *out, size_t size) {
+    char text[FITS_CARD_SIZE + 1];
+    memcpy(text, card, FITS_CARD_SIZE);
+    text[FITS_CARD_SIZE] = '\0';
+    const char *card_eq = diff_card_equals(card);
+    char *eq = card_eq ? text + (card_eq - card) : NULL;
+    char *val = eq ? eq + 1 : text + 8;
+    if (eq && !with_comment) {
+        char *slash = strchr(val, '/');
+        if (slash) *slash = '\0';
+    }
+    trim_fits_value(val);
+    snprintf(out, size, "%s", val);
+}
+
+void diff_cards_free(DiffCards *dc) {
+    free(dc->cards);
+    free(dc->entries);
+    free(dc->table);
+    memset(dc, 0, sizeof(*dc));
+}
+
+// Splits a header into cards up to END and indexes them by keyword
+void diff_cards_parse(const DiffHeader *h, DiffCards *dc) {
+    diff_cards_free(dc);
+    size_t max_cards = h->is_fits ? h->len / FITS_CARD_SIZE : h->len / 2 + 1;
+    dc->cards = malloc((max_cards > 0 ? max_cards : 1) * FITS_CARD_SIZE);
+    const char *cur = h->buf;
+    const char *end = h->buf + h->len;
+    while (cur < end && (size_t)dc->count < max_cards) {
+        char *card = dc->cards + (size_t)dc->count * FITS_CARD_SIZE;
+        size_t take;
+        if (h->is_fits) {
+            take = FITS_CARD_SIZE;
+            memcpy(card, cur, take);
+            cur += take;
+        } else {
+            const char *nl = memchr(cur, '\n', end - cur);
+            size_t line_len = nl ? (size_t)(nl - cur) : (size_t)(end - cur);
+            take = line_len < FITS_CARD_SIZE ? line_len : FITS_CARD_SIZE;
+            memcpy(card, cur, take);
+            memset(card + take, ' ', FITS_CARD_SIZE - take);
+            cur += line_len + (nl ? 1 : 0);
+            if (line_len == 0) continue;
+        }
+        dc->count++;
+        if (memcmp(card, "END     ", 8) == 0) {
+            dc->count--;
+            break;
+        }
+    }
+
+    dc->entries = malloc((dc->count > 0 ? dc->count : 1) * sizeof(DiffCard));
+    dc->table_size = 16;
+    while (dc->table_size < 2 * dc->count) dc->table_size *= 2;
+    dc->table = malloc(dc->table_size * sizeof(int));
+    for (int i = 0; i < dc->table_size; i++) dc->table[i] = -1;
+
+    for (int i = 0; i < dc->count; i++) {
+        DiffCard *e = &dc->entries[i];
+        e->card = dc->cards + (size_t)i * FITS_CARD_SIZE;
+        e->card_hash = header_hash_bytes(e->card, FITS_CARD_SIZE, 0xcbf29ce484222325ULL);
+        e->matched = 0;
+
+        // Repeated keywords are told apart by occurrence
+        char key[FITS_CARD_SIZE + 1];
+        diff_card_key(e->card, key);
+        uint64_t base = header_hash_bytes(key, strlen(key), 0xcbf29ce484222325ULL);
+        int occurrence = 0;
+        for (;;) {
+            e->key_hash = header_hash_bytes(&occurrence, sizeof(occurrence), base);
+            int slot = (int)(e->key_hash & (dc->table_size - 1));
+            int dup = 0;
+            while (dc->table[slot] >= 0) {
+                if (dc->entries[dc->table[slot]].key_hash == e->key_hash) {
+                    dup = 1;
+                    break;
+                }
+                slot = (slot + 1) & (dc->table_size - 1);
+            }
+            if (!dup) {
+                dc->table[slot] = i;
+                break;
+            }
+            occurrence++;
+        }
+    }
+}
+
+int diff_cards_find(const DiffCards *dc, uint64_t key_hash) {
+    int slot = (int)(key_hash & (dc->table_size - 1));
+    while (dc->table[slot] >= 0) {
+        if (dc->entries[dc->table[slot]].key_hash == key_hash) return dc->table[slot];
+        slot = (slot + 1) & (dc->table_size - 1);
+    }
+    return -1;
+}
+
+void print_diff_line(const char *key, double ts, const char *status, const char *value, const char *filename) {
+    char time_str[64];
+    format_time_iso(ts, time_str, sizeof(time_str));
+    printf("%-20s %-24s %-18.6f %-10s %-20s %s\n", key, time_str, ts, status, value, filename);
+}
+
+// Reports the cards of cur that differ from prev; returns the number of cards reported
+int report_card_diff(DiffCards *prev, const DiffCards *cur, const DiffHeader *h) {
+    int reported = 0;
+    char key[FITS_CARD_SIZE + 1];
+    char old_value[FITS_CARD_SIZE + 1];
+    char new_value[FITS_CARD_SIZE + 1];
+    char value[2 * FITS_CARD_SIZE + 8];
+    for (int i = 0; i < prev->count; i++) prev->entries[i].matched = 0;
+
+    for (int i = 0; i < cur->count; i++) {
+        const DiffCard *c = &cur->entries[i];
+        int k = diff_cards_find(prev, c->key_hash);
+        diff_card_key(c->card, key);
+        if (k < 0) {
+            diff_card_value(c->card, 0, new_value, sizeof(new_value));
+            print_diff_line(key, h->ts, "ADDED", new_value, h->filename);
+            reported++;
+            continue;
+        }
+        DiffCard *p = &prev->entries[k];
+        p->matched = 1;
+        if (p->card_hash == c->card_hash && memcmp(p->card, c->card, FITS_CARD_SIZE) == 0) continue;
+
+        diff_card_value(p->card, 0, old_value, sizeof(old_value));
+        diff_card_value(c->card, 0, new_value, sizeof(new_value));
+        if (strcmp(old_value, new_value) == 0) {
+            diff_card_value(p->card, 1, old_value, sizeof(old_value));
+            diff_card_value(c->card, 1, new_value, sizeof(new_value));
+        }
+        snprintf(value, sizeof(value), "%s -> %s", old_value, new_value);
+        print_diff_line(key, h->ts, "CHANGE", value, h->filename);
+        reported++;
+    }
+    for (int i = 0; i < prev->count; i++) {
+        if (prev->entries[i].matched) continue;
+        diff_card_key(prev->entries[i].card, key);
+        diff_card_value(prev->entries[i].card, 0, old_value, sizeof(old_value));
+        print_diff_line(key, h->ts, "REMOVED", old_value, h->filename);
+        reported++;
+    }
+    return reported;
+}
+
+// Header of timing file <filepath>: the .fits.header sidecar (read ahead when listed in
+// ra), or the header of the .fits/.fits.fz cube. Returns 0 if there is none.
+int read_diff_header(const char *filepath, Readahead *ra, DiffHeader *h) {
+    char path[1024];
+    header_sidecar_path(filepath, path, sizeof(path));
+    size_t len = 0;
+    h->buf = NULL;
+    h->is_fits = 0;
+    if (readahead_take(ra, path, &h->buf, &len)) {
+        h->len = len;
+    } else {
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            PROF_COUNT(files_opened, 1);
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                h->buf = malloc(st.st_size);
+                ssize_t nr = read(fd, h->buf, st.st_size);
+                h->len = nr > 0 ? (size_t)nr : 0;
+                if (nr > 0) PROF_COUNT(bytes_read, nr);
+            }
+            close(fd);
+        } else {
+            // Fall back to the cube itself when the sidecar header is missing
+            int ncards = 0;
+            snprintf(path, sizeof(path), "%.*s.fits", (int)timing_stem_len(filepath), filepath);
+            h->buf = read_fits_image_header(path, &ncards);
+            if (!h->buf) {
+                strncat(path, ".fz", sizeof(path) - strlen(path) - 1);
+                h->buf = read_fits_image_header(path, &ncards);
+            }
+            h->len = (size_t)ncards * FITS_CARD_SIZE;
+            h->is_fits = 1;
+        }
+    }
+    if (!h->buf || h->len == 0) {
+        free(h->buf);
+        h->buf = NULL;
+        return 0;
+    }
+    const char *base = strrchr(path, '/');
+    snprintf(h->filename, sizeof(h->filename), "%s", base ? base + 1 : path);
+    h->hash = header_hash_bytes(h->buf, h->len, 0xcbf29ce484222325ULL);
+    return 1;
+}
+
+// Diff of consecutive headers of s over the files starting within [tstart, tend]
+void header_diff_stream(Stream *s, double tstart, double tend) {
+    Readahead *ra = NULL;
+    if (g_readahead_depth > 0 && s->file_count > 0) {
+        char **prefetch = malloc(s->file_count * sizeof(char *));
+        for (int j = 0; j < s->file_count; j++) {
+            char headerpath[1024];
+            header_sidecar_path(s->files[j].path, headerpath, sizeof(headerpath));
+            prefetch[j] = strdup(headerpath);
+        }
+        ra = readahead_create(prefetch, s->file_count, g_readahead_depth);
+        for (int j = 0; j < s->file_count; j++) free(prefetch[j]);
+        free(prefetch);
+    }
+
+    printf("\nHeader diff %s:\n", s->name);
+    DiffHeader prev = {0};
+    DiffHeader cur = {0};
+    DiffCards prev_cards = {0};
+    DiffCards cur_cards = {0};
+    long nheaders = 0, nidentical = 0, nchanged = 0;
+    for (int j = 0; j < s->file_count; j++) {
+        double file_ts;
+        if (!timing_first_timestamp(s->files[j].path, &file_ts)) continue;
+        if (file_ts < tstart || file_ts > tend) continue;
+        double t_trace = trace_begin();
+        if (!read_diff_header(s->files[j].path, ra, &cur)) continue;
+        cur.ts = file_ts;
+        nheaders++;
+
+        if (!prev.buf) {
+            diff_cards_parse(&cur, &cur_cards);
+            char value[32];
+            snprintf(value, sizeof(value), "%d cards", cur_cards.count);
+            print_diff_line("(header)", cur.ts, "INITIAL", value, cur.filename);
+        } else if (cur.hash == prev.hash && cur.len == prev.len && memcmp(cur.buf, prev.buf, cur.len) == 0) {
+            nidentical++;
+            free(cur.buf);
+            cur.buf = NULL;
+            trace_span("header_diff", "header", t_trace, cur.filename, 1, -1, (long)cur.len);
+            continue;
+        } else {
+            diff_cards_parse(&cur, &cur_cards);
+            if (report_card_diff(&prev_cards, &cur_cards, &cur) > 0) nchanged++;
+        }
+        trace_span("header_diff", "header", t_trace, cur.filename, 0, cur_cards.count, (long)cur.len);
+
+        // cur becomes the reference for the next header, with its cards already parsed
+        free(prev.buf);
+        prev = cur;
+        cur.buf = NULL;
+        DiffCards swap = prev_cards;
+        prev_cards = cur_cards;
+        cur_cards = swap;
+    }
+    printf("        %ld headers, %ld identical to the previous one, %ld with changed cards\n",
+           nheaders, nidentical, nchanged);
+
+    free(prev.buf);
+    diff_cards_free(&prev_cards);
+    diff_cards_free(&cur_cards);
+    readahead_destroy(ra);
+}
+
+// --header-diff: stream_name NULL diffs all streams. Returns 1 if stream_name has no files.
+int header_diff(StreamList *stream_list, const char *stream_name, double tstart, double tend) {
+    int found = 0;
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+        if (stream_name && strcmp(s->name, stream_name) != 0) continue;
+        found = 1;
+        header_diff_stream(s, tstart, tend);
+    }
+    if (stream_name && !found) {
+        fprintf(stderr, "Error: No files found for stream %s in range\n", stream_name);
+        return 1;
+    }
+    return 0;
+}
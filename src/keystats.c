@@ -0,0 +1,346 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+// Frames per keyword value (--keystats, with -k): every file's frames in [tstart, tend] are
+// attributed to the values its header gives to the keywords matching the -k pattern, and
+// summed per stream, keyword and value. Frame counts come from the file summaries. Header
+// cards come from a per-file header index, <file>.txt.keys next to the summary caches,
+// holding every "KEY = value" card of the header (sidecar, or cube if none) so that any -k
+// pattern is answered from it; it is checked against the size and mtime of the header.
+
+// Header of a timing file: the .fits.header sidecar, or the cube if there is none.
+// Returns 0 if neither exists.
+int header_source_path(const char *timing_path, char *out, size_t size, struct stat *st) {
+    header_sidecar_path(timing_path, out, size);
+    PROF_COUNT(stat_calls, 1);
+    if (stat(out, st) == 0) return 1;
+    if (!fits_cube_path(timing_path, out, size)) return 0;
+    PROF_COUNT(stat_calls, 1);
+    return stat(out, st) == 0;
+}
+
+// Every card with a value of header source, as "KEY\0value\0" pairs in *blob (malloc'd).
+// Returns the length of *blob, or -1 if the header cannot be read.
+long build_header_index(const char *source, char **blob) {
+    char *buf = NULL;
+    size_t card_len = FITS_CARD_SIZE; // cube cards; sidecar lines end at '\n'
+    long len = 0;
+    size_t slen = strlen(source);
+    if (slen > 7 && strcmp(source + slen - 7, ".header") == 0) {
+        int fd = open(source, O_RDONLY);
+        if (fd < 0) return -1;
+        PROF_COUNT(files_opened, 1);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return -1;
+        }
+        buf = malloc(st.st_size);
+        len = read(fd, buf, st.st_size);
+        close(fd);
+        if (len <= 0) {
+            free(buf);
+            return -1;
+        }
+        PROF_COUNT(bytes_read, len);
+        card_len = 0;
+    } else {
+        int ncards = 0;
+        buf = read_fits_image_header(source, &ncards);
+        if (!buf) return -1;
+        len = (long)ncards * FITS_CARD_SIZE;
+    }
+
+    size_t blob_len = 0;
+    FILE *out = open_memstream(blob, &blob_len);
+    char line[82];
+    char key[81];
+    char value[256];
+    const char *cur = buf;
+    const char *end = buf + len;
+    while (cur < end) {
+        size_t line_len = card_len;
+        if (line_len == 0) {
+            const char *nl = memchr(cur, '\n', end - cur);
+            line_len = nl ? (size_t)(nl - cur) + 1 : (size_t)(end - cur);
+        }
+        if (line_len > (size_t)(end - cur)) line_len = end - cur;
+        size_t take = line_len < sizeof(line) - 1 ? line_len : sizeof(line) - 1;
+        memcpy(line, cur, take);
+        line[take] = '\0';
+        cur += line_len;
+        const char *eq_pos = header_card_key(line, key);
+        if (!eq_pos || key[0] == '\0') continue;
+        header_card_value(eq_pos, value);
+        fwrite(key, 1, strlen(key) + 1, out);
+        fwrite(value, 1, strlen(value) + 1, out);
+    }
+    fclose(out);
+    free(buf);
+    return (long)blob_len;
+}
+
+int read_keys_cache(const char *cache_path, const struct stat *st, char **blob, long *len) {
+    FILE *fp = fopen(cache_path, "rb");
+    if (!fp) return 0;
+    PROF_COUNT(files_opened, 1);
+    char magic[sizeof(KEYS_CACHE_MAGIC)];
+    long size = 0, mtime_sec = 0, mtime_nsec = 0, n = 0;
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || strcmp(magic, KEYS_CACHE_MAGIC) != 0 ||
+        fread(&size, sizeof(long), 1, fp) != 1 || size != (long)st->st_size ||
+        fread(&mtime_sec, sizeof(long), 1, fp) != 1 || mtime_sec != (long)st->st_mtim.tv_sec ||
+        fread(&mtime_nsec, sizeof(long), 1, fp) != 1 || mtime_nsec != (long)st->st_mtim.tv_nsec ||
+        fread(&n, sizeof(long), 1, fp) != 1 || n < 0) {
+        fclose(fp);
+        return 0;
+    }
+    *blob = malloc(n > 0 ? n : 1);
+    if (fread(*blob, 1, n, fp) != (size_t)n) {
+        free(*blob);
+        *blob = NULL;
+        fclose(fp);
+        return 0;
+    }
+    PROF_COUNT(bytes_read, ftell(fp));
+    fclose(fp);
+    *len = n;
+    return 1;
+}
+
+void write_keys_cache(const char *cache_path, const struct stat *st, const char *blob, long len) {
+    ensure_path_exists(cache_path);
+    char tmp_path[8300];
+    FILE *fp = open_cache_tmp(cache_path, tmp_path, sizeof(tmp_path));
+    if (!fp) return;
+    long size = (long)st->st_size;
+    long mtime_sec = (long)st->st_mtim.tv_sec;
+    long mtime_nsec = (long)st->st_mtim.tv_nsec;
+    fwrite(KEYS_CACHE_MAGIC, 1, sizeof(KEYS_CACHE_MAGIC), fp);
+    fwrite(&size, sizeof(long), 1, fp);
+    fwrite(&mtime_sec, sizeof(long), 1, fp);
+    fwrite(&mtime_nsec, sizeof(long), 1, fp);
+    fwrite(&len, sizeof(long), 1, fp);
+    fwrite(blob, 1, len, fp);
+    publish_cache_tmp(fp, tmp_path, cache_path);
+}
+
+// Cards of a header index whose keyword matches the -k pattern
+void header_index_cards(const char *blob, long len, HeaderCards *hc) {
+    char key[81];
+    char value[256];
+    const char *p = blob;
+    const char *end = blob + len;
+    while (p < end) {
+        const char *v = memchr(p, '\0', end - p);
+        if (!v) break;
+        v++;
+        const char *next = memchr(v, '\0', end - v);
+        if (!next) break;
+        if (regexec(&kscan_ctx.key_regex, p, 0, NULL, 0) == 0) {
+            snprintf(key, sizeof(key), "%s", p);
+            snprintf(value, sizeof(value), "%s", v);
+            header_cards_add(hc, key, value);
+        }
+        p = next + 1;
+    }
+}
+
+typedef struct {
+    long frames;    // in [tstart, tend]
+    double seconds; // frames times the mean frame period of the file
+    double first_ts;
+    int has_header;
+    HeaderCards cards;
+} KeyStatsJob;
+
+typedef struct {
+    Stream *s;
+    KeyStatsJob *jobs;
+    int njobs;
+    int next;
+    long index_hits;
+    long headers_read;
+} KeyStatsWork;
+
+void *keystats_worker(void *arg) {
+    KeyStatsWork *w = (KeyStatsWork *)arg;
+    for (;;) {
+        int j = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (j >= w->njobs) break;
+        KeyStatsJob *job = &w->jobs[j];
+        if (job->frames == 0) continue;
+        const char *filepath = w->s->files[j].path;
+        double t_trace = trace_begin();
+        char source[1024];
+        struct stat st;
+        if (!header_source_path(filepath, source, sizeof(source), &st)) continue;
+
+        char cache_path[8192];
+        aux_cache_path(filepath, KEYS_CACHE_EXT, cache_path, sizeof(cache_path));
+        char *blob = NULL;
+        long len = 0;
+        if (!g_no_cache && read_keys_cache(cache_path, &st, &blob, &len)) {
+            __atomic_fetch_add(&w->index_hits, 1, __ATOMIC_RELAXED);
+            trace_span("header_index", "header", t_trace, filepath, 1, -1, -1);
+        } else {
+            len = build_header_index(source, &blob);
+            if (len < 0) continue;
+            __atomic_fetch_add(&w->headers_read, 1, __ATOMIC_RELAXED);
+            if (!g_no_cache) write_keys_cache(cache_path, &st, blob, len);
+            trace_span("header_index", "header", t_trace, source, g_no_cache ? -1 : 0, -1, (long)st.st_size);
+        }
+        job->has_header = 1;
+        header_index_cards(blob, len, &job->cards);
+        free(blob);
+    }
+    return NULL;
+}
+
+typedef struct {
+    int stream; // index in the stream list
+    char key[81];
+    char value[256];
+    double first_ts; // first file with this value, for the order of the table
+    long files;
+    long frames;
+    double seconds;
+} KeyValueStats;
+
+typedef struct {
+    KeyValueStats *rows;
+    int count;
+    int capacity;
+} KeyValueTable;
+
+// Row of (stream, key, value), added if new; rows of a stream are searched from its first row
+KeyValueStats *key_value_row(KeyValueTable *t, int from, int stream, const char *key, const char *value, double ts) {
+    for (int i = from; i < t->count; i++) {
+        KeyValueStats *r = &t->rows[i];
+        if (r->stream == stream && strcmp(r->key, key) == 0 && strcmp(r->value, value) == 0) return r;
+    }
+    if (t->count == t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 64;
+        t->rows = realloc(t->rows, t->capacity * sizeof(KeyValueStats));
+    }
+    KeyValueStats *r = &t->rows[t->count++];
+    memset(r, 0, sizeof(*r));
+    r->stream = stream;
+    snprintf(r->key, sizeof(r->key), "%s", key);
+    snprintf(r->value, sizeof(r->value), "%s", value);
+    r->first_ts = ts;
+    return r;
+}
+
+int key_value_row_cmp(const void *a, const void *b) {
+    const KeyValueStats *ra = a, *rb = b;
+    if (ra->stream != rb->stream) return ra->stream - rb->stream;
+    int c = strcmp(ra->key, rb->key);
+    if (c != 0) return c;
+    if (ra->first_ts < rb->first_ts) return -1;
+    if (ra->first_ts > rb->first_ts) return 1;
+    return strcmp(ra->value, rb->value);
+}
+
+void key_value_add(KeyValueStats *r, const KeyStatsJob *job) {
+    r->files++;
+    r->frames += job->frames;
+    r->seconds += job->seconds;
+}
+
+// Frames, time and files of every stream in [tstart, tend] per value of the -k keywords
+int keystats_report(StreamList *stream_list, double tstart, double tend) {
+    KeyValueTable table = {0};
+    long *stream_frames = calloc(stream_list->count > 0 ? stream_list->count : 1, sizeof(long));
+    long index_hits = 0, headers_read = 0, nfiles = 0;
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+        if (kscan_ctx.target_stream[0] != '\0' && strcmp(s->name, kscan_ctx.target_stream) != 0) continue;
+        double t_trace = trace_begin();
+
+        // Frames in range, from the summaries
+        KeyStatsWork work;
+        memset(&work, 0, sizeof(work));
+        work.s = s;
+        work.jobs = calloc(s->file_count > 0 ? s->file_count : 1, sizeof(KeyStatsJob));
+        work.njobs = s->file_count;
+        for (int j = 0; j < s->file_count; j++) {
+            KeyStatsJob *job = &work.jobs[j];
+            FileSummary summary;
+            get_file_data(s->files[j].path, &summary);
+            long first, last;
+            if (summary.is_constant) {
+                if (summary_frame_range(&summary, tstart, tend, &first, &last)) job->frames = last - first + 1;
+            } else if (summary.timestamps) {
+                job->frames = raw_count_in_range(&summary, tstart, tend);
+            }
+            double dt = (summary.count > 1) ? (summary.end - summary.start) / (summary.count - 1) : 0.0;
+            job->seconds = job->frames * dt;
+            job->first_ts = summary.start;
+            free(summary.timestamps);
+        }
+
+        // Header cards of the files with frames in range, in parallel
+        int nthreads = get_num_threads();
+        if (nthreads > work.njobs) nthreads = work.njobs;
+        if (nthreads <= 1) {
+            keystats_worker(&work);
+        } else {
+            pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+            for (int t = 0; t < nthreads; t++) pthread_create(&threads[t], NULL, keystats_worker, &work);
+            for (int t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+            free(threads);
+        }
+
+        int from = table.count;
+        for (int j = 0; j < work.njobs; j++) {
+            KeyStatsJob *job = &work.jobs[j];
+            if (job->frames > 0) {
+                nfiles++;
+                stream_frames[i] += job->frames;
+                if (!job->has_header) {
+                    key_value_add(key_value_row(&table, from, i, "-", "(no header)", job->first_ts), job);
+                } else if (job->cards.count == 0) {
+                    key_value_add(key_value_row(&table, from, i, "-", "(no matching card)", job->first_ts), job);
+                }
+                for (int c = 0; c < job->cards.count; c++) {
+                    const HeaderCard *card = &job->cards.cards[c];
+                    key_value_add(key_value_row(&table, from, i, card->key, card->value, job->first_ts), job);
+                }
+            }
+            header_cards_free(&job->cards);
+        }
+        index_hits += work.index_hits;
+        headers_read += work.headers_read;
+        free(work.jobs);
+        trace_span("keystats", "stream", t_trace, s->name, -1, s->file_count, -1);
+    }
+
+    qsort(table.rows, table.count, sizeof(KeyValueStats), key_value_row_cmp);
+    int name_w = 10, key_w = 8, value_w = 10;
+    for (int r = 0; r < table.count; r++) {
+        int len = strlen(stream_list->streams[table.rows[r].stream].name);
+        if (len > name_w) name_w = len;
+        len = strlen(table.rows[r].key);
+        if (len > key_w) key_w = len;
+        len = strlen(table.rows[r].value);
+        if (len > value_w) value_w = len;
+    }
+    char start_str[64], end_str[64];
+    format_time_iso(tstart, start_str, sizeof(start_str));
+    format_time_iso(tend, end_str, sizeof(end_str));
+    printf("Frames per value of %s from %s to %s:\n", kscan_ctx.target_key_pattern, start_str, end_str);
+    printf("  %-*s %-*s %-*s %8s %12s %14s %8s\n", name_w, "Stream", key_w, "Key", value_w, "Value",
+           "Files", "Frames", "Time", "Frames%");
+    for (int r = 0; r < table.count; r++) {
+        const KeyValueStats *row = &table.rows[r];
+        long total = stream_frames[row->stream];
+        printf("  %-*s %-*s %-*s %8ld %12ld %12.3f s %7.2f%%\n", name_w, stream_list->streams[row->stream].name,
+               key_w, row->key, value_w, row->value, row->files, row->frames, row->seconds,
+               total > 0 ? 100.0 * row->frames / total : 0.0);
+    }
+    printf("Headers: %ld from index, %ld read (%ld files with frames in range)\n", index_hits, headers_read, nfiles);
+
+    free(table.rows);
+    free(stream_frames);
+    return 0;
+}
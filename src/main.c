@@ -1,1401 +1,81 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <dirent.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <time.h>
-#include <unistd.h>
-#include <math.h>
-#include <regex.h>
-#include <sys/ioctl.h>
-#include <errno.h>
-
-// Unicode Block Elements
-const char *BLOCKS[] = {" ", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588"};
-// ANSI Colors (Blue -> Cyan -> Green -> Yellow -> Red)
-const char *COLORS[] = {
-    "\033[0m",        // 0: Reset (Space)
-    "\033[38;5;21m",  // 1: Blue
-    "\033[38;5;27m",  // 2: Blue-ish
-    "\033[38;5;39m",  // 3: Cyan
-    "\033[38;5;46m",  // 4: Green
-    "\033[38;5;118m", // 5: Light Green
-    "\033[38;5;154m", // 6: Yellow-Green
-    "\033[38;5;220m", // 7: Yellow
-    "\033[38;5;196m"  // 8: Red
-};
-#define RESET_COLOR "\033[0m"
-#define BOLD_COLOR "\033[1m"
-#define BG_HIGHLIGHT_H "\033[41m" // Red background
-#define BG_HIGHLIGHT_M "\033[44m" // Blue background
-#define BG_SCALE "\033[48;5;237m" // Dark Grey background
-#define BG_BLACK "\033[40m"       // Black background
-
-// Cache constants
-#define CACHE_DIR "cache"
-#define CACHE_EXT ".cache"
-#define BINARY_CACHE_FILENAME "telemetry.cache"
-#define BINARY_CACHE_MAGIC "MILKCACHE_V1"
-
-typedef struct {
-    int is_constant;
-    long count;
-    double start;
-    double end;
-    double *timestamps; // NULL if is_constant, otherwise array of size count
-} FileSummary;
-
-typedef struct {
-    char *key; // stream/filename
-    FileSummary summary;
-} BinaryCacheEntry;
-
-typedef struct {
-    BinaryCacheEntry *entries;
-    int count;
-    int capacity;
-    int dirty;
-    char filepath[4096];
-} BinaryCache;
-
-typedef struct {
-    char *path;
-    double timestamp;
-} FileEntry;
-
-typedef struct {
-    char name[256];
-    long total_frames;
-    int *bins;
-    int max_bin_count;
-    FileEntry *files;
-    int file_count;
-    int file_capacity;
-} Stream;
-
-typedef struct {
-    Stream *streams;
-    int count;
-    int capacity;
-} StreamList;
-
-typedef struct {
-    int is_count_line; // 1 if this is "XX files", 0 if change line
-    int count; // Used if is_count_line
-    // Used if !is_count_line
-    char stream_name[256];
-    char keyname[80];
-    double ts;
-    char status[16];
-    char value[256];
-    char filename[256];
-} ReportLine;
-
-typedef struct {
-    ReportLine *lines;
-    int count;
-    int capacity;
-} Report;
-
-typedef struct {
-    char stream_name[256];
-    char key[80];
-    char last_value[256];
-    int count_same_val;
-    int has_last_value;
-} TrackedKey;
-
-typedef struct {
-    char target_key_pattern[256];
-    regex_t key_regex;
-    char target_stream[256]; // Empty if scanning all
-
-    TrackedKey *tracked_keys;
-    int tracked_count;
-    int tracked_capacity;
-
-    Report report;
-} KeyScanContext;
-
-// Globals
-KeyScanContext kscan_ctx;
-int g_cache_export = 0;
-int g_no_cache = 0;
-long g_cache_searched = 0;
-long g_cache_found = 0;
-long g_cache_created = 0;
-
-// Binary Cache Globals
-int g_use_binary_cache = 0;
-BinaryCache *g_binary_cache = NULL;
-
-// Profiling globals
-int g_profile = 0;
-struct {
-    double start_time;
-    double discovery_time;
-    double processing_time;
-    double cache_read_time;
-    double cache_write_time;
-    double file_parse_time;
-} g_prof;
-
-void init_report(Report *r) {
-    r->count = 0;
-    r->capacity = 10;
-    r->lines = malloc(r->capacity * sizeof(ReportLine));
-}
-
-void add_report_line(Report *r, ReportLine line) {
-    if (r->count == r->capacity) {
-        r->capacity *= 2;
-        r->lines = realloc(r->lines, r->capacity * sizeof(ReportLine));
-    }
-    r->lines[r->count++] = line;
-}
-
-void free_report(Report *r) {
-    free(r->lines);
-}
-
-int compare_report_lines(const void *a, const void *b) {
-    const ReportLine *ra = (const ReportLine *)a;
-    const ReportLine *rb = (const ReportLine *)b;
-    if (ra->ts < rb->ts) return -1;
-    if (ra->ts > rb->ts) return 1;
-    return rb->is_count_line - ra->is_count_line;
-}
-
-void init_stream_list(StreamList *list) {
-    list->count = 0;
-    list->capacity = 10;
-    list->streams = malloc(list->capacity * sizeof(Stream));
-}
-
-Stream* get_or_create_stream(StreamList *list, const char *name) {
-    for (int i = 0; i < list->count; i++) {
-        if (strcmp(list->streams[i].name, name) == 0) {
-            return &list->streams[i];
-        }
-    }
-    if (list->count == list->capacity) {
-        list->capacity *= 2;
-        list->streams = realloc(list->streams, list->capacity * sizeof(Stream));
-    }
-    Stream *s = &list->streams[list->count++];
-    strncpy(s->name, name, 255);
-    s->name[255] = '\0';
-    s->total_frames = 0;
-    s->bins = NULL;
-    s->max_bin_count = 0;
-    s->files = NULL;
-    s->file_count = 0;
-    s->file_capacity = 0;
-    return s;
-}
-
-void add_file_to_stream(Stream *s, const char *path, double timestamp) {
-    if (s->file_count == s->file_capacity) {
-        s->file_capacity = (s->file_capacity == 0) ? 10 : s->file_capacity * 2;
-        s->files = realloc(s->files, s->file_capacity * sizeof(FileEntry));
-    }
-    s->files[s->file_count].path = strdup(path);
-    s->files[s->file_count].timestamp = timestamp;
-    s->file_count++;
-}
-
-void free_stream_list(StreamList *list) {
-    for (int i = 0; i < list->count; i++) {
-        Stream *s = &list->streams[i];
-        if (s->bins) free(s->bins);
-        for (int j = 0; j < s->file_count; j++) {
-            free(s->files[j].path);
-        }
-        if (s->files) free(s->files);
-    }
-    free(list->streams);
-}
-
-int is_directory(const char *path) {
-    struct stat statbuf;
-    if (stat(path, &statbuf) != 0) return 0;
-    return S_ISDIR(statbuf.st_mode);
-}
-
-double parse_time_arg(const char *arg) {
-    if (strncmp(arg, "UT", 2) == 0) {
-        struct tm tm_val;
-        memset(&tm_val, 0, sizeof(struct tm));
-        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
-
-        int count = sscanf(arg, "UT%4d%2d%2dT%2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second);
-        if (count >= 4) {
-            tm_val.tm_year = year - 1900;
-            tm_val.tm_mon = month - 1;
-            tm_val.tm_mday = day;
-            tm_val.tm_hour = hour;
-            tm_val.tm_min = minute;
-            tm_val.tm_sec = second;
-            return (double)timegm(&tm_val);
-        } else {
-             fprintf(stderr, "Warning: Failed to parse UT time format: %s. usage: UTYYYYMMDDTHH[:MM[:SS]]\n", arg);
-             return 0.0;
-        }
-    } else {
-        return atof(arg);
-    }
-}
-
-void format_time_iso(double ts, char *buf, size_t size) {
-    time_t t = (time_t)ts;
-    struct tm tm_val;
-    gmtime_r(&t, &tm_val);
-    snprintf(buf, size, "UT%04d%02d%02dT%02d:%02d:%02d",
-             tm_val.tm_year + 1900, tm_val.tm_mon + 1, tm_val.tm_mday,
-             tm_val.tm_hour, tm_val.tm_min, tm_val.tm_sec);
-}
-
-void trim_fits_value(char *val) {
-    char *start = val;
-    while (*start == ' ') start++;
-    char *end = start + strlen(start) - 1;
-    while (end > start && (*end == ' ' || *end == '\n' || *end == '\r')) end--;
-    *(end + 1) = '\0';
-    if (*start == '\'' && *end == '\'') {
-        start++;
-        *end = '\0';
-        // Remove leading spaces inside quotes
-        while (*start == ' ') start++;
-        // Remove trailing spaces inside quotes
-        char *new_end = start + strlen(start) - 1;
-        while (new_end > start && *new_end == ' ') new_end--;
-        *(new_end+1) = '\0';
-    }
-    memmove(val, start, strlen(start) + 1);
-}
-
-int read_header_keyword(const char *filepath, const char *key, char *value_out) {
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) return 0;
-
-    char line[82];
-    int found = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        if (strncmp(line, key, strlen(key)) == 0) {
-            char *eq_pos = strchr(line, '=');
-            if (eq_pos) {
-                char *slash_pos = strchr(eq_pos, '/');
-                if (slash_pos) *slash_pos = '\0';
-                strncpy(value_out, eq_pos + 1, 255);
-                value_out[255] = '\0';
-                trim_fits_value(value_out);
-                found = 1;
-                break;
-            }
-        }
-    }
-    fclose(fp);
-    return found;
-}
-
-void ensure_cache_dir_exists(const char *parent_dir) {
-    char cache_path[4096];
-    snprintf(cache_path, sizeof(cache_path), "%s/%s", parent_dir, CACHE_DIR);
-    struct stat st = {0};
-    if (stat(cache_path, &st) == -1) {
-        if (mkdir(cache_path, 0755) != 0) {
-            if (errno != EEXIST) {
-                 fprintf(stderr, "Warning: Failed to create cache directory %s: %s\n", cache_path, strerror(errno));
-            }
-        }
-    }
-}
-
-void ensure_path_exists(const char *filepath) {
-    char temp[4096];
-    strncpy(temp, filepath, sizeof(temp));
-    temp[sizeof(temp) - 1] = '\0';
-
-    // Remove filename to get dir path
-    char *last_slash = strrchr(temp, '/');
-    if (last_slash) {
-        *last_slash = '\0';
-        // Recursively create directories
-        for (char *p = temp + 1; *p; p++) {
-            if (*p == '/') {
-                *p = '\0';
-                if (mkdir(temp, 0755) != 0) {
-                    if (errno != EEXIST) {
-                        // Ignore error, maybe assume intermediate dir exists or permission issue will be caught later
-                    }
-                }
-                *p = '/';
-            }
-        }
-        if (mkdir(temp, 0755) != 0) {
-            if (errno != EEXIST) {
-                 fprintf(stderr, "Warning: Failed to create directory %s: %s\n", temp, strerror(errno));
-            }
-        }
-    }
-}
-
-int read_cache(const char *cache_path, FileSummary *summary) {
-    FILE *fp = fopen(cache_path, "r");
-    if (!fp) return 0;
-
-    char type[32];
-    if (fscanf(fp, "%31s", type) != 1) { fclose(fp); return 0; }
-
-    if (strcmp(type, "CONSTANT") == 0) {
-        summary->is_constant = 1;
-        if (fscanf(fp, "%ld %lf %lf", &summary->count, &summary->start, &summary->end) != 3) {
-            fclose(fp);
-            return 0;
-        }
-        summary->timestamps = NULL;
-    } else if (strcmp(type, "RAW") == 0) {
-        summary->is_constant = 0;
-        if (fscanf(fp, "%ld", &summary->count) != 1) {
-             fclose(fp); return 0;
-        }
-        summary->timestamps = malloc(summary->count * sizeof(double));
-        for (long i = 0; i < summary->count; i++) {
-            if (fscanf(fp, "%lf", &summary->timestamps[i]) != 1) {
-                free(summary->timestamps);
-                fclose(fp);
-                return 0;
-            }
-        }
-        // If count > 0, set start/end
-        if (summary->count > 0) {
-            summary->start = summary->timestamps[0];
-            summary->end = summary->timestamps[summary->count - 1];
-        } else {
-            summary->start = 0;
-            summary->end = 0;
-        }
-    } else {
-        fclose(fp);
-        return 0;
-    }
-
-    fclose(fp);
-    return 1;
-}
-
-int compare_bcache_entries(const void *a, const void *b) {
-    return strcmp(((BinaryCacheEntry *)a)->key, ((BinaryCacheEntry *)b)->key);
-}
-
-void flush_binary_cache() {
-    if (!g_binary_cache) return;
-    if (g_binary_cache->dirty) {
-        FILE *fp = fopen(g_binary_cache->filepath, "wb");
-        if (fp) {
-            // Header
-            fwrite(BINARY_CACHE_MAGIC, 1, strlen(BINARY_CACHE_MAGIC) + 1, fp);
-            fwrite(&g_binary_cache->count, sizeof(int), 1, fp);
-
-            // Sort entries for deterministic output and faster search (if loaded sorted)
-            // But we maintain it sorted or sort on save? Let's sort on save.
-            qsort(g_binary_cache->entries, g_binary_cache->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
-
-            for (int i = 0; i < g_binary_cache->count; i++) {
-                BinaryCacheEntry *e = &g_binary_cache->entries[i];
-                int key_len = strlen(e->key) + 1;
-                fwrite(&key_len, sizeof(int), 1, fp);
-                fwrite(e->key, 1, key_len, fp);
-                fwrite(&e->summary.is_constant, sizeof(int), 1, fp);
-                fwrite(&e->summary.count, sizeof(long), 1, fp);
-                if (e->summary.is_constant) {
-                    fwrite(&e->summary.start, sizeof(double), 1, fp);
-                    fwrite(&e->summary.end, sizeof(double), 1, fp);
-                } else {
-                    if (e->summary.count > 0) {
-                        fwrite(e->summary.timestamps, sizeof(double), e->summary.count, fp);
-                    }
-                }
-            }
-            fclose(fp);
-            g_cache_created++; // Count monolithic file creation as 1 creation? Or just leave it?
-            // Actually user asked to report cache created. Reporting 1 for the binary file is correct.
-        } else {
-             fprintf(stderr, "Warning: Failed to write binary cache %s: %s\n", g_binary_cache->filepath, strerror(errno));
-        }
-    }
-    // Free
-    for (int i = 0; i < g_binary_cache->count; i++) {
-        free(g_binary_cache->entries[i].key);
-        if (g_binary_cache->entries[i].summary.timestamps) {
-            free(g_binary_cache->entries[i].summary.timestamps);
-        }
-    }
-    free(g_binary_cache->entries);
-    free(g_binary_cache);
-    g_binary_cache = NULL;
-}
-
-void load_binary_cache(const char *filepath) {
-    if (g_binary_cache) flush_binary_cache();
-
-    g_binary_cache = calloc(1, sizeof(BinaryCache));
-    strncpy(g_binary_cache->filepath, filepath, 4095);
-
-    FILE *fp = fopen(filepath, "rb");
-    if (!fp) return; // New cache
-
-    char magic[32];
-    // Read magic string (null terminated)
-    // We assume it matches length of define.
-    size_t magic_len = strlen(BINARY_CACHE_MAGIC) + 1;
-    if (fread(magic, 1, magic_len, fp) != magic_len || strcmp(magic, BINARY_CACHE_MAGIC) != 0) {
-        // Invalid or version mismatch
-        fclose(fp);
-        return;
-    }
-
-    int count = 0;
-    if (fread(&count, sizeof(int), 1, fp) != 1) { fclose(fp); return; }
-
-    g_binary_cache->count = count;
-    g_binary_cache->capacity = count + 100; // Preallocate some extra
-    g_binary_cache->entries = malloc(g_binary_cache->capacity * sizeof(BinaryCacheEntry));
-
-    for (int i = 0; i < count; i++) {
-        BinaryCacheEntry *e = &g_binary_cache->entries[i];
-        int key_len = 0;
-        if (fread(&key_len, sizeof(int), 1, fp) != 1) break;
-        e->key = malloc(key_len);
-        if (fread(e->key, 1, key_len, fp) != (size_t)key_len) break;
-
-        if (fread(&e->summary.is_constant, sizeof(int), 1, fp) != 1) break;
-        if (fread(&e->summary.count, sizeof(long), 1, fp) != 1) break;
-
-        e->summary.timestamps = NULL;
-        e->summary.start = 0;
-        e->summary.end = 0;
-
-        if (e->summary.is_constant) {
-            if (fread(&e->summary.start, sizeof(double), 1, fp) != 1) break;
-            if (fread(&e->summary.end, sizeof(double), 1, fp) != 1) break;
-        } else {
-            if (e->summary.count > 0) {
-                e->summary.timestamps = malloc(e->summary.count * sizeof(double));
-                if (fread(e->summary.timestamps, sizeof(double), e->summary.count, fp) != (size_t)e->summary.count) {
-                    free(e->summary.timestamps);
-                    e->summary.timestamps = NULL;
-                    break;
-                }
-                // Set bounds
-                e->summary.start = e->summary.timestamps[0];
-                e->summary.end = e->summary.timestamps[e->summary.count - 1];
-            }
-        }
-    }
-    fclose(fp);
-    g_binary_cache->dirty = 0;
-    // Assuming file on disk is sorted
-}
-
-void add_to_binary_cache(const char *key, const FileSummary *summary) {
-    if (!g_binary_cache) return;
-    if (g_binary_cache->count == g_binary_cache->capacity) {
-        g_binary_cache->capacity = (g_binary_cache->capacity == 0) ? 100 : g_binary_cache->capacity * 2;
-        g_binary_cache->entries = realloc(g_binary_cache->entries, g_binary_cache->capacity * sizeof(BinaryCacheEntry));
-    }
-    BinaryCacheEntry *e = &g_binary_cache->entries[g_binary_cache->count++];
-    e->key = strdup(key);
-    e->summary = *summary; // Shallow copy
-    // Deep copy timestamps if needed
-    if (summary->timestamps) {
-        e->summary.timestamps = malloc(summary->count * sizeof(double));
-        memcpy(e->summary.timestamps, summary->timestamps, summary->count * sizeof(double));
-    }
-    g_binary_cache->dirty = 1;
-}
-
-FileSummary* find_in_binary_cache(const char *key) {
-    if (!g_binary_cache) return NULL;
-
-    // Use bsearch
-    BinaryCacheEntry target;
-    target.key = (char*)key;
-    // Note: bsearch requires the array to be sorted.
-    // If we just added entries (dirty), it might not be sorted.
-    // Optimization: if strictly appending alpha, it remains sorted.
-    // But scan order is alpha. So appending usually preserves sort.
-    // But to be safe, if dirty, we might need linear search or sort?
-    // Sorting every add is slow.
-    // Linear search for new entries + bsearch for old?
-    // Given the constraints and typical use, simple linear search if not sorted?
-    // Let's just assume sorted for the loaded part, and linear scan the rest?
-    // Or just linear scan all? N ~ 1000s. Fast enough in memory.
-    // Let's implement bsearch for loaded entries and assume sort.
-    // Wait, if I add entries, I break sort if not careful.
-    // For now, let's stick to bsearch on the whole thing but we must ensure sort.
-    // Actually, `scan_stream_dir` calls alphasort. So we add in order.
-    // So the array *should* be sorted.
-    // We can assume sorted.
-
-    void *res = bsearch(&target, g_binary_cache->entries, g_binary_cache->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
-    if (res) {
-        return &((BinaryCacheEntry*)res)->summary;
-    }
-    return NULL;
-}
-
-void write_cache(const char *cache_path, const FileSummary *summary) {
-    FILE *fp = fopen(cache_path, "w");
-    if (!fp) return;
-
-    if (summary->is_constant) {
-        fprintf(fp, "CONSTANT %ld %.9f %.9f\n", summary->count, summary->start, summary->end);
-    } else {
-        fprintf(fp, "RAW %ld\n", summary->count);
-        for (long i = 0; i < summary->count; i++) {
-            fprintf(fp, "%.9f\n", summary->timestamps[i]);
-        }
-    }
-    fclose(fp);
-}
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <limits.h>
 
 void print_help(const char *progname) {
     fprintf(stderr, "Usage: %s [options] <dir> <tstart> [<tend>]\n", progname);
     fprintf(stderr, "\nArguments:\n");
-    fprintf(stderr, "  <dir>                 Root directory for telemetry data.\n");
+    fprintf(stderr, "  <dir>                 Root directory for telemetry data. Several roots separated by ':' are\n");
+    fprintf(stderr, "                        scanned as one archive (streams of the same name are merged).\n");
     fprintf(stderr, "  <tstart>              Start time (e.g., UTYYYYMMDDTHH:MM:SS or unix timestamp).\n");
     fprintf(stderr, "  <tend>                End time (optional if -a is used).\n");
     fprintf(stderr, "\nOptions:\n");
     fprintf(stderr, "  -k <KEYNAME>          Search for keyword <KEYNAME> in FITS headers.\n");
     fprintf(stderr, "  -k <STREAM>:<KEY>     Search for <KEY> only in <STREAM>.\n");
+    fprintf(stderr, "                        Headers are read from .fits.header, or from .fits/.fits.fz if missing.\n");
+    fprintf(stderr, "  -roots <file>         Roots listed in <file>, one per line, instead of <dir> (not given then).\n");
     fprintf(stderr, "  -a                    Auto-adjust time range to data in date directory.\n");
     fprintf(stderr, "  -cacheexport          Write cache to source directory instead of local cache/.\n");
     fprintf(stderr, "  -bcache               Write all cache for a full night in a binary file for optimal performance.\n");
+    fprintf(stderr, "  -cacheroot <dir>      Shared cache tree instead of local cache/ (data paths are made absolute,\n");
+    fprintf(stderr, "                        so that all users of an archive share one cache).\n");
     fprintf(stderr, "  -nc                   No Cache. Disable cache reading and writing.\n");
+    fprintf(stderr, "  -rate                 Show per-bin frame rate row (interval statistics) for each stream.\n");
+    fprintf(stderr, "  -rateexport <file>    Write per-bin interval statistics (min/mean/max/std) to <file>.\n");
+    fprintf(stderr, "  -latency              Show logging latency (col4 - col5) per stream: p50/p99/p99.9/max\n");
+    fprintf(stderr, "                        and a per-bin max latency row.\n");
+    fprintf(stderr, "  -flux <STREAM>        Show per-bin mean pixel value of <STREAM>, computed from uncompressed FITS cubes.\n");
+    fprintf(stderr, "  -fluxmax              With -flux, also show per-bin max pixel value.\n");
+    fprintf(stderr, "  -j <N>                Number of worker threads (default: number of CPUs).\n");
+    fprintf(stderr, "  -readahead <N>        Timing/header files read ahead of the parser (default 16, 0 disables).\n");
+    fprintf(stderr, "  -noprobe              Parse every uncached timing file in full (no fixed-width record probe).\n");
+    fprintf(stderr, "  -tui                  Interactive timeline: zoom, pan and select streams from memory.\n");
     fprintf(stderr, "  -prof                 Enable profiling output.\n");
+    fprintf(stderr, "  -prof=json[:<file>]   Profiling output as JSON (I/O counters, latency histograms, memory),\n");
+    fprintf(stderr, "                        written to stderr, or to <file> when given.\n");
+    fprintf(stderr, "  --trace <out.json>    Record scan phases and per-file spans as a Chrome/Perfetto trace.\n");
+    fprintf(stderr, "  --extract <stream> <tstart> <tend> <out.fits>\n");
+    fprintf(stderr, "                        Extract frames of <stream> within [tstart, tend] into a single FITS cube\n");
+    fprintf(stderr, "                        and matching timing file (only <dir> is needed as positional argument).\n");
+    fprintf(stderr, "  --header-diff[=<stream>]\n");
+    fprintf(stderr, "                        Report the header cards that change from one file to the next in [tstart, tend],\n");
+    fprintf(stderr, "                        for <stream> or all streams, instead of the timeline.\n");
+    fprintf(stderr, "  --manifest <out.tsv>  Write, instead of the timeline, the cube and timing paths of every file with frames\n");
+    fprintf(stderr, "                        in [tstart, tend], with the frame index range, count and first/last timestamps\n");
+    fprintf(stderr, "                        (- for stdout).\n");
+    fprintf(stderr, "  --coverage <s1,s2,...>\n");
+    fprintf(stderr, "                        List the intervals of [tstart, tend] where all the given streams were logging,\n");
+    fprintf(stderr, "                        with their durations and the total usable time, instead of the timeline.\n");
+    fprintf(stderr, "  --ranges <file>       Answer every range of <file> (lines \"<tstart> <tend> [<label>]\") with one\n");
+    fprintf(stderr, "                        timeline block each, from a single scan of their union (only <dir> is needed\n");
+    fprintf(stderr, "                        as positional argument).\n");
+    fprintf(stderr, "  --keystats            With -k, sum the frames, acquisition time and files of every stream in\n");
+    fprintf(stderr, "                        [tstart, tend] per value of the matching keywords, instead of the timeline.\n");
     fprintf(stderr, "  -h, --help            Show this help message.\n");
 }
 
-double get_current_time() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return ts.tv_sec + ts.tv_nsec * 1e-9;
-}
-
-TrackedKey* get_tracked_key(const char *stream, const char *key) {
-    for (int i = 0; i < kscan_ctx.tracked_count; i++) {
-        if (strcmp(kscan_ctx.tracked_keys[i].stream_name, stream) == 0 &&
-            strcmp(kscan_ctx.tracked_keys[i].key, key) == 0) {
-            return &kscan_ctx.tracked_keys[i];
-        }
-    }
-    if (kscan_ctx.tracked_count == kscan_ctx.tracked_capacity) {
-        kscan_ctx.tracked_capacity = (kscan_ctx.tracked_capacity == 0) ? 10 : kscan_ctx.tracked_capacity * 2;
-        kscan_ctx.tracked_keys = realloc(kscan_ctx.tracked_keys, kscan_ctx.tracked_capacity * sizeof(TrackedKey));
-    }
-    TrackedKey *tk = &kscan_ctx.tracked_keys[kscan_ctx.tracked_count++];
-    strncpy(tk->stream_name, stream, 255);
-    strncpy(tk->key, key, 79);
-    tk->key[79] = '\0';
-    tk->last_value[0] = '\0';
-    tk->count_same_val = 0;
-    tk->has_last_value = 0;
-    return tk;
-}
-
-void process_header_for_key(const char *header_path, const char *stream_name, double file_timestamp) {
-    FILE *fp = fopen(header_path, "r");
-    if (!fp) return;
-
-    char line[82];
-    while (fgets(line, sizeof(line), fp)) {
-        char key[81];
-        char value[256];
-        char *eq_pos = strchr(line, '=');
-
-        if (eq_pos) {
-            size_t key_len = eq_pos - line;
-            if (key_len > 80) key_len = 80;
-            strncpy(key, line, key_len);
-            key[key_len] = '\0';
-
-            char *end = key + strlen(key) - 1;
-            while (end >= key && (*end == ' ' || *end == '\t')) *end-- = '\0';
-
-            if (regexec(&kscan_ctx.key_regex, key, 0, NULL, 0) == 0) {
-                char *slash_pos = strchr(eq_pos, '/');
-                if (slash_pos) *slash_pos = '\0';
-                strncpy(value, eq_pos + 1, 255);
-                value[255] = '\0';
-                trim_fits_value(value);
-
-                TrackedKey *tk = get_tracked_key(stream_name, key);
-                const char *base = strrchr(header_path, '/');
-                if (base) base++; else base = header_path;
-
-                if (!tk->has_last_value) {
-                    ReportLine rl;
-                    rl.is_count_line = 0;
-                    strncpy(rl.stream_name, stream_name, 255);
-                    strncpy(rl.keyname, key, 79);
-                    rl.ts = file_timestamp;
-                    strcpy(rl.status, "INITIAL");
-                    strncpy(rl.value, value, 255);
-                    strncpy(rl.filename, base, 255);
-                    add_report_line(&kscan_ctx.report, rl);
-
-                    strncpy(tk->last_value, value, 255);
-                    tk->count_same_val = 1;
-                    tk->has_last_value = 1;
-                } else {
-                    if (strcmp(value, tk->last_value) != 0) {
-                        ReportLine count_line;
-                        count_line.is_count_line = 1;
-                        count_line.count = tk->count_same_val;
-                        count_line.ts = file_timestamp;
-                        strncpy(count_line.keyname, key, 79);
-                        strncpy(count_line.stream_name, stream_name, 255);
-                        add_report_line(&kscan_ctx.report, count_line);
-
-                        ReportLine change_line;
-                        change_line.is_count_line = 0;
-                        strncpy(change_line.stream_name, stream_name, 255);
-                        strncpy(change_line.keyname, key, 79);
-                        change_line.ts = file_timestamp;
-                        strcpy(change_line.status, "CHANGE");
-                        strncpy(change_line.value, value, 255);
-                        strncpy(change_line.filename, base, 255);
-                        add_report_line(&kscan_ctx.report, change_line);
-
-                        strncpy(tk->last_value, value, 255);
-                        tk->count_same_val = 1;
-                    } else {
-                        tk->count_same_val++;
-                    }
-                }
-            }
-        }
-    }
-    fclose(fp);
-}
-
-double parse_filename_time(const char *filename, const char *date_str) {
-    // filename format: sname_HH:MM:SS.sssssssss.txt
-    // date_str: YYYYMMDD
-    // find the time part. It should be 18 chars before .txt
-    size_t len = strlen(filename);
-    if (len < 22) return 0.0; // Minimal check
-
-    // Pointer to start of time string
-    // Assuming format is always ending in ...HH:MM:SS.sssssssss.txt
-    const char *time_part = filename + len - 4 - 18;
-
-    // Reconstruct full ISO string: YYYYMMDDTHH:MM:SS.sssssssss
-    // But we need to use timegm.
-
-    struct tm tm_val;
-    memset(&tm_val, 0, sizeof(struct tm));
-
-    int year, month, day;
-    if (sscanf(date_str, "%4d%2d%2d", &year, &month, &day) != 3) return 0.0;
-
-    int hour, minute, second;
-    double frac_sec = 0.0;
-
-    if (sscanf(time_part, "%2d:%2d:%2d", &hour, &minute, &second) != 3) {
-         return 0.0;
-    }
-
-    // Parse fractional seconds
-    const char *frac_str = time_part + 8; // .sssssssss
-    frac_sec = atof(frac_str);
-
-    tm_val.tm_year = year - 1900;
-    tm_val.tm_mon = month - 1;
-    tm_val.tm_mday = day;
-    tm_val.tm_hour = hour;
-    tm_val.tm_min = minute;
-    tm_val.tm_sec = second;
-
-    time_t t = timegm(&tm_val);
-    return (double)t + frac_sec;
-}
-
-void get_file_data(const char *filepath, FileSummary *summary) {
-    // Construct both potential cache paths
-    char local_cache_path[8192];
-    char export_cache_path[8192];
-    char *dir_sep = strrchr(filepath, '/');
-
-    if (!g_no_cache) {
-        g_cache_searched++;
-
-        // Binary Cache Logic
-        if (g_use_binary_cache) {
-            // Find key: stream/filename.
-            // filepath is root/date/stream/filename.
-            // dir_sep points to last slash.
-            // We need stream/filename.
-            // Assumption: structure is standard.
-            // if no dir_sep, just filename.
-            const char *key = filepath;
-            if (dir_sep) {
-                // Find previous slash
-                char *prev_slash = NULL;
-                for (char *p = dir_sep - 1; p >= filepath; p--) {
-                    if (*p == '/') {
-                        prev_slash = p;
-                        break;
-                    }
-                }
-                if (prev_slash) key = prev_slash + 1;
-                else key = dir_sep + 1; // Fallback
-            }
-
-            // Ensure correct binary cache file is loaded
-            // Construct expected path: root/date/telemetry.cache
-            // We need to extract date dir.
-            char date_dir_path[4096];
-            if (dir_sep) {
-                // Find parent of stream dir.
-                // filepath: .../date/stream/file
-                // dir_sep -> /file
-                // prev_slash -> /stream
-                // prev_prev_slash -> /date
-                char *prev_slash = NULL;
-                for (char *p = dir_sep - 1; p >= filepath; p--) {
-                    if (*p == '/') {
-                        prev_slash = p;
-                        break;
-                    }
-                }
-                char *prev_prev_slash = NULL;
-                if (prev_slash) {
-                    for (char *p = prev_slash - 1; p >= filepath; p--) {
-                        if (*p == '/') {
-                            prev_prev_slash = p;
-                            break;
-                        }
-                    }
-                }
-
-                size_t len = 0;
-                if (prev_prev_slash) {
-                    // date_dir is up to prev_slash (exclusive of slash? no, inclusive?)
-                    // .../date is path?
-                    // We want directory containing stream directories.
-                    // Actually, structure is root/date/stream/file.
-                    // Cache should be in root/date/telemetry.cache.
-                    // So we want path up to prev_slash? No, prev_slash is /stream.
-                    // path up to prev_slash is root/date/stream.
-                    // We want root/date.
-                    len = prev_prev_slash - filepath;
-                    // Wait, if prev_prev_slash is /date, then we want up to prev_prev_slash?
-                    // No, prev_prev_slash is start of /date? Or end of root?
-                    // /root/date/stream/file
-                    //        ^ prev_prev
-                    //             ^ prev
-                    //                    ^ dir_sep
-                    // So date dir is up to prev_slash? No.
-                    // date dir is `root/date`.
-                    // It ends at `prev_prev_slash`? No.
-                    // `prev_prev_slash` points to slash before `date`? No, slash before `stream`.
-                    // `prev_slash` points to slash before `file`.
-
-                    // Example: data/20251106/stream/file.txt
-                    // dir_sep points to /file.txt
-                    // prev_slash points to /stream
-                    // path up to prev_slash is data/20251106/stream.
-                    // We want data/20251106.
-                    // So we need slash before stream. That is prev_slash!
-                    // Wait, prev_slash is the slash before 'stream'?
-                    // data/20251106/stream/file.txt
-                    //              ^ prev_slash
-                    // path up to prev_slash is data/20251106.
-                    len = prev_slash - filepath;
-                } else if (prev_slash) {
-                    // path/stream/file.txt
-                    //      ^ prev_slash
-                    len = prev_slash - filepath;
-                } else {
-                    // file.txt or stream/file.txt?
-                    // If just file.txt, dir_sep is null.
-                    // If stream/file.txt, dir_sep is /file.txt. prev_slash is null.
-                    // We default to current dir.
-                    len = 0;
-                }
-
-                if (len > 0) {
-                    if (len >= sizeof(date_dir_path)) len = sizeof(date_dir_path) - 1;
-                    strncpy(date_dir_path, filepath, len);
-                    date_dir_path[len] = '\0';
-                } else {
-                    strcpy(date_dir_path, ".");
-                }
-            } else {
-                strcpy(date_dir_path, ".");
-            }
-
-            char bcache_path[8192];
-            if (g_cache_export) {
-                snprintf(bcache_path, sizeof(bcache_path), "%s/%s", date_dir_path, BINARY_CACHE_FILENAME);
-            } else {
-                snprintf(bcache_path, sizeof(bcache_path), "%s/%s/%s", CACHE_DIR, date_dir_path, BINARY_CACHE_FILENAME);
-                ensure_path_exists(bcache_path);
-            }
-
-            // Check if loaded matches
-            if (!g_binary_cache || strcmp(g_binary_cache->filepath, bcache_path) != 0) {
-                load_binary_cache(bcache_path);
-            }
-
-            // Search
-            double t0 = 0;
-            if (g_profile) t0 = get_current_time();
-            FileSummary *s = find_in_binary_cache(key);
-            if (g_profile) g_prof.cache_read_time += (get_current_time() - t0);
-
-            if (s) {
-                g_cache_found++;
-                *summary = *s;
-                // Deep copy timestamps for caller to own (if raw)
-                if (s->timestamps) {
-                    summary->timestamps = malloc(s->count * sizeof(double));
-                    memcpy(summary->timestamps, s->timestamps, s->count * sizeof(double));
-                }
-                return;
-            }
-        } else {
-            // Per-file Cache Logic
-            snprintf(local_cache_path, sizeof(local_cache_path), "%s/%s%s", CACHE_DIR, filepath, CACHE_EXT);
-
-            if (dir_sep) {
-                char dir_path[4096];
-                size_t dir_len = dir_sep - filepath;
-                if (dir_len >= sizeof(dir_path)) dir_len = sizeof(dir_path) - 1;
-                strncpy(dir_path, filepath, dir_len);
-                dir_path[dir_len] = '\0';
-                snprintf(export_cache_path, sizeof(export_cache_path), "%s/%s/%s%s", dir_path, CACHE_DIR, dir_sep + 1, CACHE_EXT);
-            } else {
-                 snprintf(export_cache_path, sizeof(export_cache_path), "%s/%s%s", CACHE_DIR, filepath, CACHE_EXT);
-            }
-
-            // Try reading (Priority: Local, then Export)
-            // Actually, user said: "The program will look for the cache in both location, and report if found."
-            // We check local first.
-            double t0 = 0;
-            if (g_profile) t0 = get_current_time();
-            int found = 0;
-            if (read_cache(local_cache_path, summary)) {
-                found = 1;
-            } else if (read_cache(export_cache_path, summary)) {
-                found = 1;
-            }
-            if (g_profile) g_prof.cache_read_time += (get_current_time() - t0);
-
-            if (found) {
-                g_cache_found++;
-                return;
-            }
-        }
-    }
-
-    // Cache miss, process text file
-    summary->is_constant = 0;
-    summary->count = 0;
-    summary->timestamps = NULL;
-    summary->start = 0;
-    summary->end = 0;
-
-    double t_parse_start = 0;
-    if (g_profile) t_parse_start = get_current_time();
-
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) return;
-
-    // Use a temporary dynamic array to store timestamps
-    size_t cap = 1000;
-    double *ts_arr = malloc(cap * sizeof(double));
-    long count = 0;
-
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        if (line[0] == '#') continue;
-        char *token = strtok(line, " \t");
-        int col = 0;
-        double timestamp = 0.0;
-        int found = 0;
-        while (token) {
-            if (col == 4) { timestamp = atof(token); found = 1; break; }
-            token = strtok(NULL, " \t");
-            col++;
-        }
-        if (found) {
-            if (count == cap) {
-                cap *= 2;
-                ts_arr = realloc(ts_arr, cap * sizeof(double));
-            }
-            ts_arr[count++] = timestamp;
-        }
-    }
-    fclose(fp);
-
-    if (g_profile) g_prof.file_parse_time += (get_current_time() - t_parse_start);
-
-    summary->count = count;
-    summary->timestamps = ts_arr;
-    if (count > 0) {
-        summary->start = ts_arr[0];
-        summary->end = ts_arr[count - 1];
-    }
-
-    // Analyze for constant frame rate
-    if (count > 2) {
-        double dt_sum = 0;
-        for (long i = 0; i < count - 1; i++) {
-            dt_sum += (ts_arr[i+1] - ts_arr[i]);
-        }
-        double mean_dt = dt_sum / (count - 1);
-        int constant = 1;
-        for (long i = 0; i < count - 1; i++) {
-            double dt = ts_arr[i+1] - ts_arr[i];
-            if (fabs(dt - mean_dt) > 0.10 * mean_dt) {
-                constant = 0;
-                break;
-            }
-        }
-        if (constant) {
-            summary->is_constant = 1;
-            free(summary->timestamps);
-            summary->timestamps = NULL;
-        }
-    }
-
-    // Write cache
-    if (!g_no_cache) {
-        if (g_use_binary_cache) {
-            // Add to binary cache
-            const char *key = filepath;
-            if (dir_sep) {
-                // Find previous slash logic again...
-                // Wait, we can reuse logic or better make a helper.
-                // But for now inline logic to match reading.
-                char *prev_slash = NULL;
-                for (char *p = dir_sep - 1; p >= filepath; p--) {
-                    if (*p == '/') {
-                        prev_slash = p;
-                        break;
-                    }
-                }
-                if (prev_slash) key = prev_slash + 1;
-                else key = dir_sep + 1;
-            }
-            double t_write = 0;
-            if (g_profile) t_write = get_current_time();
-            add_to_binary_cache(key, summary);
-            // Note: g_cache_created is incremented when FLUSHING binary cache, not here.
-            // But user might want to see count of files added?
-            // "created" implies files. For binary cache, we create 1 file per night.
-            // So we increment in flush_binary_cache.
-            if (g_profile) g_prof.cache_write_time += (get_current_time() - t_write);
-        } else {
-            if (g_cache_export) {
-                if (dir_sep) {
-                    char dir_path[4096];
-                    size_t dir_len = dir_sep - filepath;
-                    if (dir_len >= sizeof(dir_path)) dir_len = sizeof(dir_path) - 1;
-                    strncpy(dir_path, filepath, dir_len);
-                    dir_path[dir_len] = '\0';
-                    ensure_cache_dir_exists(dir_path);
-                } else {
-                    ensure_cache_dir_exists(".");
-                }
-                double t_write = 0;
-                if (g_profile) t_write = get_current_time();
-                write_cache(export_cache_path, summary);
-                if (g_profile) g_prof.cache_write_time += (get_current_time() - t_write);
-            } else {
-                ensure_path_exists(local_cache_path);
-                double t_write = 0;
-                if (g_profile) t_write = get_current_time();
-                write_cache(local_cache_path, summary);
-                if (g_profile) g_prof.cache_write_time += (get_current_time() - t_write);
-            }
-            g_cache_created++;
-        }
-    }
-}
-
-// pass 0 = count frames and populate file list, pass 1 = binning and headers (using cached files)
-void scan_stream_dir(const char *path, const char *stream_name, double tstart, double tend, StreamList *streams, int num_bins, int pass, long *file_count) {
-    if (pass != 0) return; // Only used for pass 0 now
-
-    printf("Scanning %s\n", path);
-    struct dirent **namelist;
-    int n = scandir(path, &namelist, NULL, alphasort);
-    if (n < 0) return;
-
-    // Get date from path (parent directory name)
-    // path format: .../YYYYMMDD/stream_name
-    char *path_copy = strdup(path);
-    // Remove trailing slash if any
-    size_t p_len = strlen(path_copy);
-    if (p_len > 0 && path_copy[p_len-1] == '/') path_copy[p_len-1] = '\0';
-
-    char *last_slash = strrchr(path_copy, '/');
-    char date_str[32] = {0};
-    if (last_slash) {
-        *last_slash = '\0'; // Terminate at stream_name slash
-        char *parent_slash = strrchr(path_copy, '/');
-        if (parent_slash) {
-             strncpy(date_str, parent_slash + 1, 31);
-        } else {
-             strncpy(date_str, path_copy, 31); // No parent slash, so this is the date dir?
-        }
-    } else {
-        // Should not happen given the structure, but fallback
-        strncpy(date_str, "19700101", 31);
-    }
-    free(path_copy);
-
-    // Pre-calculate timestamps for filtering
-    double *timestamps = malloc(n * sizeof(double));
-    for (int i = 0; i < n; i++) {
-        struct dirent *dir = namelist[i];
-        size_t len = strlen(dir->d_name);
-        if (len > 4 && strcmp(dir->d_name + len - 4, ".txt") == 0) {
-             timestamps[i] = parse_filename_time(dir->d_name, date_str);
-        } else {
-             timestamps[i] = 0.0;
-        }
-    }
-
-    for (int i = 0; i < n; i++) {
-        struct dirent *dir = namelist[i];
-        if (dir->d_name[0] == '.') {
-            free(namelist[i]);
-            continue;
-        }
-
-        size_t len = strlen(dir->d_name);
-        if (len > 4 && strcmp(dir->d_name + len - 4, ".txt") == 0) {
-
-            double file_ts = timestamps[i];
-
-            // Optimization: Skip files outside range
-            // 1. If this file starts after tend, we can stop (assuming sorted)
-            if (file_ts > tend) {
-                free(namelist[i]);
-                continue;
-                // We could break here if we trust sort order completely and that filenames are chronological.
-                // alphasort on "sname_HH..." is chronological.
-                // However, there might be other streams mixed in? No, directory is per stream.
-                // So break is safe.
-                // But let's be safe and just continue for now or check stream name consistency?
-                // The directory contains files for ONE stream: "sname".
-                // So break is safe.
-                // break;
-            }
-
-            // 2. If next file starts before tstart, then this file ends before tstart
-            // (assuming contiguous or close files)
-            int skip = 0;
-            // Find next valid file timestamp
-            for (int k = i + 1; k < n; k++) {
-                if (timestamps[k] > 0.0) {
-                    if (timestamps[k] < tstart) {
-                        skip = 1;
-                    }
-                    break;
-                }
-            }
-
-            if (skip) {
-                free(namelist[i]);
-                continue;
-            }
-
-            if (file_count) {
-                (*file_count)++;
-            }
-
-            char filepath[1024];
-            snprintf(filepath, sizeof(filepath), "%s/%s", path, dir->d_name);
-
-            Stream *s = get_or_create_stream(streams, stream_name);
-            add_file_to_stream(s, filepath, file_ts);
-
-            // Pass 0: Count frames
-            FileSummary summary;
-            get_file_data(filepath, &summary);
-
-            // If constant, we can check overlap with [tstart, tend] analytically
-            if (summary.is_constant) {
-                if (summary.count > 0) {
-                    // Check if file range overlaps with scan range
-                    if (summary.end >= tstart && summary.start <= tend) {
-                        // Count frames inside [tstart, tend]
-                        // Assume linear distribution
-                        if (summary.start >= tstart && summary.end <= tend) {
-                            s->total_frames += summary.count;
-                        } else {
-                            // Partial overlap
-                             double dt = (summary.end - summary.start) / (summary.count > 1 ? summary.count - 1 : 1);
-                             if (dt > 0) {
-                                 double first_t = summary.start;
-                                 long start_idx = 0;
-                                 if (first_t < tstart) {
-                                     start_idx = (long)ceil((tstart - first_t) / dt);
-                                 }
-                                 long end_idx = summary.count - 1;
-                                 if (summary.end > tend) {
-                                     end_idx = (long)floor((tend - first_t) / dt);
-                                 }
-                                 if (start_idx <= end_idx) {
-                                     s->total_frames += (end_idx - start_idx + 1);
-                                 }
-                             } else {
-                                 // Single frame
-                                 if (summary.start >= tstart && summary.start <= tend) s->total_frames++;
-                             }
-                        }
-                    }
-                }
-            } else {
-                if (summary.timestamps) {
-                    for (long k = 0; k < summary.count; k++) {
-                        if (summary.timestamps[k] >= tstart && summary.timestamps[k] <= tend) {
-                            s->total_frames++;
-                        }
-                    }
-                    free(summary.timestamps);
-                }
-            }
-        }
-        free(namelist[i]);
-    }
-    free(timestamps);
-    free(namelist);
-}
-
-void process_stream_data(StreamList *stream_list, double tstart, double tend, int num_bins) {
-    for (int i = 0; i < stream_list->count; i++) {
-        Stream *s = &stream_list->streams[i];
-
-        for (int j = 0; j < s->file_count; j++) {
-            char *filepath = s->files[j].path;
-
-            // Header Scan
-            if (kscan_ctx.target_key_pattern[0] != '\0') {
-                int process_this = 1;
-                if (kscan_ctx.target_stream[0] != '\0' && strcmp(s->name, kscan_ctx.target_stream) != 0) {
-                    process_this = 0;
-                }
-                if (process_this) {
-                    char headerpath[1024];
-                    strncpy(headerpath, filepath, sizeof(headerpath));
-                    headerpath[strlen(filepath) - 4] = '\0';
-                    strncat(headerpath, ".fits.header", sizeof(headerpath) - strlen(headerpath) - 1);
-
-                    FILE *fp = fopen(filepath, "r");
-                    if (fp) {
-                        char line[1024];
-                        double file_ts = 0.0;
-                        while(fgets(line, sizeof(line), fp)) {
-                            if (line[0] == '#') continue;
-                            char *token = strtok(line, " \t");
-                            int col = 0;
-                            while (token) {
-                                if (col == 4) { file_ts = atof(token); break; }
-                                token = strtok(NULL, " \t");
-                                col++;
-                            }
-                            if (file_ts > 0) break;
-                        }
-                        fclose(fp);
-                        if (file_ts >= tstart && file_ts <= tend) {
-                            process_header_for_key(headerpath, s->name, file_ts);
-                        }
-                    }
-                }
-            }
-
-            // Binning
-            FileSummary summary;
-            get_file_data(filepath, &summary);
-
-            if (summary.is_constant) {
-                if (summary.count > 0 && summary.end >= tstart && summary.start <= tend) {
-                    double dt = (summary.end - summary.start) / (summary.count > 1 ? summary.count - 1 : 1);
-                    if (dt > 0) {
-                        double first_t = summary.start;
-                        long start_idx = 0;
-                         if (first_t < tstart) {
-                             start_idx = (long)ceil((tstart - first_t) / dt);
-                         }
-                         long end_idx = summary.count - 1;
-                         if (summary.end > tend) {
-                             end_idx = (long)floor((tend - first_t) / dt);
-                         }
-
-                         for (long k = start_idx; k <= end_idx; k++) {
-                             double timestamp = first_t + k * dt;
-                             int bin = (int)((timestamp - tstart) / (tend - tstart) * num_bins);
-                             if (bin < 0) bin = 0;
-                             if (bin >= num_bins) bin = num_bins - 1;
-                             s->bins[bin]++;
-                             if (s->bins[bin] > s->max_bin_count) {
-                                 s->max_bin_count = s->bins[bin];
-                             }
-                         }
-                    } else {
-                        // Single frame
-                        if (summary.start >= tstart && summary.start <= tend) {
-                             int bin = (int)((summary.start - tstart) / (tend - tstart) * num_bins);
-                             if (bin < 0) bin = 0;
-                             if (bin >= num_bins) bin = num_bins - 1;
-                             s->bins[bin]++;
-                             if (s->bins[bin] > s->max_bin_count) {
-                                 s->max_bin_count = s->bins[bin];
-                             }
-                        }
-                    }
-                }
-            } else {
-                 if (summary.timestamps) {
-                    for (long k = 0; k < summary.count; k++) {
-                        double timestamp = summary.timestamps[k];
-                        if (timestamp >= tstart && timestamp <= tend) {
-                            int bin = (int)((timestamp - tstart) / (tend - tstart) * num_bins);
-                            if (bin < 0) bin = 0;
-                            if (bin >= num_bins) bin = num_bins - 1;
-                            s->bins[bin]++;
-                            if (s->bins[bin] > s->max_bin_count) {
-                                s->max_bin_count = s->bins[bin];
-                            }
-                        }
-                    }
-                    free(summary.timestamps);
-                 }
-            }
-        }
-    }
-}
-
-void get_date_bounds(const char *root_dir, const char *date_str, double *t_min, double *t_max) {
-    char date_path[1024];
-    snprintf(date_path, sizeof(date_path), "%s/%s", root_dir, date_str);
-
-    *t_min = -1.0;
-    *t_max = -1.0;
-
-    if (!is_directory(date_path)) return;
-
-    struct dirent **streamlist;
-    int n_stream = scandir(date_path, &streamlist, NULL, alphasort);
-    if (n_stream < 0) return;
-
-    for (int i = 0; i < n_stream; i++) {
-        struct dirent *dir = streamlist[i];
-        if (dir->d_name[0] == '.') { free(streamlist[i]); continue; }
-
-        char stream_path[2048];
-        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, dir->d_name);
-
-        if (is_directory(stream_path)) {
-            struct dirent **filelist;
-            int n_files = scandir(stream_path, &filelist, NULL, alphasort);
-            if (n_files >= 0) {
-                for (int j = 0; j < n_files; j++) {
-                    struct dirent *fdir = filelist[j];
-                    size_t len = strlen(fdir->d_name);
-                    if (len > 4 && strcmp(fdir->d_name + len - 4, ".txt") == 0) {
-                        char filepath[4096];
-                        snprintf(filepath, sizeof(filepath), "%s/%s", stream_path, fdir->d_name);
-                        FILE *fp = fopen(filepath, "r");
-                        if (fp) {
-                            char line[1024];
-                            while (fgets(line, sizeof(line), fp)) {
-                                if (line[0] == '#') continue;
-                                char *token = strtok(line, " \t");
-                                int col = 0;
-                                double ts = 0.0;
-                                int found = 0;
-                                while (token) {
-                                    if (col == 4) { ts = atof(token); found = 1; break; }
-                                    token = strtok(NULL, " \t");
-                                    col++;
-                                }
-                                if (found && ts > 0.0) {
-                                    if (*t_min < 0 || ts < *t_min) *t_min = ts;
-                                    if (*t_max < 0 || ts > *t_max) *t_max = ts;
-                                }
-                            }
-                            fclose(fp);
-                        }
-                    }
-                    free(filelist[j]);
-                }
-                free(filelist);
-            }
-        }
-        free(streamlist[i]);
-    }
-    free(streamlist);
-}
-
-void process_all_dates(const char *root_dir, double tstart, double tend, StreamList *stream_list, int timeline_width, int pass, long *file_count) {
-    time_t current_t = (time_t)tstart;
-    time_t end_t = (time_t)tend;
-
-    struct tm start_tm_struct;
-    gmtime_r(&current_t, &start_tm_struct);
-    start_tm_struct.tm_hour = 0; start_tm_struct.tm_min = 0; start_tm_struct.tm_sec = 0;
-    time_t iter_t = timegm(&start_tm_struct);
-
-    struct tm end_tm_struct;
-    gmtime_r(&end_t, &end_tm_struct);
-    end_tm_struct.tm_hour = 0; end_tm_struct.tm_min = 0; end_tm_struct.tm_sec = 0;
-    time_t end_iter_t = timegm(&end_tm_struct);
-
-    for (time_t t = iter_t; t <= end_iter_t + 10; t += 86400) {
-        if (t > end_iter_t) break;
-        struct tm tm_date;
-        gmtime_r(&t, &tm_date);
-        char date_str[32];
-        snprintf(date_str, sizeof(date_str), "%04d%02d%02d",
-                 tm_date.tm_year + 1900, tm_date.tm_mon + 1, tm_date.tm_mday);
-
-        char date_path[1024];
-        snprintf(date_path, sizeof(date_path), "%s/%s", root_dir, date_str);
-
-        if (is_directory(date_path)) {
-            struct dirent **streamlist;
-            int n_stream = scandir(date_path, &streamlist, NULL, alphasort);
-            if (n_stream >= 0) {
-                for (int i = 0; i < n_stream; i++) {
-                    struct dirent *dir = streamlist[i];
-                    if (dir->d_name[0] == '.') { free(streamlist[i]); continue; }
-                    char stream_path[2048];
-                    snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, dir->d_name);
-                    if (is_directory(stream_path)) {
-                        scan_stream_dir(stream_path, dir->d_name, tstart, tend, stream_list, timeline_width, pass, file_count);
-                    }
-                    free(streamlist[i]);
-                }
-                free(streamlist);
-            }
-        }
-    }
-}
-
 int main(int argc, char *argv[]) {
     char *root_dir = NULL;
+    char *roots_file = NULL;
+    RootList roots;
+    char *pos_args[3] = {NULL, NULL, NULL};
     char *tstart_str = NULL;
     char *tend_str = NULL;
     int auto_adjust = 0;
+    char *extract_stream = NULL;
+    char *extract_out = NULL;
+    int shared_cache = 0;
+    int tui = 0;
+    int header_diff_mode = 0;
+    char *header_diff_stream = NULL;
+    char *coverage_streams = NULL;
+    char *manifest_out = NULL;
+    char *ranges_file = NULL;
+    int keystats = 0;
+    char *prof_json_path = NULL;
+    RangeQuery *ranges = NULL;
+    int nranges = 0;
+    int ret = 0;
 
     kscan_ctx.target_key_pattern[0] = '\0';
     kscan_ctx.target_stream[0] = '\0';
@@ -1428,33 +108,193 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Error: -k requires an argument\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "--extract") == 0) {
+            if (i + 4 < argc) {
+                extract_stream = argv[++i];
+                tstart_str = argv[++i];
+                tend_str = argv[++i];
+                extract_out = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --extract requires <stream> <tstart> <tend> <out.fits>\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--header-diff") == 0) {
+            header_diff_mode = 1;
+        } else if (strncmp(argv[i], "--header-diff=", 14) == 0) {
+            if (argv[i][14] == '\0') {
+                fprintf(stderr, "Error: --header-diff= requires a stream name\n");
+                return 1;
+            }
+            header_diff_mode = 1;
+            header_diff_stream = argv[i] + 14;
+        } else if (strcmp(argv[i], "--coverage") == 0) {
+            if (i + 1 < argc) {
+                coverage_streams = argv[++i];
+                strncpy(g_stream_select, coverage_streams, sizeof(g_stream_select) - 1);
+            } else {
+                fprintf(stderr, "Error: --coverage requires a comma-separated list of streams\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--manifest") == 0) {
+            if (i + 1 < argc) {
+                manifest_out = argv[++i];
+                if (strcmp(manifest_out, "-") == 0) g_quiet = 1;
+            } else {
+                fprintf(stderr, "Error: --manifest requires an output file (- for stdout)\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-roots") == 0) {
+            if (i + 1 < argc) {
+                roots_file = argv[++i];
+            } else {
+                fprintf(stderr, "Error: -roots requires an argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ranges") == 0) {
+            if (i + 1 < argc) {
+                ranges_file = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --ranges requires a file of ranges\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--keystats") == 0) {
+            keystats = 1;
         } else if (strcmp(argv[i], "-a") == 0) {
             auto_adjust = 1;
         } else if (strcmp(argv[i], "-cacheexport") == 0) {
             g_cache_export = 1;
         } else if (strcmp(argv[i], "-bcache") == 0) {
             g_use_binary_cache = 1;
+        } else if (strcmp(argv[i], "-cacheroot") == 0) {
+            if (i + 1 < argc) {
+                strncpy(g_cache_root, argv[++i], sizeof(g_cache_root) - 1);
+                shared_cache = 1;
+            } else {
+                fprintf(stderr, "Error: -cacheroot requires an argument\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "-nc") == 0) {
             g_no_cache = 1;
+        } else if (strcmp(argv[i], "-rate") == 0) {
+            g_rate_stats = 1;
+        } else if (strcmp(argv[i], "-latency") == 0) {
+            g_latency_stats = 1;
+        } else if (strcmp(argv[i], "-rateexport") == 0) {
+            if (i + 1 < argc) {
+                strncpy(g_rate_export_path, argv[++i], sizeof(g_rate_export_path) - 1);
+                g_rate_stats = 1;
+            } else {
+                fprintf(stderr, "Error: -rateexport requires an argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-flux") == 0) {
+            if (i + 1 < argc) {
+                strncpy(g_flux_stream, argv[++i], sizeof(g_flux_stream) - 1);
+            } else {
+                fprintf(stderr, "Error: -flux requires an argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-fluxmax") == 0) {
+            g_flux_show_max = 1;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 < argc) {
+                g_num_threads = atoi(argv[++i]);
+            } else {
+                fprintf(stderr, "Error: -j requires an argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-readahead") == 0) {
+            if (i + 1 < argc) {
+                g_readahead_depth = atoi(argv[++i]);
+            } else {
+                fprintf(stderr, "Error: -readahead requires an argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-noprobe") == 0) {
+            g_timing_probe = 0;
+        } else if (strcmp(argv[i], "-tui") == 0) {
+            tui = 1;
         } else if (strcmp(argv[i], "-prof") == 0) {
             g_profile = 1;
+        } else if (strcmp(argv[i], "-prof=json") == 0) {
+            g_profile = 1;
+            g_profile_json = 1;
+        } else if (strncmp(argv[i], "-prof=json:", 11) == 0 && argv[i][11] != '\0') {
+            g_profile = 1;
+            g_profile_json = 1;
+            prof_json_path = argv[i] + 11;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (i + 1 < argc) {
+                strncpy(g_trace_path, argv[++i], sizeof(g_trace_path) - 1);
+            } else {
+                fprintf(stderr, "Error: --trace requires an argument\n");
+                return 1;
+            }
         } else {
-            if (pos_arg_count == 0) root_dir = argv[i];
-            else if (pos_arg_count == 1) tstart_str = argv[i];
-            else if (pos_arg_count == 2) tend_str = argv[i];
+            if (pos_arg_count < 3) pos_args[pos_arg_count] = argv[i];
             pos_arg_count++;
         }
     }
 
-    if (pos_arg_count < 2 || (!auto_adjust && pos_arg_count < 3)) {
+    if (keystats && kscan_ctx.target_key_pattern[0] == '\0') {
+        fprintf(stderr, "Error: --keystats requires -k <KEYNAME>\n");
+        return 1;
+    }
+
+    // <dir> is not given with -roots
+    int pos_root = roots_file ? 0 : 1;
+    if (pos_root) root_dir = pos_args[0];
+    if (pos_arg_count > pos_root) tstart_str = pos_args[pos_root];
+    if (pos_arg_count > pos_root + 1) tend_str = pos_args[pos_root + 1];
+    if (extract_stream || ranges_file) {
+        if (pos_arg_count < pos_root) {
+            print_help(argv[0]);
+            return 1;
+        }
+        auto_adjust = 0;
+    } else if (pos_arg_count < pos_root + 1 || (!auto_adjust && pos_arg_count < pos_root + 2)) {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    roots.count = 0;
+    if (roots_file ? !root_list_read(&roots, roots_file) : !root_list_add_paths(&roots, root_dir)) return 1;
+    if (roots.count == 0) {
         print_help(argv[0]);
         return 1;
     }
 
-    double tstart = parse_time_arg(tstart_str);
+    // Cache paths are derived from data paths: use the same absolute form for every user
+    if (shared_cache) {
+        for (int r = 0; r < roots.count; r++) {
+            char *real = realpath(roots.paths[r], NULL);
+            if (!real) {
+                fprintf(stderr, "Error: Cannot resolve %s: %s\n", roots.paths[r], strerror(errno));
+                return 1;
+            }
+            free(roots.paths[r]);
+            roots.paths[r] = real;
+        }
+    }
+
+    double tstart = 0.0;
     double tend = 0.0;
 
-    if (auto_adjust) {
+    if (ranges_file) {
+        // Discovery over the union of the ranges
+        nranges = read_ranges(ranges_file, &ranges);
+        if (nranges < 0) {
+            root_list_free(&roots);
+            return 1;
+        }
+        tstart = ranges[0].tstart;
+        tend = ranges[0].tend;
+        for (int k = 1; k < nranges; k++) {
+            if (ranges[k].tstart < tstart) tstart = ranges[k].tstart;
+            if (ranges[k].tend > tend) tend = ranges[k].tend;
+        }
+    } else if (auto_adjust) {
+        tstart = parse_time_arg(tstart_str);
         // Parse date from tstart_str
         char date_str[32];
         if (strncmp(tstart_str, "UT", 2) == 0) {
@@ -1470,12 +310,17 @@ int main(int argc, char *argv[]) {
                  tm_val.tm_year + 1900, tm_val.tm_mon + 1, tm_val.tm_mday);
         }
 
-        get_date_bounds(root_dir, date_str, &tstart, &tend);
+        get_roots_date_bounds(&roots, date_str, &tstart, &tend);
         if (tstart < 0 || tend < 0) {
-            fprintf(stderr, "Error: No data found in %s/%s to determine time range.\n", root_dir, date_str);
+            if (roots.count == 1) {
+                fprintf(stderr, "Error: No data found in %s/%s to determine time range.\n", roots.paths[0], date_str);
+            } else {
+                fprintf(stderr, "Error: No data found for %s in any of %d roots to determine time range.\n", date_str, roots.count);
+            }
             return 1;
         }
     } else {
+        tstart = parse_time_arg(tstart_str);
         tend = parse_time_arg(tend_str);
     }
 
@@ -1495,13 +340,64 @@ int main(int argc, char *argv[]) {
     init_stream_list(&stream_list);
 
     if (g_profile) g_prof.start_time = get_current_time();
+    if (g_trace_path[0] != '\0' && !trace_init()) {
+        fprintf(stderr, "Warning: Failed to allocate trace buffer, tracing disabled\n");
+    }
 
     long file_count = 0;
     // Pass 1: Discovery and counts
     double t_disc_start = 0;
     if (g_profile) t_disc_start = get_current_time();
-    process_all_dates(root_dir, tstart, tend, &stream_list, 0, 0, &file_count);
+    double t_trace = trace_begin();
+    // Roots on several devices: read the devices concurrently first
+    if (roots.count > 1) {
+        scan_devices(&roots, tstart, tend);
+        if (g_device_count > 0) trace_span("devices", "phase", t_trace, NULL, -1, g_device_count, -1);
+    }
+    process_all_roots(&roots, tstart, tend, &stream_list, 0, 0, &file_count);
     if (g_profile) g_prof.discovery_time += (get_current_time() - t_disc_start);
+    trace_span("discovery", "phase", t_trace, NULL, -1, file_count, -1);
+    // Room for the per-file spans of the later passes (summary, header scan, flux cube)
+    trace_reserve(3 * file_count + TRACE_RING_SIZE / 4);
+
+    if (extract_stream) {
+        ret = 1;
+        int found = 0;
+        for (int i = 0; i < stream_list.count; i++) {
+            if (strcmp(stream_list.streams[i].name, extract_stream) == 0) {
+                ret = extract_subcube(&stream_list.streams[i], tstart, tend, extract_out);
+                found = 1;
+                break;
+            }
+        }
+        if (!found) fprintf(stderr, "Error: No files found for stream %s in range\n", extract_stream);
+        goto done;
+    }
+
+    if (header_diff_mode) {
+        ret = header_diff(&stream_list, header_diff_stream, tstart, tend);
+        goto done;
+    }
+
+    if (manifest_out) {
+        ret = write_manifest(&stream_list, tstart, tend, manifest_out);
+        goto done;
+    }
+
+    if (ranges_file) {
+        ret = ranges_report(&stream_list, ranges, nranges, term_width);
+        goto done;
+    }
+
+    if (keystats) {
+        ret = keystats_report(&stream_list, tstart, tend);
+        goto done;
+    }
+
+    if (coverage_streams) {
+        ret = coverage_report(&stream_list, coverage_streams, tstart, tend);
+        goto done;
+    }
 
     // Calculate formatting
     int max_name_len = 10;
@@ -1526,13 +422,42 @@ int main(int argc, char *argv[]) {
     // Allocate bins
     for (int i = 0; i < stream_list.count; i++) {
         stream_list.streams[i].bins = calloc(timeline_width, sizeof(int));
+        if (g_rate_stats) {
+            stream_list.streams[i].interval_stats = calloc(timeline_width, sizeof(IntervalStats));
+        }
+        if (g_latency_stats) {
+            stream_list.streams[i].latency = malloc(sizeof(LatencySketch));
+            latency_sketch_init(stream_list.streams[i].latency);
+            stream_list.streams[i].latency_max = calloc(timeline_width, sizeof(double));
+            stream_list.streams[i].latency_count = calloc(timeline_width, sizeof(long));
+        }
+        if (g_flux_stream[0] != '\0' && strcmp(stream_list.streams[i].name, g_flux_stream) == 0) {
+            stream_list.streams[i].flux_sum = calloc(timeline_width, sizeof(double));
+            stream_list.streams[i].flux_max = calloc(timeline_width, sizeof(double));
+            stream_list.streams[i].flux_count = calloc(timeline_width, sizeof(long));
+        }
     }
 
     // Pass 2: Data processing
     double t_proc_start = 0;
     if (g_profile) t_proc_start = get_current_time();
-    process_stream_data(&stream_list, tstart, tend, timeline_width);
+    t_trace = trace_begin();
+    // The interactive timeline bins from memory; this pass is only needed for its keyword rows
+    if (!tui || kscan_ctx.target_key_pattern[0] != '\0') process_stream_data(&stream_list, tstart, tend, timeline_width);
     if (g_profile) g_prof.processing_time += (get_current_time() - t_proc_start);
+    trace_span("processing", "phase", t_trace, NULL, -1, -1, -1);
+
+    // Pixel statistics from FITS cubes
+    for (int i = 0; i < stream_list.count; i++) {
+        Stream *s = &stream_list.streams[i];
+        if (!s->flux_sum) continue;
+        double t_flux_start = 0;
+        if (g_profile) t_flux_start = get_current_time();
+        t_trace = trace_begin();
+        process_stream_flux(s, tstart, tend, timeline_width);
+        if (g_profile) g_prof.flux_time += (get_current_time() - t_flux_start);
+        trace_span("flux", "phase", t_trace, s->name, -1, -1, -1);
+    }
 
     // Handle end of keyword tracking
     for (int i = 0; i < kscan_ctx.tracked_count; i++) {
@@ -1558,7 +483,13 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (tui) {
+        ret = tui_run(&stream_list, tstart, tend);
+        goto done;
+    }
+
     // Output
+    t_trace = trace_begin();
     char start_str[64];
     char end_str[64];
     format_time_iso(tstart, start_str, sizeof(start_str));
@@ -1571,83 +502,70 @@ int main(int argc, char *argv[]) {
            start_str, end_str, duration, dt_per_char, file_count);
 
     // Print Header
-    printf("%-*s ", prefix_width, "");
-
-    int show_s = (dt_per_char < 2.0);
-    int show_m = (dt_per_char < 120.0);
-    int show_h = (dt_per_char < 7200.0);
-
-    for (int i = 0; i < timeline_width; i++) {
-        char marker = ' ';
-        double t0 = tstart + i * dt_per_char;
-        double t1 = tstart + (i + 1) * dt_per_char;
-
-        time_t time0 = (time_t)t0;
-        time_t time1 = (time_t)t1;
-
-        if (time0 != time1) {
-            struct tm tm0;
-            struct tm tm1;
-            gmtime_r(&time0, &tm0);
-            gmtime_r(&time1, &tm1);
-
-            if (tm0.tm_year != tm1.tm_year || tm0.tm_yday != tm1.tm_yday) {
-                marker = 'D';
-            } else if (tm0.tm_hour != tm1.tm_hour) {
-                if (show_h) marker = 'H';
-            } else if (tm0.tm_min != tm1.tm_min) {
-                if (show_m) marker = 'M';
-            } else if (tm0.tm_sec != tm1.tm_sec) {
-                if (show_s) marker = 'S';
-            }
-        }
-
-        if (marker == 'H') {
-            printf(BG_HIGHLIGHT_H "%c" RESET_COLOR, marker);
-        } else if (marker == 'M') {
-            printf(BG_HIGHLIGHT_M "%c" RESET_COLOR, marker);
-        } else {
-            putchar(marker);
-        }
-    }
-    printf("\n");
+    render_time_axis(stdout, prefix_width, tstart, tend, timeline_width);
 
     for (int i = 0; i < stream_list.count; i++) {
         Stream *s = &stream_list.streams[i];
         if (s->total_frames == 0) continue;
 
-        // Calculate max FPS
-        double max_fps = 0.0;
-        if (dt_per_char > 0.0) {
-            max_fps = (double)s->max_bin_count / dt_per_char;
+        render_stream_row(stdout, s, max_name_len, max_count_len, dt_per_char, timeline_width);
+
+        // Render Frame Rate Row
+        if (s->interval_stats) {
+            double rate_min = 0.0;
+            double rate_max = 0.0;
+            int has_rate = 0;
+            for (int b = 0; b < timeline_width; b++) {
+                IntervalStats *st = &s->interval_stats[b];
+                if (st->n == 0 || st->mean <= 0.0) continue;
+                double rate = 1.0 / st->mean;
+                if (!has_rate || rate < rate_min) rate_min = rate;
+                if (!has_rate || rate > rate_max) rate_max = rate;
+                has_rate = 1;
+            }
+            if (has_rate) {
+                char label[64];
+                snprintf(label, sizeof(label), "rate %.1f-%.1f Hz", rate_min, rate_max);
+                printf("%*s ", prefix_width, label);
+                for (int b = 0; b < timeline_width; b++) {
+                    IntervalStats *st = &s->interval_stats[b];
+                    if (st->n == 0 || st->mean <= 0.0) {
+                        printf("%s %s", BG_BLACK, RESET_COLOR);
+                    } else if (interval_stats_std(st) > 0.10 * st->mean) {
+                        printf("%s%s~%s", BG_SCALE, COLORS[8], RESET_COLOR);
+                    } else {
+                        // Mean rate relative to peak: 90% or lower maps to the lowest color
+                        double ratio = (1.0 / st->mean) / rate_max;
+                        int idx = 1 + (int)((ratio - 0.9) / 0.1 * 7.999);
+                        if (idx < 1) idx = 1;
+                        if (idx > 8) idx = 8;
+                        printf("%s%s%s%s", BG_SCALE, COLORS[idx], BLOCKS[idx], RESET_COLOR);
+                    }
+                }
+                printf("\n");
+            }
         }
 
-        // Print prefix: Name(Bold) Count FPS
-        printf(BOLD_COLOR "%-*s" RESET_COLOR "   %*ld   %6.1f Hz ",
-               max_name_len, s->name,
-               max_count_len, s->total_frames,
-               max_fps);
-
-        for (int b = 0; b < timeline_width; b++) {
-            int count = s->bins[b];
-            int idx = 0;
-            if (count > 0) {
-                if (s->max_bin_count > 0) {
-                    idx = 1 + (int)((double)count * 7.999 / s->max_bin_count);
-                    if (idx > 8) idx = 8;
-                    if (idx < 1) idx = 1;
-                } else {
-                    idx = 1;
-                }
+        // Render Flux Row(s)
+        if (s->flux_sum) {
+            double *flux_mean = malloc(timeline_width * sizeof(double));
+            for (int b = 0; b < timeline_width; b++) {
+                flux_mean[b] = (s->flux_count[b] > 0) ? s->flux_sum[b] / s->flux_count[b] : 0.0;
+            }
+            print_value_row("flux %.4g-%.4g", prefix_width, flux_mean, s->flux_count, timeline_width);
+            if (g_flux_show_max) {
+                print_value_row("max %.4g-%.4g", prefix_width, s->flux_max, s->flux_count, timeline_width);
             }
-            if (idx == 0) printf("%s", BG_BLACK);
-            else printf("%s", BG_SCALE);
+            free(flux_mean);
+        }
 
-            if (idx > 0) printf("%s", COLORS[idx]);
-            printf("%s", BLOCKS[idx]);
-            printf(RESET_COLOR);
+        // Render Latency Row (max per bin, in ms)
+        if (s->latency) {
+            double *latency_ms = malloc(timeline_width * sizeof(double));
+            for (int b = 0; b < timeline_width; b++) latency_ms[b] = s->latency_max[b] * 1e3;
+            print_value_row("lat %.3g-%.3g ms", prefix_width, latency_ms, s->latency_count, timeline_width);
+            free(latency_ms);
         }
-        printf("\n");
 
         // Render Keyword Timeline Row(s)
         if (kscan_ctx.target_key_pattern[0] != '\0') {
@@ -1656,63 +574,7 @@ int main(int argc, char *argv[]) {
                 if (strcmp(tk->stream_name, s->name) != 0) continue;
 
                 char *key_line = malloc(timeline_width + 1);
-                memset(key_line, ' ', timeline_width);
-                key_line[timeline_width] = '\0';
-
-                int has_key_entries = 0;
-
-                // Pass 1: Pipes
-                for (int r = 0; r < kscan_ctx.report.count; r++) {
-                    ReportLine *l = &kscan_ctx.report.lines[r];
-                    if (l->is_count_line) continue;
-                    if (strcmp(l->stream_name, s->name) != 0) continue;
-                    if (strcmp(l->keyname, tk->key) != 0) continue;
-
-                    if (l->ts >= tstart && l->ts <= tend) {
-                        int bin = (int)((l->ts - tstart) / (tend - tstart) * timeline_width);
-                        if (bin >= 0 && bin < timeline_width) {
-                            key_line[bin] = '|';
-                            has_key_entries = 1;
-                        }
-                    }
-                }
-
-                // Pass 2: Values
-                if (has_key_entries) {
-                    for (int b = 0; b < timeline_width; b++) {
-                        if (key_line[b] == '|') continue;
-
-                        double bin_time = tstart + (b + 0.5) * dt_per_char;
-
-                        const char *val = NULL;
-                        for (int r = 0; r < kscan_ctx.report.count; r++) {
-                            ReportLine *l = &kscan_ctx.report.lines[r];
-                            if (l->is_count_line) continue;
-                            if (strcmp(l->stream_name, s->name) != 0) continue;
-                            if (strcmp(l->keyname, tk->key) != 0) continue;
-
-                            if (l->ts <= bin_time) {
-                                val = l->value;
-                            } else {
-                                break;
-                            }
-                        }
-
-                        if (val) {
-                            int prev_pipe = -1;
-                            for (int p = b - 1; p >= 0; p--) {
-                                if (key_line[p] == '|') {
-                                    prev_pipe = p;
-                                    break;
-                                }
-                            }
-                            int dist = b - (prev_pipe == -1 ? -1 : prev_pipe);
-                            int char_idx = dist - 1;
-                            if (char_idx >= 0 && char_idx < (int)strlen(val)) {
-                                key_line[b] = val[char_idx];
-                            }
-                        }
-                    }
+                if (build_key_line(tk, tstart, tend, timeline_width, key_line)) {
                     printf("%*s ", prefix_width, tk->key);
                     printf("%s\n", key_line);
                 }
@@ -1732,6 +594,23 @@ int main(int argc, char *argv[]) {
         printf(RESET_COLOR);
     }
     printf(" (Low -> High density)\n");
+    if (g_flux_stream[0] != '\0') {
+        printf("Flux: per-bin mean (and max) pixel value, scaled between the row min and max shown on the left.\n");
+    }
+    if (g_rate_stats) {
+        printf("Rate: mean frame rate per bin relative to stream peak (lowest color <= 90%%), '~' = interval std > 10%% of mean.\n");
+    }
+    if (g_latency_stats) {
+        printf("Lat: per-bin max logging latency (col4 - col5), scaled between the row min and max shown on the left.\n");
+        printf("\nLogging latency (col4 - col5):\n");
+        for (int i = 0; i < stream_list.count; i++) {
+            Stream *s = &stream_list.streams[i];
+            if (s->total_frames == 0 || !s->latency || s->latency->count == 0) continue;
+            printf("%-*s  p50 %9.3f ms  p99 %9.3f ms  p99.9 %9.3f ms  max %9.3f ms  (%ld frames)\n", max_name_len, s->name,
+                   latency_sketch_quantile(s->latency, 0.5) * 1e3, latency_sketch_quantile(s->latency, 0.99) * 1e3,
+                   latency_sketch_quantile(s->latency, 0.999) * 1e3, s->latency->max * 1e3, s->latency->count);
+        }
+    }
 
     if (kscan_ctx.report.count > 0) {
         printf("\nKeyword Scan Report:\n");
@@ -1748,17 +627,53 @@ int main(int argc, char *argv[]) {
             }
         }
     }
+    trace_span("render", "phase", t_trace, NULL, -1, -1, -1);
+
+    if (g_rate_export_path[0] != '\0') {
+        FILE *fp = fopen(g_rate_export_path, "w");
+        if (fp) {
+            fprintf(fp, "# stream bin tstart tend nintervals min_dt mean_dt max_dt std_dt\n");
+            for (int i = 0; i < stream_list.count; i++) {
+                Stream *s = &stream_list.streams[i];
+                if (s->total_frames == 0 || !s->interval_stats) continue;
+                for (int b = 0; b < timeline_width; b++) {
+                    IntervalStats *st = &s->interval_stats[b];
+                    fprintf(fp, "%s %d %.6f %.6f %ld %.9f %.9f %.9f %.9f\n",
+                            s->name, b, tstart + b * dt_per_char, tstart + (b + 1) * dt_per_char,
+                            st->n, st->min, st->mean, st->max, interval_stats_std(st));
+                }
+            }
+            fclose(fp);
+        } else {
+            fprintf(stderr, "Warning: Failed to write rate statistics %s: %s\n", g_rate_export_path, strerror(errno));
+        }
+    }
+
+    flush_binary_cache(); // Counted in "created"
+    printf("\nCache: searched %ld, found %ld, created %ld\n", g_cache_searched, g_cache_found, g_cache_created);
 
+done:
+    // Every mode ends here: teardown, then the profile of the whole run
+    free(ranges);
     free_report(&kscan_ctx.report);
     if (kscan_ctx.tracked_keys) free(kscan_ctx.tracked_keys);
     if (kscan_ctx.target_key_pattern[0] != '\0') regfree(&kscan_ctx.key_regex);
     free_stream_list(&stream_list);
+    root_list_free(&roots);
 
     flush_binary_cache();
+    if (g_trace) trace_write(g_trace_path);
 
-    printf("\nCache: searched %ld, found %ld, created %ld\n", g_cache_searched, g_cache_found, g_cache_created);
-
-    if (g_profile) {
+    if (g_profile_json) {
+        // Kept off stdout so that the report and the JSON object can each be parsed
+        FILE *fp = prof_json_path ? fopen(prof_json_path, "w") : stderr;
+        if (fp) {
+            print_profile_json(fp, get_current_time() - g_prof.start_time);
+            if (fp != stderr) fclose(fp);
+        } else {
+            fprintf(stderr, "Warning: Failed to write profiling output %s: %s\n", prof_json_path, strerror(errno));
+        }
+    } else if (g_profile) {
         printf("\nProfiling Summary:\n");
         printf("Total Time:       %9.6f s\n", get_current_time() - g_prof.start_time);
         printf("Discovery Pass:   %9.6f s\n", g_prof.discovery_time);
@@ -1767,7 +682,23 @@ int main(int argc, char *argv[]) {
         printf("  Cache Read:     %9.6f s\n", g_prof.cache_read_time);
         printf("  File Parse:     %9.6f s\n", g_prof.file_parse_time);
         printf("  Cache Write:    %9.6f s\n", g_prof.cache_write_time);
-    }
-
-    return 0;
+        if (g_flux_stream[0] != '\0') printf("  Flux:           %9.6f s\n", g_prof.flux_time);
+        printf("I/O:\n");
+        printf("  Files opened:   %9ld\n", g_prof.files_opened);
+        printf("  Bytes read:     %9ld\n", g_prof.bytes_read);
+        printf("  stat calls:     %9ld\n", g_prof.stat_calls);
+        printf("  scandir calls:  %9ld\n", g_prof.scandir_calls);
+        printf("  Cache hits:     %9ld local, %ld export, %ld binary, %ld misses\n",
+               g_prof.cache_hits_local, g_prof.cache_hits_export, g_prof.cache_hits_binary, g_prof.cache_misses);
+        printf("  Timing probes:  %9ld (%ld parsed in full)\n", g_prof.timing_probes, g_prof.timing_probe_fallbacks);
+        if (g_device_count > 0) {
+            printf("Devices (discovery workers):\n");
+            print_device_stats(stdout);
+        }
+        printf("Memory:\n");
+        printf("  Peak RSS:       %9ld kB\n", get_peak_rss_kb());
+        printf("  Allocations:    %9ld\n", g_alloc_count);
+    }
+
+    return ret;
 }
@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <ctype.h>
+
+// Batch range queries (--ranges <file>): the union of all ranges is discovered once, the
+// summaries of its files are loaded once into memory, and every range is answered from
+// them. Ranges are processed in start order, so that each stream's first candidate file
+// only moves forward; the result blocks are printed in file order.
+
+// Lines "<tstart> <tend> [<label>]", blank lines and '#' comments ignored. Returns the
+// number of ranges, or -1 on error.
+int read_ranges(const char *path, RangeQuery **out) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot read ranges file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    RangeQuery *ranges = NULL;
+    int count = 0, capacity = 0;
+    char line[1024];
+    int lineno = 0;
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+        char tstart_str[64], tend_str[64];
+        int offset = 0;
+        if (sscanf(p, "%63s %63s %n", tstart_str, tend_str, &offset) != 2) {
+            fprintf(stderr, "Error: %s:%d: expected <tstart> <tend> [<label>]\n", path, lineno);
+            ok = 0;
+            break;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            ranges = realloc(ranges, capacity * sizeof(RangeQuery));
+        }
+        RangeQuery *r = &ranges[count];
+        r->tstart = parse_time_arg(tstart_str);
+        r->tend = parse_time_arg(tend_str);
+        r->index = count;
+        char *label = p + offset;
+        size_t len = strlen(label);
+        while (len > 0 && isspace((unsigned char)label[len - 1])) label[--len] = '\0';
+        if (len > 0) snprintf(r->label, sizeof(r->label), "%s", label);
+        else snprintf(r->label, sizeof(r->label), "range %d", count + 1);
+        if (r->tstart >= r->tend) {
+            fprintf(stderr, "Error: %s:%d: tstart must be less than tend\n", path, lineno);
+            ok = 0;
+            break;
+        }
+        count++;
+    }
+    fclose(fp);
+    if (ok && count == 0) {
+        fprintf(stderr, "Error: No ranges in %s\n", path);
+        ok = 0;
+    }
+    if (!ok) {
+        free(ranges);
+        return -1;
+    }
+    *out = ranges;
+    return count;
+}
+
+int compare_ranges_by_start(const void *a, const void *b) {
+    const RangeQuery *ra = a, *rb = b;
+    if (ra->tstart < rb->tstart) return -1;
+    if (ra->tstart > rb->tstart) return 1;
+    return ra->index - rb->index;
+}
+
+// Timeline and frame counts of one range, from the summaries in memory. cursor[i]: first
+// file of stream i that can hold frames at or after r->tstart (ranges come in start order).
+void range_block(FILE *out, StreamList *stream_list, FileSummary **summaries, int *cursor,
+                 const RangeQuery *r, int term_width) {
+    // Frame counts first: they set the width of the timeline
+    long *frames = calloc(stream_list->count, sizeof(long));
+    long nfiles = 0;
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+        while (cursor[i] < s->file_count && summaries[i][cursor[i]].end < r->tstart) cursor[i]++;
+        for (int j = cursor[i]; j < s->file_count; j++) {
+            const FileSummary *fs = &summaries[i][j];
+            if (fs->count > 0 && fs->start > r->tend) break;
+            long first, last;
+            if (!summary_frame_range(fs, r->tstart, r->tend, &first, &last)) continue;
+            frames[i] += last - first + 1;
+            nfiles++;
+        }
+    }
+
+    // Layout as for the timeline of a single query
+    int max_name_len = 10;
+    int max_count_len = 5;
+    for (int i = 0; i < stream_list->count; i++) {
+        if (frames[i] == 0) continue;
+        int len = strlen(stream_list->streams[i].name);
+        if (len > max_name_len) max_name_len = len;
+        char count_buf[32];
+        int clen = snprintf(count_buf, sizeof(count_buf), "%ld", frames[i]);
+        if (clen > max_count_len) max_count_len = clen;
+    }
+    int prefix_width = max_name_len + 3 + max_count_len + 3 + 10 + 1;
+    int width = term_width - prefix_width - 1;
+    if (width < 10) width = 10;
+
+    char start_str[64], end_str[64];
+    format_time_iso(r->tstart, start_str, sizeof(start_str));
+    format_time_iso(r->tend, end_str, sizeof(end_str));
+    double dt_per_char = (r->tend - r->tstart) / width;
+    fprintf(out, "\n" BOLD_COLOR "%s" RESET_COLOR "\n", r->label);
+    fprintf(out, "Start: %s  End: %s  Duration: %.3f s  Bin: %.3f s  Files: %ld\n\n",
+            start_str, end_str, r->tend - r->tstart, dt_per_char, nfiles);
+    render_time_axis(out, prefix_width, r->tstart, r->tend, width);
+
+    for (int i = 0; i < stream_list->count; i++) {
+        if (frames[i] == 0) continue;
+        Stream row = stream_list->streams[i];
+        row.bins = calloc(width, sizeof(int));
+        row.total_frames = 0;
+        row.max_bin_count = 0;
+        for (int j = cursor[i]; j < row.file_count; j++) {
+            const FileSummary *fs = &summaries[i][j];
+            if (fs->count > 0 && fs->start > r->tend) break;
+            row.total_frames += tui_bin_summary(fs, r->tstart, r->tend, width, row.bins);
+        }
+        for (int b = 0; b < width; b++) {
+            if (row.bins[b] > row.max_bin_count) row.max_bin_count = row.bins[b];
+        }
+        render_stream_row(out, &row, max_name_len, max_count_len, dt_per_char, width);
+        free(row.bins);
+    }
+    free(frames);
+}
+
+// Answers every range from one load of the summaries of the streams in stream_list
+int ranges_report(StreamList *stream_list, RangeQuery *ranges, int nranges, int term_width) {
+    double t_trace = trace_begin();
+    FileSummary **summaries = calloc(stream_list->count > 0 ? stream_list->count : 1, sizeof(FileSummary *));
+    int *cursor = calloc(stream_list->count > 0 ? stream_list->count : 1, sizeof(int));
+    long nfiles = 0;
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+        summaries[i] = calloc(s->file_count > 0 ? s->file_count : 1, sizeof(FileSummary));
+        for (int j = 0; j < s->file_count; j++) get_file_data(s->files[j].path, &summaries[i][j]);
+        nfiles += s->file_count;
+    }
+    trace_span("ranges_load", "phase", t_trace, NULL, -1, nfiles, -1);
+
+    t_trace = trace_begin();
+    RangeQuery *sorted = malloc(nranges * sizeof(RangeQuery));
+    memcpy(sorted, ranges, nranges * sizeof(RangeQuery));
+    qsort(sorted, nranges, sizeof(RangeQuery), compare_ranges_by_start);
+    char **blocks = calloc(nranges, sizeof(char *));
+    for (int k = 0; k < nranges; k++) {
+        size_t len = 0;
+        FILE *out = open_memstream(&blocks[sorted[k].index], &len);
+        range_block(out, stream_list, summaries, cursor, &sorted[k], term_width);
+        fclose(out);
+    }
+    for (int k = 0; k < nranges; k++) {
+        fputs(blocks[k], stdout);
+        free(blocks[k]);
+    }
+    trace_span("ranges", "phase", t_trace, NULL, -1, nranges, -1);
+
+    for (int i = 0; i < stream_list->count; i++) {
+        for (int j = 0; j < stream_list->streams[i].file_count; j++) free(summaries[i][j].timestamps);
+        free(summaries[i]);
+    }
+    free(summaries);
+    free(cursor);
+    free(sorted);
+    free(blocks);
+    return 0;
+}
@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <linux/io_uring.h>
+
+// Reads whole files ahead of the parser, in list order, with at most <depth> files in
+// flight. Reads are queued on an io_uring when the kernel provides one; otherwise files
+// are opened ahead with posix_fadvise(WILLNEED) and read when taken.
+
+// Larger files are only hinted with fadvise, to keep buffered memory bounded
+#define READAHEAD_MAX_FILE (64L * 1024 * 1024)
+
+enum { SLOT_FREE = 0, SLOT_PENDING, SLOT_DONE, SLOT_HINTED };
+
+typedef struct {
+    int state;
+    int index; // position in the path list
+    int fd;
+    char *buf;
+    size_t size;
+    long res;  // io_uring completion result
+} ReadaheadSlot;
+
+struct Readahead {
+    char **paths;
+    int count;
+    int next_submit;
+    int depth;
+    ReadaheadSlot *slots;
+
+    // io_uring state (ring_fd < 0: fadvise fallback)
+    int ring_fd;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;
+};
+
+Readahead *g_readahead = NULL;
+int g_readahead_depth = 16;
+
+int uring_setup(Readahead *ra, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return 0;
+
+    ra->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ra->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        if (ra->cq_size > ra->sq_size) ra->sq_size = ra->cq_size;
+        ra->cq_size = ra->sq_size;
+    }
+    ra->sq_ptr = mmap(NULL, ra->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ra->sq_ptr == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    ra->cq_ptr = single ? ra->sq_ptr
+                        : mmap(NULL, ra->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ra->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ra->sqes = (ra->cq_ptr == MAP_FAILED) ? MAP_FAILED
+             : mmap(NULL, ra->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ra->cq_ptr == MAP_FAILED || ra->sqes == MAP_FAILED) {
+        if (ra->cq_ptr != MAP_FAILED && !single) munmap(ra->cq_ptr, ra->cq_size);
+        munmap(ra->sq_ptr, ra->sq_size);
+        close(fd);
+        return 0;
+    }
+
+    char *sq = ra->sq_ptr;
+    char *cq = ra->cq_ptr;
+    ra->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ra->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ra->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ra->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ra->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ra->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ra->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ra->ring_fd = fd;
+    return 1;
+}
+
+void uring_queue_read(Readahead *ra, int slot) {
+    ReadaheadSlot *s = &ra->slots[slot];
+    unsigned tail = *ra->sq_tail;
+    unsigned idx = tail & *ra->sq_mask;
+    struct io_uring_sqe *sqe = &ra->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = s->fd;
+    sqe->addr = (unsigned long)s->buf;
+    sqe->len = (unsigned)s->size;
+    sqe->off = 0;
+    sqe->user_data = slot;
+    ra->sq_array[idx] = idx;
+    __atomic_store_n(ra->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ra->to_submit++;
+}
+
+void uring_reap(Readahead *ra) {
+    unsigned head = *ra->cq_head;
+    while (head != __atomic_load_n(ra->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &ra->cqes[head & *ra->cq_mask];
+        ReadaheadSlot *s = &ra->slots[cqe->user_data];
+        s->res = cqe->res;
+        s->state = SLOT_DONE;
+        head++;
+    }
+    __atomic_store_n(ra->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Waits for the read of slot s. Reads that readahead_refill queued but could not submit
+// (EAGAIN, EBUSY, EINTR) are submitted along, as s may be one of them.
+void uring_wait(Readahead *ra, ReadaheadSlot *s) {
+    uring_reap(ra);
+    while (s->state == SLOT_PENDING) {
+        int ret = (int)syscall(__NR_io_uring_enter, ra->ring_fd, ra->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret > 0) ra->to_submit -= ret;
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            // Should not happen; keep the buffer (the kernel may still own it)
+            s->buf = NULL;
+            s->state = SLOT_DONE;
+            s->res = -EIO;
+            return;
+        }
+        uring_reap(ra);
+    }
+}
+
+void readahead_refill(Readahead *ra) {
+    for (int i = 0; i < ra->depth && ra->next_submit < ra->count; i++) {
+        ReadaheadSlot *s = &ra->slots[i];
+        if (s->state != SLOT_FREE) continue;
+
+        // Skip files that cannot be opened; the caller's own read reports them
+        while (ra->next_submit < ra->count) {
+            int index = ra->next_submit++;
+            int fd = open(ra->paths[index], O_RDONLY);
+            if (fd < 0) continue;
+            PROF_COUNT(files_opened, 1);
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                close(fd);
+                continue;
+            }
+            s->index = index;
+            s->fd = fd;
+            s->size = (size_t)st.st_size;
+            s->buf = NULL;
+            s->res = 0;
+            if (ra->ring_fd >= 0 && st.st_size > 0 && st.st_size <= READAHEAD_MAX_FILE) {
+                s->buf = malloc(s->size);
+                s->state = SLOT_PENDING;
+                uring_queue_read(ra, i);
+            } else {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                s->state = SLOT_HINTED;
+            }
+            break;
+        }
+    }
+    if (ra->ring_fd >= 0 && ra->to_submit > 0) {
+        int ret = (int)syscall(__NR_io_uring_enter, ra->ring_fd, ra->to_submit, 0, 0, NULL, 0);
+        if (ret > 0) ra->to_submit -= ret;
+    }
+}
+
+void readahead_release(Readahead *ra, ReadaheadSlot *s) {
+    if (s->state == SLOT_PENDING) uring_wait(ra, s);
+    free(s->buf);
+    s->buf = NULL;
+    if (s->fd >= 0) close(s->fd);
+    s->fd = -1;
+    s->state = SLOT_FREE;
+}
+
+// paths are copied. depth <= 0 disables readahead (returns NULL).
+Readahead *readahead_create(char **paths, int count, int depth) {
+    if (depth <= 0 || count <= 0) return NULL;
+    Readahead *ra = calloc(1, sizeof(Readahead));
+    ra->paths = malloc(count * sizeof(char *));
+    for (int i = 0; i < count; i++) ra->paths[i] = strdup(paths[i]);
+    ra->count = count;
+    ra->depth = depth;
+    ra->slots = calloc(depth, sizeof(ReadaheadSlot));
+    for (int i = 0; i < depth; i++) ra->slots[i].fd = -1;
+    ra->ring_fd = -1;
+    uring_setup(ra, (unsigned)depth);
+    readahead_refill(ra);
+    return ra;
+}
+
+// Hands over the complete contents of <path> if it was read ahead: *buf is malloc'd
+// (caller frees). Files queued before <path> and not taken are dropped. Returns 0 if
+// <path> is not in flight, in which case the caller reads it itself.
+int readahead_take(Readahead *ra, const char *path, char **buf, size_t *len) {
+    if (!ra) return 0;
+    ReadaheadSlot *s = NULL;
+    for (int i = 0; i < ra->depth; i++) {
+        if (ra->slots[i].state != SLOT_FREE && strcmp(ra->paths[ra->slots[i].index], path) == 0) {
+            s = &ra->slots[i];
+            break;
+        }
+    }
+    if (!s) return 0;
+    for (int i = 0; i < ra->depth; i++) {
+        if (ra->slots[i].state != SLOT_FREE && ra->slots[i].index < s->index) readahead_release(ra, &ra->slots[i]);
+    }
+
+    size_t done = 0;
+    if (s->state == SLOT_PENDING) uring_wait(ra, s);
+    if (s->state == SLOT_DONE && s->res > 0) done = (size_t)s->res;
+    if (!s->buf) s->buf = malloc(s->size > 0 ? s->size : 1);
+    // Short or failed asynchronous reads, and fadvise-only files, finish synchronously
+    while (done < s->size) {
+        ssize_t nr = pread(s->fd, s->buf + done, s->size - done, done);
+        if (nr <= 0) break;
+        done += nr;
+    }
+    PROF_COUNT(bytes_read, done);
+
+    *buf = s->buf;
+    *len = done;
+    s->buf = NULL;
+    readahead_release(ra, s);
+    readahead_refill(ra);
+    return 1;
+}
+
+void readahead_destroy(Readahead *ra) {
+    if (!ra) return;
+    for (int i = 0; i < ra->depth; i++) {
+        if (ra->slots[i].state != SLOT_FREE) readahead_release(ra, &ra->slots[i]);
+    }
+    if (ra->ring_fd >= 0) {
+        munmap(ra->sqes, ra->sqes_size);
+        if (ra->cq_ptr != ra->sq_ptr) munmap(ra->cq_ptr, ra->cq_size);
+        munmap(ra->sq_ptr, ra->sq_size);
+        close(ra->ring_fd);
+    }
+    for (int i = 0; i < ra->count; i++) free(ra->paths[i]);
+    free(ra->paths);
+    free(ra->slots);
+    free(ra);
+}
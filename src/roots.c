@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <sys/wait.h>
+#include <sys/sysmacros.h>
+#include <ctype.h>
+
+// Archives spread over several roots (<dir1>:<dir2>:... or -roots <file>). Streams of the
+// same name are merged across roots. Roots are grouped by the device they are on; with
+// more than one device, each device is scanned by its own worker process before the
+// discovery pass, so that disks are read concurrently. The workers summarize the timing
+// files of their roots into the summary caches (or just the page cache with -nc), and
+// the discovery pass that follows is then served from them.
+
+DeviceStats *g_device_stats = NULL;
+int g_device_count = 0;
+
+int root_list_add(RootList *rl, const char *path) {
+    if (rl->count == MAX_ROOTS) {
+        fprintf(stderr, "Error: Too many roots (max %d)\n", MAX_ROOTS);
+        return 0;
+    }
+    rl->paths[rl->count++] = strdup(path);
+    return 1;
+}
+
+// Adds the roots of a ':'-separated list
+int root_list_add_paths(RootList *rl, const char *list) {
+    char *copy = strdup(list);
+    int ok = 1;
+    for (char *save = NULL, *path = strtok_r(copy, ":", &save); path && ok; path = strtok_r(NULL, ":", &save)) {
+        ok = root_list_add(rl, path);
+    }
+    free(copy);
+    return ok;
+}
+
+// Roots config: one directory per line, blank lines and '#' comments ignored
+int root_list_read(RootList *rl, const char *file) {
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot read roots file %s: %s\n", file, strerror(errno));
+        return 0;
+    }
+    char line[4096];
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        size_t len = strlen(p);
+        while (len > 0 && isspace((unsigned char)p[len - 1])) p[--len] = '\0';
+        if (len == 0 || p[0] == '#') continue;
+        ok = root_list_add(rl, p);
+    }
+    fclose(fp);
+    if (ok && rl->count == 0) {
+        fprintf(stderr, "Error: No roots in %s\n", file);
+        ok = 0;
+    }
+    return ok;
+}
+
+void root_list_free(RootList *rl) {
+    for (int i = 0; i < rl->count; i++) free(rl->paths[i]);
+    rl->count = 0;
+}
+
+int compare_file_entries(const void *a, const void *b) {
+    const FileEntry *fa = a, *fb = b;
+    if (fa->timestamp < fb->timestamp) return -1;
+    if (fa->timestamp > fb->timestamp) return 1;
+    return strcmp(fa->path, fb->path);
+}
+
+// Discovery over every root; files of streams found on several roots are put back in time order
+void process_all_roots(const RootList *rl, double tstart, double tend, StreamList *stream_list, int timeline_width, int pass, long *file_count) {
+    for (int r = 0; r < rl->count; r++) {
+        process_all_dates(rl->paths[r], tstart, tend, stream_list, timeline_width, pass, file_count);
+    }
+    if (rl->count < 2) return;
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+        if (s->file_count > 1) qsort(s->files, s->file_count, sizeof(FileEntry), compare_file_entries);
+    }
+}
+
+// Time range of the data of night date_str over every root (-1 if none)
+void get_roots_date_bounds(const RootList *rl, const char *date_str, double *t_min, double *t_max) {
+    *t_min = -1.0;
+    *t_max = -1.0;
+    for (int r = 0; r < rl->count; r++) {
+        double lo, hi;
+        get_date_bounds(rl->paths[r], date_str, &lo, &hi);
+        if (lo >= 0 && (*t_min < 0 || lo < *t_min)) *t_min = lo;
+        if (hi >= 0 && (*t_max < 0 || hi > *t_max)) *t_max = hi;
+    }
+}
+
+// Summarizes the files in range of the roots on device d. Runs in a worker process.
+void device_worker(const RootList *rl, const int *root_dev, int d, double tstart, double tend) {
+    DeviceStats *ds = &g_device_stats[d];
+    memset(&g_prof, 0, sizeof(g_prof));
+    g_profile = 1; // bytes read, for the device throughput
+    g_quiet = 1;
+    double t_start = get_current_time();
+    StreamList stream_list;
+    init_stream_list(&stream_list);
+    long file_count = 0;
+    for (int r = 0; r < rl->count; r++) {
+        if (root_dev[r] == d) process_all_dates(rl->paths[r], tstart, tend, &stream_list, 0, 0, &file_count);
+    }
+    flush_binary_cache();
+    free_stream_list(&stream_list);
+    ds->files = file_count;
+    ds->bytes = g_prof.bytes_read;
+    ds->seconds = get_current_time() - t_start;
+}
+
+// Scans the roots with one worker process per device, when they are on more than one.
+// Returns the number of devices scanned in parallel (0: none, scan serially).
+int scan_devices(const RootList *rl, double tstart, double tend) {
+    dev_t devs[MAX_ROOTS];
+    int root_dev[MAX_ROOTS];
+    int ndev = 0;
+    for (int r = 0; r < rl->count; r++) {
+        struct stat st;
+        root_dev[r] = -1;
+        if (stat(rl->paths[r], &st) != 0) {
+            fprintf(stderr, "Warning: Cannot read root %s: %s\n", rl->paths[r], strerror(errno));
+            continue;
+        }
+        int d = 0;
+        while (d < ndev && devs[d] != st.st_dev) d++;
+        if (d == ndev) devs[ndev++] = st.st_dev;
+        root_dev[r] = d;
+    }
+    if (ndev < 2) return 0;
+
+    // Statistics written by the workers
+    DeviceStats *stats = mmap(NULL, ndev * sizeof(DeviceStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED) {
+        fprintf(stderr, "Warning: Failed to map device statistics, scanning roots serially: %s\n", strerror(errno));
+        return 0;
+    }
+    g_device_stats = stats;
+    g_device_count = ndev;
+    for (int d = 0; d < ndev; d++) {
+        stats[d].dev = devs[d];
+        for (int r = 0; r < rl->count; r++) {
+            if (root_dev[r] != d) continue;
+            size_t len = strlen(stats[d].roots);
+            snprintf(stats[d].roots + len, sizeof(stats[d].roots) - len, "%s%s", len ? ":" : "", rl->paths[r]);
+        }
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pids[MAX_ROOTS];
+    for (int d = 0; d < ndev; d++) {
+        pids[d] = fork();
+        if (pids[d] == 0) {
+            device_worker(rl, root_dev, d, tstart, tend);
+            _exit(0);
+        }
+        if (pids[d] < 0) {
+            fprintf(stderr, "Warning: fork failed for device %u:%u: %s\n", major(devs[d]), minor(devs[d]), strerror(errno));
+            stats[d].failed = 1;
+        }
+    }
+    for (int d = 0; d < ndev; d++) {
+        if (pids[d] <= 0) continue;
+        int status;
+        while (waitpid(pids[d], &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) stats[d].failed = 1;
+    }
+    return ndev;
+}
+
+void print_device_stats(FILE *out) {
+    for (int d = 0; d < g_device_count; d++) {
+        const DeviceStats *ds = &g_device_stats[d];
+        fprintf(out, "  dev %3u:%-4u %7ld files %10.1f MB %9.3f s %9.1f MB/s  %s%s\n",
+                major(ds->dev), minor(ds->dev), ds->files, ds->bytes / 1e6, ds->seconds,
+                ds->seconds > 0 ? ds->bytes / 1e6 / ds->seconds : 0.0, ds->roots, ds->failed ? " (failed)" : "");
+    }
+}
+
+void print_device_stats_json(FILE *out) {
+    fprintf(out, "  \"devices\": [");
+    for (int d = 0; d < g_device_count; d++) {
+        const DeviceStats *ds = &g_device_stats[d];
+        fprintf(out, "%s\n    {\"dev\": \"%u:%u\", \"roots\": ", d ? "," : "", major(ds->dev), minor(ds->dev));
+        trace_write_string(out, ds->roots);
+        fprintf(out, ", \"files\": %ld, \"bytes_read\": %ld, \"seconds\": %.6f, \"failed\": %d}",
+                ds->files, ds->bytes, ds->seconds, ds->failed);
+    }
+    fprintf(out, "%s],\n", g_device_count ? "\n  " : "");
+}
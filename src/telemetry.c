@@ -0,0 +1,3200 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+
+// Unicode Block Elements
+const char *BLOCKS[] = {" ", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588", "\u2588"};
+// ANSI Colors (Blue -> Cyan -> Green -> Yellow -> Red)
+const char *COLORS[] = {
+    "\033[0m",        // 0: Reset (Space)
+    "\033[38;5;21m",  // 1: Blue
+    "\033[38;5;27m",  // 2: Blue-ish
+    "\033[38;5;39m",  // 3: Cyan
+    "\033[38;5;46m",  // 4: Green
+    "\033[38;5;118m", // 5: Light Green
+    "\033[38;5;154m", // 6: Yellow-Green
+    "\033[38;5;220m", // 7: Yellow
+    "\033[38;5;196m"  // 8: Red
+};
+// Globals
+KeyScanContext kscan_ctx;
+int g_cache_export = 0;
+int g_no_cache = 0;
+char g_cache_root[4096] = CACHE_DIR; // local cache tree (-cacheroot)
+long g_cache_searched = 0;
+long g_cache_found = 0;
+long g_cache_created = 0;
+
+// Binary Cache Globals
+int g_use_binary_cache = 0;
+BinaryCache *g_binary_cache = NULL;
+
+// Frame interval statistics
+int g_rate_stats = 0;
+char g_rate_export_path[4096] = "";
+
+// Pixel statistics (flux) timeline
+char g_flux_stream[256] = "";
+int g_flux_show_max = 0;
+int g_num_threads = 0; // 0: number of online CPUs
+
+// Logging latency (col4 - col5)
+int g_latency_stats = 0;
+
+int g_timing_probe = 1;
+char g_stream_select[4096] = "";
+int g_quiet = 0;
+
+// Profiling globals
+int g_profile = 0;
+int g_profile_json = 0;
+ProfileTimes g_prof;
+
+// Trace globals
+int g_trace = 0;
+char g_trace_path[4096] = "";
+TraceEvent *g_trace_ring = NULL;
+long g_trace_capacity = 0;
+long g_trace_dropped = 0;   // events overwritten before the ring was last grown
+long g_trace_next = 0;
+double g_trace_t0 = 0.0;
+__thread int t_trace_tid = 0;
+
+void init_report(Report *r) {
+    r->count = 0;
+    r->capacity = 10;
+    r->lines = malloc(r->capacity * sizeof(ReportLine));
+}
+
+void add_report_line(Report *r, ReportLine line) {
+    if (r->count == r->capacity) {
+        r->capacity *= 2;
+        r->lines = realloc(r->lines, r->capacity * sizeof(ReportLine));
+    }
+    r->lines[r->count++] = line;
+}
+
+void free_report(Report *r) {
+    free(r->lines);
+}
+
+int compare_report_lines(const void *a, const void *b) {
+    const ReportLine *ra = (const ReportLine *)a;
+    const ReportLine *rb = (const ReportLine *)b;
+    if (ra->ts < rb->ts) return -1;
+    if (ra->ts > rb->ts) return 1;
+    return rb->is_count_line - ra->is_count_line;
+}
+
+void init_stream_list(StreamList *list) {
+    list->count = 0;
+    list->capacity = 10;
+    list->streams = malloc(list->capacity * sizeof(Stream));
+}
+
+Stream* get_or_create_stream(StreamList *list, const char *name) {
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->streams[i].name, name) == 0) {
+            return &list->streams[i];
+        }
+    }
+    if (list->count == list->capacity) {
+        list->capacity *= 2;
+        list->streams = realloc(list->streams, list->capacity * sizeof(Stream));
+    }
+    Stream *s = &list->streams[list->count++];
+    strncpy(s->name, name, 255);
+    s->name[255] = '\0';
+    s->total_frames = 0;
+    s->bins = NULL;
+    s->max_bin_count = 0;
+    s->interval_stats = NULL;
+    s->rate_last_ts = -1.0;
+    s->latency = NULL;
+    s->latency_max = NULL;
+    s->latency_count = NULL;
+    s->flux_sum = NULL;
+    s->flux_max = NULL;
+    s->flux_count = NULL;
+    s->files = NULL;
+    s->file_count = 0;
+    s->file_capacity = 0;
+    return s;
+}
+
+void add_file_to_stream(Stream *s, const char *path, double timestamp) {
+    if (s->file_count == s->file_capacity) {
+        s->file_capacity = (s->file_capacity == 0) ? 10 : s->file_capacity * 2;
+        s->files = realloc(s->files, s->file_capacity * sizeof(FileEntry));
+    }
+    s->files[s->file_count].path = strdup(path);
+    s->files[s->file_count].timestamp = timestamp;
+    s->file_count++;
+}
+
+void free_stream_list(StreamList *list) {
+    for (int i = 0; i < list->count; i++) {
+        Stream *s = &list->streams[i];
+        if (s->bins) free(s->bins);
+        if (s->interval_stats) free(s->interval_stats);
+        if (s->flux_sum) free(s->flux_sum);
+        if (s->flux_max) free(s->flux_max);
+        if (s->flux_count) free(s->flux_count);
+        free(s->latency);
+        free(s->latency_max);
+        free(s->latency_count);
+        for (int j = 0; j < s->file_count; j++) {
+            free(s->files[j].path);
+        }
+        if (s->files) free(s->files);
+    }
+    free(list->streams);
+}
+
+int is_directory(const char *path) {
+    struct stat statbuf;
+    PROF_COUNT(stat_calls, 1);
+    if (stat(path, &statbuf) != 0) return 0;
+    return S_ISDIR(statbuf.st_mode);
+}
+
+double parse_time_arg(const char *arg) {
+    if (strncmp(arg, "UT", 2) == 0) {
+        struct tm tm_val;
+        memset(&tm_val, 0, sizeof(struct tm));
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+
+        int count = sscanf(arg, "UT%4d%2d%2dT%2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second);
+        if (count >= 4) {
+            tm_val.tm_year = year - 1900;
+            tm_val.tm_mon = month - 1;
+            tm_val.tm_mday = day;
+            tm_val.tm_hour = hour;
+            tm_val.tm_min = minute;
+            tm_val.tm_sec = second;
+            return (double)timegm(&tm_val);
+        } else {
+             fprintf(stderr, "Warning: Failed to parse UT time format: %s. usage: UTYYYYMMDDTHH[:MM[:SS]]\n", arg);
+             return 0.0;
+        }
+    } else {
+        return atof(arg);
+    }
+}
+
+void format_time_iso(double ts, char *buf, size_t size) {
+    time_t t = (time_t)ts;
+    struct tm tm_val;
+    gmtime_r(&t, &tm_val);
+    snprintf(buf, size, "UT%04d%02d%02dT%02d:%02d:%02d",
+             tm_val.tm_year + 1900, tm_val.tm_mon + 1, tm_val.tm_mday,
+             tm_val.tm_hour, tm_val.tm_min, tm_val.tm_sec);
+}
+
+void prof_hist_add(long *hist, double seconds) {
+    double us = seconds * 1e6;
+    int b = 0;
+    while (b < PROF_HIST_BUCKETS - 1 && us >= 2.0) {
+        us *= 0.5;
+        b++;
+    }
+    __atomic_fetch_add(&hist[b], 1, __ATOMIC_RELAXED);
+}
+
+long get_peak_rss_kb() {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return ru.ru_maxrss; // kilobytes on Linux
+}
+
+void print_hist_json(FILE *out, const char *name, const long *hist) {
+    int last = PROF_HIST_BUCKETS - 1;
+    while (last > 0 && hist[last] == 0) last--;
+    fprintf(out, "    \"%s\": [", name);
+    for (int b = 0; b <= last; b++) fprintf(out, "%s%ld", b ? ", " : "", hist[b]);
+    fprintf(out, "]");
+}
+
+void print_profile_json(FILE *out, double total_time) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"times_s\": {\"total\": %.6f, \"discovery\": %.6f, \"processing\": %.6f, "
+                 "\"cache_read\": %.6f, \"file_parse\": %.6f, \"cache_write\": %.6f, \"flux\": %.6f},\n",
+            total_time, g_prof.discovery_time, g_prof.processing_time, g_prof.cache_read_time,
+            g_prof.file_parse_time, g_prof.cache_write_time, g_prof.flux_time);
+    fprintf(out, "  \"io\": {\"files_opened\": %ld, \"bytes_read\": %ld, \"stat_calls\": %ld, \"scandir_calls\": %ld},\n",
+            g_prof.files_opened, g_prof.bytes_read, g_prof.stat_calls, g_prof.scandir_calls);
+    fprintf(out, "  \"cache\": {\"searched\": %ld, \"hits_local\": %ld, \"hits_export\": %ld, \"hits_binary\": %ld, "
+                 "\"misses\": %ld, \"created\": %ld},\n",
+            g_cache_searched, g_prof.cache_hits_local, g_prof.cache_hits_export, g_prof.cache_hits_binary,
+            g_prof.cache_misses, g_cache_created);
+    fprintf(out, "  \"timing_probe\": {\"probes\": %ld, \"fallbacks\": %ld},\n",
+            g_prof.timing_probes, g_prof.timing_probe_fallbacks);
+    if (g_device_count > 0) print_device_stats_json(out);
+    fprintf(out, "  \"latency_hist_us_log2\": {\n");
+    print_hist_json(out, "file_parse", g_prof.parse_hist);
+    fprintf(out, ",\n");
+    print_hist_json(out, "cache_read", g_prof.cache_read_hist);
+    fprintf(out, "\n  },\n");
+    fprintf(out, "  \"memory\": {\"peak_rss_kb\": %ld, \"allocations\": %ld}\n", get_peak_rss_kb(), g_alloc_count);
+    fprintf(out, "}\n");
+}
+
+// Preallocates the ring so that recording a span never allocates
+int trace_init() {
+    g_trace_ring = calloc(TRACE_RING_SIZE, sizeof(TraceEvent));
+    if (!g_trace_ring) return 0;
+    g_trace_capacity = TRACE_RING_SIZE;
+    g_trace_t0 = get_current_time();
+    g_trace = 1;
+    return 1;
+}
+
+// Grows the ring to hold n more events after the recorded ones. Must not be
+// called while spans are being recorded (between scan phases only).
+int trace_reserve(long n) {
+    if (!g_trace) return 0;
+    long total = g_trace_next;
+    long first = (total > g_trace_capacity) ? total - g_trace_capacity : 0;
+    long capacity = (total - first) + n;
+    if (capacity <= g_trace_capacity) return 1;
+    TraceEvent *ring = calloc(capacity, sizeof(TraceEvent));
+    if (!ring) {
+        fprintf(stderr, "Warning: Failed to grow trace buffer to %ld events\n", capacity);
+        return 0;
+    }
+    for (long i = first; i < total; i++) ring[i % capacity] = g_trace_ring[i % g_trace_capacity];
+    free(g_trace_ring);
+    g_trace_ring = ring;
+    g_trace_capacity = capacity;
+    g_trace_dropped = first;
+    return 1;
+}
+
+double trace_begin() {
+    return g_trace ? get_current_time() : 0.0;
+}
+
+// Records a complete span [t0, now]. detail is copied (truncated), name/cat must be static.
+void trace_span(const char *name, const char *cat, double t0, const char *detail, int cache, long count, long bytes) {
+    if (!g_trace) return;
+    double now = get_current_time();
+    if (t_trace_tid == 0) t_trace_tid = (int)syscall(SYS_gettid);
+    long idx = __atomic_fetch_add(&g_trace_next, 1, __ATOMIC_RELAXED);
+    TraceEvent *e = &g_trace_ring[idx % g_trace_capacity];
+    e->name = name;
+    e->cat = cat;
+    e->ts = t0;
+    e->dur = now - t0;
+    e->tid = t_trace_tid;
+    e->cache = cache;
+    e->count = count;
+    e->bytes = bytes;
+    if (detail) {
+        // Keep the tail of long paths (stream/file is the informative part)
+        size_t len = strlen(detail);
+        if (len >= sizeof(e->detail)) detail += len - (sizeof(e->detail) - 1);
+        strncpy(e->detail, detail, sizeof(e->detail) - 1);
+        e->detail[sizeof(e->detail) - 1] = '\0';
+    } else {
+        e->detail[0] = '\0';
+    }
+}
+
+void trace_write_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', fp);
+        if ((unsigned char)*c >= 0x20) fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+// Writes the recorded spans in the Chrome/Perfetto trace-event JSON format
+int trace_write(const char *path) {
+    if (!g_trace_ring) return 0;
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Warning: Failed to write trace %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    long total = g_trace_next;
+    long first = (total > g_trace_capacity) ? total - g_trace_capacity : 0;
+    if (first < g_trace_dropped) first = g_trace_dropped;
+    if (first > 0) fprintf(stderr, "Warning: Trace buffer full, the first %ld events are missing from %s\n", first, path);
+    int pid = (int)getpid();
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"events\": %ld, \"dropped\": %ld},\n\"traceEvents\": [\n", total, first);
+    for (long i = first; i < total; i++) {
+        const TraceEvent *e = &g_trace_ring[i % g_trace_capacity];
+        fprintf(fp, "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d, \"args\": {",
+                e->name, e->cat, (e->ts - g_trace_t0) * 1e6, e->dur * 1e6, pid, e->tid);
+        const char *sep = "";
+        if (e->detail[0]) {
+            fprintf(fp, "\"path\": ");
+            trace_write_string(fp, e->detail);
+            sep = ", ";
+        }
+        if (e->cache >= 0) { fprintf(fp, "%s\"cache\": \"%s\"", sep, e->cache ? "hit" : "miss"); sep = ", "; }
+        if (e->count >= 0) { fprintf(fp, "%s\"count\": %ld", sep, e->count); sep = ", "; }
+        if (e->bytes >= 0) fprintf(fp, "%s\"bytes\": %ld", sep, e->bytes);
+        fprintf(fp, "}}%s\n", (i + 1 < total) ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    fclose(fp);
+    return 1;
+}
+
+void trim_fits_value(char *val) {
+    char *start = val;
+    while (*start == ' ') start++;
+    char *end = start + strlen(start) - 1;
+    while (end > start && (*end == ' ' || *end == '\n' || *end == '\r')) end--;
+    *(end + 1) = '\0';
+    if (*start == '\'' && *end == '\'') {
+        start++;
+        *end = '\0';
+        // Remove leading spaces inside quotes
+        while (*start == ' ') start++;
+        // Remove trailing spaces inside quotes
+        char *new_end = start + strlen(start) - 1;
+        while (new_end > start && *new_end == ' ') new_end--;
+        *(new_end+1) = '\0';
+    }
+    memmove(val, start, strlen(start) + 1);
+}
+
+int read_header_keyword(const char *filepath, const char *key, char *value_out) {
+    FILE *fp = fopen(filepath, "r");
+    if (!fp) return 0;
+
+    char line[82];
+    int found = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, key, strlen(key)) == 0) {
+            char *eq_pos = strchr(line, '=');
+            if (eq_pos) {
+                char *slash_pos = strchr(eq_pos, '/');
+                if (slash_pos) *slash_pos = '\0';
+                strncpy(value_out, eq_pos + 1, 255);
+                value_out[255] = '\0';
+                trim_fits_value(value_out);
+                found = 1;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+// Value field (columns 11-80, NUL terminated in buf) of keyword <key> in a buffer of 80-byte cards.
+// Returns 1 if found.
+int fits_cards_find_value(const char *cards, int ncards, const char *key, char *buf) {
+    size_t key_len = strlen(key);
+    for (int i = 0; i < ncards; i++) {
+        const char *card = cards + (size_t)i * FITS_CARD_SIZE;
+        if (strncmp(card, key, key_len) != 0) continue;
+        if (key_len < 8 && card[key_len] != ' ') continue;
+        if (card[8] != '=') continue;
+        memcpy(buf, card + 10, FITS_CARD_SIZE - 10);
+        buf[FITS_CARD_SIZE - 10] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+// Integer value of keyword <key> in a buffer of 80-byte cards. Returns 1 if found.
+int fits_cards_get_long(const char *cards, int ncards, const char *key, long *value_out) {
+    char buf[FITS_CARD_SIZE - 10 + 1];
+    if (!fits_cards_find_value(cards, ncards, key, buf)) return 0;
+    char *endptr = NULL;
+    long v = strtol(buf, &endptr, 10);
+    if (endptr == buf) return 0;
+    *value_out = v;
+    return 1;
+}
+
+int fits_cards_get_double(const char *cards, int ncards, const char *key, double *value_out) {
+    char buf[FITS_CARD_SIZE - 10 + 1];
+    if (!fits_cards_find_value(cards, ncards, key, buf)) return 0;
+    char *endptr = NULL;
+    double v = strtod(buf, &endptr);
+    if (endptr == buf) return 0;
+    *value_out = v;
+    return 1;
+}
+
+// Size in bytes of the data unit described by a header, padded to whole FITS blocks
+long fits_data_size(const char *cards, int ncards) {
+    long bitpix = 0, naxis = 0, pcount = 0, gcount = 1;
+    if (!fits_cards_get_long(cards, ncards, "BITPIX", &bitpix)) return -1;
+    if (!fits_cards_get_long(cards, ncards, "NAXIS", &naxis)) return -1;
+    if (naxis == 0) return 0;
+    long nelem = 1;
+    for (int i = 1; i <= naxis; i++) {
+        char key[16];
+        long n = 0;
+        snprintf(key, sizeof(key), "NAXIS%d", i);
+        if (!fits_cards_get_long(cards, ncards, key, &n)) return -1;
+        nelem *= n;
+    }
+    fits_cards_get_long(cards, ncards, "PCOUNT", &pcount);
+    fits_cards_get_long(cards, ncards, "GCOUNT", &gcount);
+    long size = labs(bitpix) / 8 * gcount * (pcount + nelem);
+    return (size + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE;
+}
+
+// Read one header unit starting at <offset>, block by block, stopping at the END card.
+// Returns malloc'd cards (caller frees), sets *ncards (excluding END) and *header_bytes.
+char *read_fits_header_at(int fd, off_t offset, int *ncards, long *header_bytes) {
+    char *buf = NULL;
+    size_t len = 0;
+    for (int blk = 0; blk < FITS_MAX_HEADER_BLOCKS; blk++) {
+        buf = realloc(buf, len + FITS_BLOCK_SIZE);
+        ssize_t nr = pread(fd, buf + len, FITS_BLOCK_SIZE, offset + len);
+        if (nr > 0) PROF_COUNT(bytes_read, nr);
+        if (nr != FITS_BLOCK_SIZE) break;
+        for (int c = 0; c < FITS_BLOCK_SIZE / FITS_CARD_SIZE; c++) {
+            const char *card = buf + len + (size_t)c * FITS_CARD_SIZE;
+            if (strncmp(card, "END     ", 8) == 0) {
+                *ncards = (int)(len / FITS_CARD_SIZE) + c;
+                *header_bytes = len + FITS_BLOCK_SIZE;
+                return buf;
+            }
+        }
+        len += FITS_BLOCK_SIZE;
+    }
+    free(buf);
+    return NULL;
+}
+
+// Read the image header of a FITS cube without touching pixel data: the primary HDU
+// for .fits, or the compressed image extension (second HDU) for .fits.fz.
+// Returns malloc'd 80-byte cards (not NUL terminated), or NULL on failure.
+char *read_fits_image_header(const char *fits_path, int *ncards) {
+    int fd = open(fits_path, O_RDONLY);
+    if (fd < 0) return NULL;
+    PROF_COUNT(files_opened, 1);
+
+    long header_bytes = 0;
+    char *cards = read_fits_header_at(fd, 0, ncards, &header_bytes);
+    size_t plen = strlen(fits_path);
+    if (cards && plen > 3 && strcmp(fits_path + plen - 3, ".fz") == 0) {
+        long data_bytes = fits_data_size(cards, *ncards);
+        free(cards);
+        cards = NULL;
+        if (data_bytes >= 0) {
+            long ext_bytes = 0;
+            cards = read_fits_header_at(fd, header_bytes + data_bytes, ncards, &ext_bytes);
+        }
+    }
+    close(fd);
+    return cards;
+}
+
+void ensure_cache_dir_exists(const char *parent_dir) {
+    char cache_path[4096];
+    snprintf(cache_path, sizeof(cache_path), "%s/%s", parent_dir, CACHE_DIR);
+    struct stat st = {0};
+    PROF_COUNT(stat_calls, 1);
+    if (stat(cache_path, &st) == -1) {
+        if (mkdir(cache_path, 0777) != 0) {
+            if (errno != EEXIST) {
+                 fprintf(stderr, "Warning: Failed to create cache directory %s: %s\n", cache_path, strerror(errno));
+            }
+        }
+    }
+}
+
+void ensure_path_exists(const char *filepath) {
+    char temp[4096];
+    strncpy(temp, filepath, sizeof(temp));
+    temp[sizeof(temp) - 1] = '\0';
+
+    // Remove filename to get dir path
+    char *last_slash = strrchr(temp, '/');
+    if (last_slash) {
+        *last_slash = '\0';
+        // Recursively create directories
+        for (char *p = temp + 1; *p; p++) {
+            if (*p == '/') {
+                *p = '\0';
+                if (mkdir(temp, 0777) != 0) {
+                    if (errno != EEXIST) {
+                        // Ignore error, maybe assume intermediate dir exists or permission issue will be caught later
+                    }
+                }
+                *p = '/';
+            }
+        }
+        if (mkdir(temp, 0777) != 0) {
+            if (errno != EEXIST) {
+                 fprintf(stderr, "Warning: Failed to create directory %s: %s\n", temp, strerror(errno));
+            }
+        }
+    }
+}
+
+int read_cache_fp(FILE *fp, FileSummary *summary) {
+    char type[32];
+    summary->has_jitter = 0;
+    summary->dt_std = summary->dt_min = summary->dt_max = 0.0;
+    if (fscanf(fp, "%31s", type) != 1) return 0;
+
+    if (strcmp(type, "CONSTANT") == 0) {
+        summary->is_constant = 1;
+        if (fscanf(fp, "%ld %lf %lf", &summary->count, &summary->start, &summary->end) != 3) {
+            return 0;
+        }
+        summary->timestamps = NULL;
+        // Interval jitter, when the cache was written with it
+        summary->has_jitter = fscanf(fp, "%lf %lf %lf", &summary->dt_std, &summary->dt_min, &summary->dt_max) == 3;
+    } else if (strcmp(type, "RAW") == 0) {
+        summary->is_constant = 0;
+        if (fscanf(fp, "%ld", &summary->count) != 1) {
+             return 0;
+        }
+        summary->timestamps = malloc(summary->count * sizeof(double));
+        for (long i = 0; i < summary->count; i++) {
+            if (fscanf(fp, "%lf", &summary->timestamps[i]) != 1) {
+                free(summary->timestamps);
+                return 0;
+            }
+        }
+        // If count > 0, set start/end
+        if (summary->count > 0) {
+            summary->start = summary->timestamps[0];
+            summary->end = summary->timestamps[summary->count - 1];
+        } else {
+            summary->start = 0;
+            summary->end = 0;
+        }
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+int read_cache(const char *cache_path, FileSummary *summary) {
+    FILE *fp = fopen(cache_path, "r");
+    if (!fp) return 0;
+    PROF_COUNT(files_opened, 1);
+    int ok = read_cache_fp(fp, summary);
+    PROF_COUNT(bytes_read, ftell(fp));
+    fclose(fp);
+    return ok;
+}
+
+int compare_bcache_entries(const void *a, const void *b) {
+    return strcmp(((BinaryCacheEntry *)a)->key, ((BinaryCacheEntry *)b)->key);
+}
+
+// Serialize a binary cache (entries are sorted by key first)
+void write_binary_cache_fp(FILE *fp, BinaryCache *cache) {
+    // Header
+    fwrite(BINARY_CACHE_MAGIC, 1, strlen(BINARY_CACHE_MAGIC) + 1, fp);
+    fwrite(&cache->count, sizeof(int), 1, fp);
+
+    // Sort entries for deterministic output and bsearch on load
+    qsort(cache->entries, cache->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
+
+    for (int i = 0; i < cache->count; i++) {
+        BinaryCacheEntry *e = &cache->entries[i];
+        int key_len = strlen(e->key) + 1;
+        fwrite(&key_len, sizeof(int), 1, fp);
+        fwrite(e->key, 1, key_len, fp);
+        fwrite(&e->summary.is_constant, sizeof(int), 1, fp);
+        fwrite(&e->summary.count, sizeof(long), 1, fp);
+        if (e->summary.is_constant) {
+            fwrite(&e->summary.start, sizeof(double), 1, fp);
+            fwrite(&e->summary.end, sizeof(double), 1, fp);
+            fwrite(&e->summary.has_jitter, sizeof(int), 1, fp);
+            fwrite(&e->summary.dt_std, sizeof(double), 1, fp);
+            fwrite(&e->summary.dt_min, sizeof(double), 1, fp);
+            fwrite(&e->summary.dt_max, sizeof(double), 1, fp);
+        } else {
+            if (e->summary.count > 0) {
+                fwrite(e->summary.timestamps, sizeof(double), e->summary.count, fp);
+            }
+        }
+    }
+}
+
+// Deserialize into an empty binary cache. Entries read before a truncation are kept.
+void read_binary_cache_fp(FILE *fp, BinaryCache *cache) {
+    char magic[32];
+    // Read magic string (null terminated)
+    size_t magic_len = strlen(BINARY_CACHE_MAGIC) + 1;
+    if (fread(magic, 1, magic_len, fp) != magic_len) return;
+    int v1 = strcmp(magic, BINARY_CACHE_MAGIC_V1) == 0;
+    if (!v1 && strcmp(magic, BINARY_CACHE_MAGIC) != 0) return; // invalid or unknown version
+
+    int count = 0;
+    if (fread(&count, sizeof(int), 1, fp) != 1 || count < 0) return;
+
+    cache->capacity = count + 100; // Preallocate some extra
+    cache->entries = malloc(cache->capacity * sizeof(BinaryCacheEntry));
+
+    for (int i = 0; i < count; i++) {
+        BinaryCacheEntry *e = &cache->entries[i];
+        int key_len = 0;
+        if (fread(&key_len, sizeof(int), 1, fp) != 1 || key_len <= 0) break;
+        e->key = malloc(key_len);
+        memset(&e->summary, 0, sizeof(e->summary));
+        if (fread(e->key, 1, key_len, fp) != (size_t)key_len) { free(e->key); break; }
+        e->key[key_len - 1] = '\0';
+
+        if (fread(&e->summary.is_constant, sizeof(int), 1, fp) != 1) { free(e->key); break; }
+        if (fread(&e->summary.count, sizeof(long), 1, fp) != 1) { free(e->key); break; }
+
+        if (e->summary.is_constant) {
+            if (fread(&e->summary.start, sizeof(double), 1, fp) != 1) { free(e->key); break; }
+            if (fread(&e->summary.end, sizeof(double), 1, fp) != 1) { free(e->key); break; }
+            if (!v1 && (fread(&e->summary.has_jitter, sizeof(int), 1, fp) != 1 ||
+                        fread(&e->summary.dt_std, sizeof(double), 1, fp) != 1 ||
+                        fread(&e->summary.dt_min, sizeof(double), 1, fp) != 1 ||
+                        fread(&e->summary.dt_max, sizeof(double), 1, fp) != 1)) { free(e->key); break; }
+        } else {
+            if (e->summary.count > 0) {
+                e->summary.timestamps = malloc(e->summary.count * sizeof(double));
+                if (fread(e->summary.timestamps, sizeof(double), e->summary.count, fp) != (size_t)e->summary.count) {
+                    free(e->summary.timestamps);
+                    free(e->key);
+                    break;
+                }
+                // Set bounds
+                e->summary.start = e->summary.timestamps[0];
+                e->summary.end = e->summary.timestamps[e->summary.count - 1];
+            }
+        }
+        cache->count = i + 1;
+    }
+    // Assuming file on disk is sorted
+}
+
+void free_binary_cache(BinaryCache *cache) {
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].key);
+        if (cache->entries[i].summary.timestamps) {
+            free(cache->entries[i].summary.timestamps);
+        }
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+// Cache files are written to <path>.tmp.<pid> and renamed over <path> when complete, so
+// readers (which never lock) see either the previous or the new version, never a partial one
+FILE *open_cache_tmp(const char *path, char *tmp_path, size_t size) {
+    snprintf(tmp_path, size, "%s.tmp.%d", path, (int)getpid());
+    return fopen(tmp_path, "wb");
+}
+
+int publish_cache_tmp(FILE *fp, const char *tmp_path, const char *path) {
+    if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+        int err = errno;
+        unlink(tmp_path);
+        errno = err;
+        return 0;
+    }
+    return 1;
+}
+
+// Moves the entries of the cache file on disk that are missing from <cache> (added by
+// other processes since it was loaded) into <cache>
+void merge_binary_cache_from_disk(BinaryCache *cache) {
+    FILE *fp = fopen(cache->filepath, "rb");
+    if (!fp) return;
+    BinaryCache *disk = calloc(1, sizeof(BinaryCache));
+    read_binary_cache_fp(fp, disk);
+    fclose(fp);
+
+    qsort(cache->entries, cache->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
+    int own = cache->count;
+    for (int i = 0; i < disk->count; i++) {
+        BinaryCacheEntry *e = &disk->entries[i];
+        if (own > 0 && bsearch(e, cache->entries, own, sizeof(BinaryCacheEntry), compare_bcache_entries)) continue;
+        if (cache->count == cache->capacity) {
+            cache->capacity = (cache->capacity == 0) ? 100 : cache->capacity * 2;
+            cache->entries = realloc(cache->entries, cache->capacity * sizeof(BinaryCacheEntry));
+        }
+        cache->entries[cache->count++] = *e;
+        e->key = NULL;
+        e->summary.timestamps = NULL;
+    }
+    free_binary_cache(disk);
+}
+
+// Writes the cache (it stays loaded). Concurrent writers of the same night are serialized
+// with flock on <cache>.lock, and each merges what the others published before writing.
+// Returns bytes written, -1 on error.
+long save_binary_cache(BinaryCache *cache) {
+    char lock_path[4200];
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", cache->filepath);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT, 0666);
+    if (lock_fd >= 0) flock(lock_fd, LOCK_EX); // without a lock file (read-only dir), merge unlocked
+    merge_binary_cache_from_disk(cache);
+
+    char tmp_path[4200];
+    long bytes = -1;
+    FILE *fp = open_cache_tmp(cache->filepath, tmp_path, sizeof(tmp_path));
+    if (fp) {
+        write_binary_cache_fp(fp, cache);
+        bytes = ftell(fp);
+        if (!publish_cache_tmp(fp, tmp_path, cache->filepath)) bytes = -1;
+    }
+    int err = errno;
+    if (lock_fd >= 0) close(lock_fd); // releases the lock
+    errno = err;
+    if (bytes >= 0) cache->dirty = 0;
+    return bytes;
+}
+
+void flush_binary_cache() {
+    if (!g_binary_cache) return;
+    if (g_binary_cache->dirty) {
+        double t_trace = trace_begin();
+        long bytes = save_binary_cache(g_binary_cache);
+        if (bytes >= 0) {
+            trace_span("flush_binary_cache", "cache", t_trace, g_binary_cache->filepath, -1, g_binary_cache->count, bytes);
+            g_cache_created++; // One creation per night cache file
+        } else {
+             fprintf(stderr, "Warning: Failed to write binary cache %s: %s\n", g_binary_cache->filepath, strerror(errno));
+        }
+    }
+    free_binary_cache(g_binary_cache);
+    g_binary_cache = NULL;
+}
+
+void load_binary_cache(const char *filepath) {
+    if (g_binary_cache) flush_binary_cache();
+
+    g_binary_cache = calloc(1, sizeof(BinaryCache));
+    strncpy(g_binary_cache->filepath, filepath, 4095);
+
+    double t_trace = trace_begin();
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) return; // New cache
+    PROF_COUNT(files_opened, 1);
+    read_binary_cache_fp(fp, g_binary_cache);
+    long bytes = ftell(fp);
+    PROF_COUNT(bytes_read, bytes);
+    fclose(fp);
+    g_binary_cache->dirty = 0;
+    trace_span("load_binary_cache", "cache", t_trace, filepath, -1, g_binary_cache->count, bytes);
+}
+
+void add_to_binary_cache(const char *key, const FileSummary *summary) {
+    if (!g_binary_cache) return;
+    if (g_binary_cache->count == g_binary_cache->capacity) {
+        g_binary_cache->capacity = (g_binary_cache->capacity == 0) ? 100 : g_binary_cache->capacity * 2;
+        g_binary_cache->entries = realloc(g_binary_cache->entries, g_binary_cache->capacity * sizeof(BinaryCacheEntry));
+    }
+    BinaryCacheEntry *e = &g_binary_cache->entries[g_binary_cache->count++];
+    e->key = strdup(key);
+    e->summary = *summary; // Shallow copy
+    // Deep copy timestamps if needed
+    if (summary->timestamps) {
+        e->summary.timestamps = malloc(summary->count * sizeof(double));
+        memcpy(e->summary.timestamps, summary->timestamps, summary->count * sizeof(double));
+    }
+    g_binary_cache->dirty = 1;
+}
+
+FileSummary* find_in_binary_cache(const char *key) {
+    if (!g_binary_cache) return NULL;
+
+    // Use bsearch
+    BinaryCacheEntry target;
+    target.key = (char*)key;
+    // Note: bsearch requires the array to be sorted.
+    // If we just added entries (dirty), it might not be sorted.
+    // Optimization: if strictly appending alpha, it remains sorted.
+    // But scan order is alpha. So appending usually preserves sort.
+    // But to be safe, if dirty, we might need linear search or sort?
+    // Sorting every add is slow.
+    // Linear search for new entries + bsearch for old?
+    // Given the constraints and typical use, simple linear search if not sorted?
+    // Let's just assume sorted for the loaded part, and linear scan the rest?
+    // Or just linear scan all? N ~ 1000s. Fast enough in memory.
+    // Let's implement bsearch for loaded entries and assume sort.
+    // Wait, if I add entries, I break sort if not careful.
+    // For now, let's stick to bsearch on the whole thing but we must ensure sort.
+    // Actually, `scan_stream_dir` calls alphasort. So we add in order.
+    // So the array *should* be sorted.
+    // We can assume sorted.
+
+    void *res = bsearch(&target, g_binary_cache->entries, g_binary_cache->count, sizeof(BinaryCacheEntry), compare_bcache_entries);
+    if (res) {
+        return &((BinaryCacheEntry*)res)->summary;
+    }
+    return NULL;
+}
+
+void write_cache_fp(FILE *fp, const FileSummary *summary) {
+    if (summary->is_constant) {
+        fprintf(fp, "CONSTANT %ld %.9f %.9f", summary->count, summary->start, summary->end);
+        if (summary->has_jitter) fprintf(fp, " %.9g %.9g %.9g", summary->dt_std, summary->dt_min, summary->dt_max);
+        fputc('\n', fp);
+    } else {
+        fprintf(fp, "RAW %ld\n", summary->count);
+        for (long i = 0; i < summary->count; i++) {
+            fprintf(fp, "%.9f\n", summary->timestamps[i]);
+        }
+    }
+}
+
+void write_cache(const char *cache_path, const FileSummary *summary) {
+    char tmp_path[8300];
+    FILE *fp = open_cache_tmp(cache_path, tmp_path, sizeof(tmp_path));
+    if (!fp) return;
+    write_cache_fp(fp, summary);
+    publish_cache_tmp(fp, tmp_path, cache_path);
+}
+
+double get_current_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+TrackedKey* get_tracked_key(const char *stream, const char *key) {
+    for (int i = 0; i < kscan_ctx.tracked_count; i++) {
+        if (strcmp(kscan_ctx.tracked_keys[i].stream_name, stream) == 0 &&
+            strcmp(kscan_ctx.tracked_keys[i].key, key) == 0) {
+            return &kscan_ctx.tracked_keys[i];
+        }
+    }
+    if (kscan_ctx.tracked_count == kscan_ctx.tracked_capacity) {
+        kscan_ctx.tracked_capacity = (kscan_ctx.tracked_capacity == 0) ? 10 : kscan_ctx.tracked_capacity * 2;
+        kscan_ctx.tracked_keys = realloc(kscan_ctx.tracked_keys, kscan_ctx.tracked_capacity * sizeof(TrackedKey));
+    }
+    TrackedKey *tk = &kscan_ctx.tracked_keys[kscan_ctx.tracked_count++];
+    strncpy(tk->stream_name, stream, 255);
+    strncpy(tk->key, key, 79);
+    tk->key[79] = '\0';
+    tk->last_value[0] = '\0';
+    tk->count_same_val = 0;
+    tk->has_last_value = 0;
+    return tk;
+}
+
+// Keyword of a "KEY = value / comment" card, trailing blanks removed (key must hold 81
+// bytes). Returns the position of the '=', or NULL if the card has none.
+const char *header_card_key(const char *line, char *key) {
+    const char *eq_pos = strchr(line, '=');
+    if (!eq_pos) return NULL;
+
+    size_t key_len = eq_pos - line;
+    if (key_len > 80) key_len = 80;
+    memcpy(key, line, key_len);
+    key[key_len] = '\0';
+    char *end = key + strlen(key) - 1;
+    while (end >= key && (*end == ' ' || *end == '\t')) *end-- = '\0';
+    return eq_pos;
+}
+
+// Value of a card following its '=', without comment and quotes (value must hold 256 bytes)
+void header_card_value(const char *eq_pos, char *value) {
+    strncpy(value, eq_pos + 1, 255);
+    value[255] = '\0';
+    char *slash_pos = strchr(value, '/');
+    if (slash_pos) *slash_pos = '\0';
+    trim_fits_value(value);
+}
+
+// Keyword and value of a "KEY = value / comment" card; returns 1 if the keyword matches
+// the -k pattern. key and value must hold 81 and 256 bytes.
+int header_card_match(const char *line, char *key, char *value) {
+    const char *eq_pos = header_card_key(line, key);
+    if (!eq_pos) return 0;
+    if (regexec(&kscan_ctx.key_regex, key, 0, NULL, 0) != 0) return 0;
+    header_card_value(eq_pos, value);
+    return 1;
+}
+
+// Value of <key> in the header of a file at file_timestamp; headers of a stream must be
+// passed in chronological order
+void track_key_value(const char *key, const char *value, const char *filename, const char *stream_name, double file_timestamp) {
+    TrackedKey *tk = get_tracked_key(stream_name, key);
+
+    if (!tk->has_last_value) {
+        ReportLine rl;
+        rl.is_count_line = 0;
+        strncpy(rl.stream_name, stream_name, 255);
+        strncpy(rl.keyname, key, 79);
+        rl.ts = file_timestamp;
+        strcpy(rl.status, "INITIAL");
+        strncpy(rl.value, value, 255);
+        strncpy(rl.filename, filename, 255);
+        add_report_line(&kscan_ctx.report, rl);
+
+        strncpy(tk->last_value, value, 255);
+        tk->count_same_val = 1;
+        tk->has_last_value = 1;
+    } else {
+        if (strcmp(value, tk->last_value) != 0) {
+            ReportLine count_line;
+            count_line.is_count_line = 1;
+            count_line.count = tk->count_same_val;
+            count_line.ts = file_timestamp;
+            strncpy(count_line.keyname, key, 79);
+            strncpy(count_line.stream_name, stream_name, 255);
+            add_report_line(&kscan_ctx.report, count_line);
+
+            ReportLine change_line;
+            change_line.is_count_line = 0;
+            strncpy(change_line.stream_name, stream_name, 255);
+            strncpy(change_line.keyname, key, 79);
+            change_line.ts = file_timestamp;
+            strcpy(change_line.status, "CHANGE");
+            strncpy(change_line.value, value, 255);
+            strncpy(change_line.filename, filename, 255);
+            add_report_line(&kscan_ctx.report, change_line);
+
+            strncpy(tk->last_value, value, 255);
+            tk->count_same_val = 1;
+        } else {
+            tk->count_same_val++;
+        }
+    }
+}
+
+void header_cards_add(HeaderCards *hc, const char *key, const char *value) {
+    if (hc->count == hc->capacity) {
+        hc->capacity = (hc->capacity == 0) ? 4 : hc->capacity * 2;
+        hc->cards = realloc(hc->cards, hc->capacity * sizeof(HeaderCard));
+    }
+    HeaderCard *c = &hc->cards[hc->count++];
+    memcpy(c->key, key, sizeof(c->key));
+    memcpy(c->value, value, sizeof(c->value));
+}
+
+void header_cards_free(HeaderCards *hc) {
+    free(hc->cards);
+    memset(hc, 0, sizeof(*hc));
+}
+
+// Matching cards of a .fits.header sidecar file held in memory
+void header_buffer_cards(const char *buf, size_t len, HeaderCards *hc) {
+    char line[82];
+    char key[81];
+    char value[256];
+    const char *cur = buf;
+    const char *end = buf + len;
+    while (cur < end) {
+        const char *nl = memchr(cur, '\n', end - cur);
+        size_t line_len = nl ? (size_t)(nl - cur) + 1 : (size_t)(end - cur);
+        size_t take = line_len < sizeof(line) - 1 ? line_len : sizeof(line) - 1;
+        memcpy(line, cur, take);
+        line[take] = '\0';
+        if (header_card_match(line, key, value)) header_cards_add(hc, key, value);
+        cur += take;
+    }
+}
+
+// Matching cards of a .fits.header sidecar file, taken from ra if it was read ahead.
+// Returns 0 if the file cannot be read.
+int read_header_cards(const char *header_path, Readahead *ra, HeaderCards *hc) {
+    char *buf = NULL;
+    size_t ra_len = 0;
+    ssize_t len;
+    if (readahead_take(ra, header_path, &buf, &ra_len)) {
+        len = (ssize_t)ra_len;
+    } else {
+        int fd = open(header_path, O_RDONLY);
+        if (fd < 0) return 0;
+        PROF_COUNT(files_opened, 1);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return 0;
+        }
+        buf = malloc(st.st_size);
+        len = read(fd, buf, st.st_size);
+        close(fd);
+        if (len > 0) PROF_COUNT(bytes_read, len);
+    }
+    if (len > 0) header_buffer_cards(buf, len, hc);
+    free(buf);
+    return len > 0;
+}
+
+// Matching cards of the header of a .fits or .fits.fz cube (used when no sidecar exists)
+int fits_header_cards(const char *fits_path, HeaderCards *hc) {
+    int ncards = 0;
+    char *cards = read_fits_image_header(fits_path, &ncards);
+    if (!cards) return 0;
+
+    char line[FITS_CARD_SIZE + 1];
+    char key[81];
+    char value[256];
+    for (int i = 0; i < ncards; i++) {
+        memcpy(line, cards + (size_t)i * FITS_CARD_SIZE, FITS_CARD_SIZE);
+        line[FITS_CARD_SIZE] = '\0';
+        if (header_card_match(line, key, value)) header_cards_add(hc, key, value);
+    }
+    free(cards);
+    return 1;
+}
+
+void reduce_header_cards(const HeaderCards *hc, const char *filename, const char *stream_name, double file_timestamp) {
+    for (int i = 0; i < hc->count; i++) {
+        track_key_value(hc->cards[i].key, hc->cards[i].value, filename, stream_name, file_timestamp);
+    }
+}
+
+// Keyword tracking over the content of a .fits.header sidecar file held in memory
+void process_header_buffer_for_key(const char *buf, size_t len, const char *filename, const char *stream_name, double file_timestamp) {
+    HeaderCards hc = {0};
+    header_buffer_cards(buf, len, &hc);
+    reduce_header_cards(&hc, filename, stream_name, file_timestamp);
+    header_cards_free(&hc);
+}
+
+double parse_filename_time(const char *filename, const char *date_str) {
+    // filename format: sname_HH:MM:SS.sssssssss.txt
+    // date_str: YYYYMMDD
+    return filename_time_from_epoch(filename, strlen(filename), date_dir_epoch(date_str));
+}
+
+void timing_parser_init(TimingParser *p) {
+    p->capacity = 1000;
+    p->timestamps = malloc(p->capacity * sizeof(double));
+    p->latencies = NULL;
+    p->count = 0;
+    p->partial_len = 0;
+}
+
+// Also collect col4 - col5 (logging minus acquisition time) of every frame
+void timing_parser_enable_latency(TimingParser *p) {
+    p->latencies = malloc(p->capacity * sizeof(double));
+}
+
+// One timing line [line, end) without its newline: append col5 if present (and col4 - col5)
+void timing_parser_line(TimingParser *p, const char *line, const char *end) {
+    if (line == end || line[0] == '#') return;
+    const char *c = line;
+    const char *col4 = NULL;
+    for (int col = 0; ; col++) {
+        while (c < end && (*c == ' ' || *c == '\t')) c++;
+        if (c >= end) return;
+        if (col == 3) col4 = c;
+        if (col == 4) break;
+        while (c < end && *c != ' ' && *c != '\t') c++;
+    }
+    if (p->count == p->capacity) {
+        p->capacity *= 2;
+        p->timestamps = realloc(p->timestamps, p->capacity * sizeof(double));
+        if (p->latencies) p->latencies = realloc(p->latencies, p->capacity * sizeof(double));
+    }
+    double timestamp = strtod(c, NULL);
+    if (p->latencies) p->latencies[p->count] = strtod(col4, NULL) - timestamp;
+    p->timestamps[p->count++] = timestamp;
+}
+
+// Feed a chunk of timing file content; a trailing partial line is kept for the next chunk
+void timing_parser_feed(TimingParser *p, const char *buf, size_t len) {
+    const char *cur = buf;
+    const char *end = buf + len;
+    if (p->partial_len > 0) {
+        const char *nl = memchr(cur, '\n', len);
+        size_t take = nl ? (size_t)(nl - cur) : len;
+        if (p->partial_len + take >= sizeof(p->partial)) take = sizeof(p->partial) - 1 - p->partial_len;
+        memcpy(p->partial + p->partial_len, cur, take);
+        p->partial_len += take;
+        if (!nl) return;
+        p->partial[p->partial_len] = '\0';
+        timing_parser_line(p, p->partial, p->partial + p->partial_len);
+        p->partial_len = 0;
+        cur = nl + 1;
+    }
+    while (cur < end) {
+        const char *nl = memchr(cur, '\n', end - cur);
+        if (!nl) {
+            size_t take = end - cur;
+            if (take >= sizeof(p->partial)) take = sizeof(p->partial) - 1;
+            memcpy(p->partial, cur, take);
+            p->partial_len = take;
+            break;
+        }
+        timing_parser_line(p, cur, nl);
+        cur = nl + 1;
+    }
+}
+
+void timing_parser_finish(TimingParser *p) {
+    if (p->partial_len > 0) {
+        p->partial[p->partial_len] = '\0';
+        timing_parser_line(p, p->partial, p->partial + p->partial_len);
+        p->partial_len = 0;
+    }
+}
+
+// 1 if all consecutive intervals are within 10% of the mean interval
+int detect_constant_rate(const double *ts_arr, long count) {
+    if (count <= 2) return 0;
+    double dt_sum = 0;
+    for (long i = 0; i < count - 1; i++) {
+        dt_sum += (ts_arr[i+1] - ts_arr[i]);
+    }
+    double mean_dt = dt_sum / (count - 1);
+    for (long i = 0; i < count - 1; i++) {
+        double dt = ts_arr[i+1] - ts_arr[i];
+        if (fabs(dt - mean_dt) > 0.10 * mean_dt) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Key of a timing file root/date/stream/file in its night binary cache: "stream/file"
+const char *binary_cache_key(const char *filepath) {
+    const char *dir_sep = strrchr(filepath, '/');
+    if (!dir_sep) return filepath;
+    for (const char *p = dir_sep - 1; p >= filepath; p--) {
+        if (*p == '/') return p + 1;
+    }
+    return dir_sep + 1;
+}
+
+// Night binary cache of a timing file: root/date/telemetry.cache with -cacheexport,
+// cache/root/date/telemetry.cache otherwise
+void binary_cache_path_for(const char *filepath, char *out, size_t size) {
+    const char *key = binary_cache_key(filepath);
+    char date_dir_path[4096];
+    size_t len = 0;
+    if (key != filepath && key - 1 != strrchr(filepath, '/')) len = key - 1 - filepath;
+    if (len > 0) {
+        if (len >= sizeof(date_dir_path)) len = sizeof(date_dir_path) - 1;
+        strncpy(date_dir_path, filepath, len);
+        date_dir_path[len] = '\0';
+    } else {
+        strcpy(date_dir_path, ".");
+    }
+
+    if (g_cache_export) {
+        snprintf(out, size, "%s/%s", date_dir_path, BINARY_CACHE_FILENAME);
+    } else {
+        snprintf(out, size, "%s/%s/%s", g_cache_root, date_dir_path, BINARY_CACHE_FILENAME);
+    }
+}
+
+// Night cache of a date directory (binary_cache_path_for only uses the directory part)
+void night_cache_path(const char *date_path, char *out, size_t size) {
+    char filepath[4200];
+    snprintf(filepath, sizeof(filepath), "%s/stream/file.txt", date_path);
+    binary_cache_path_for(filepath, out, size);
+}
+
+int is_date_name(const char *name) {
+    if (strlen(name) != 8) return 0;
+    for (int i = 0; i < 8; i++) {
+        if (name[i] < '0' || name[i] > '9') return 0;
+    }
+    return 1;
+}
+
+// Per-file summary caches of a timing file: cache/<path>.cache and <dir>/cache/<file>.cache
+void file_cache_paths(const char *filepath, char *local_cache_path, char *export_cache_path, size_t size) {
+    const char *dir_sep = strrchr(filepath, '/');
+    snprintf(local_cache_path, size, "%s/%s%s", g_cache_root, filepath, CACHE_EXT);
+    if (dir_sep) {
+        char dir_path[4096];
+        size_t dir_len = dir_sep - filepath;
+        if (dir_len >= sizeof(dir_path)) dir_len = sizeof(dir_path) - 1;
+        strncpy(dir_path, filepath, dir_len);
+        dir_path[dir_len] = '\0';
+        snprintf(export_cache_path, size, "%s/%s/%s%s", dir_path, CACHE_DIR, dir_sep + 1, CACHE_EXT);
+    } else {
+        snprintf(export_cache_path, size, "%s/%s%s", g_cache_root, filepath, CACHE_EXT);
+    }
+}
+
+// Whether get_file_data would find a cached summary, without reading it
+int summary_cache_exists(const char *timing_path) {
+    if (g_no_cache) return 0;
+    char filepath[4096];
+    timing_cache_key_path(timing_path, filepath, sizeof(filepath));
+    if (g_use_binary_cache) {
+        char bcache_path[8192];
+        binary_cache_path_for(filepath, bcache_path, sizeof(bcache_path));
+        if (!g_binary_cache || strcmp(g_binary_cache->filepath, bcache_path) != 0) {
+            load_binary_cache(bcache_path);
+        }
+        return find_in_binary_cache(binary_cache_key(filepath)) != NULL;
+    }
+    char local_cache_path[8192];
+    char export_cache_path[8192];
+    file_cache_paths(filepath, local_cache_path, export_cache_path, sizeof(local_cache_path));
+    PROF_COUNT(stat_calls, 1);
+    if (access(local_cache_path, R_OK) == 0) return 1;
+    PROF_COUNT(stat_calls, 1);
+    return access(export_cache_path, R_OK) == 0;
+}
+
+// Frame index (col1) and acquisition time (col5) of the timing record [rec, rec + len)
+int parse_timing_record(const char *rec, size_t len, long *index, double *timestamp) {
+    char line[256];
+    if (len == 0 || len >= sizeof(line) || rec[0] == '#') return 0;
+    memcpy(line, rec, len);
+    line[len] = '\0';
+    char *c = line;
+    char *end;
+    *index = strtol(c, &end, 10);
+    if (end == c) return 0;
+    c = end;
+    for (int col = 1; col < 4; col++) {
+        while (*c == ' ' || *c == '\t') c++;
+        while (*c && *c != ' ' && *c != '\t') c++;
+    }
+    *timestamp = strtod(c, &end);
+    return end != c;
+}
+
+// Summary of a constant-rate timing file from a few records, without parsing it: data lines
+// written by save_telemetry_fits_function all have the same length, so the frame count
+// follows from the file size (cross-checked with NAXIS3/ZNAXIS3 of the sidecar header when
+// present), and the first, last and PROBE_SAMPLES pairs of records at stride must carry
+// their frame index and lie on the constant-rate line. Returns 0 if any check fails
+// (the file must then be parsed).
+int probe_timing_file(const char *filepath, FileSummary *summary) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return 0;
+    PROF_COUNT(files_opened, 1);
+    int ok = 0;
+    struct stat st;
+    char head[PROBE_HEAD_BYTES];
+    char rec[512];
+    long data_off = 0, rec_len = 0, count = 0, first_index = 0, index = 0;
+    double t_first = 0, t_last = 0, t = 0;
+    if (fstat(fd, &st) != 0) goto done;
+    ssize_t nr = pread(fd, head, sizeof(head), 0);
+    if (nr <= 0) goto done;
+    PROF_COUNT(bytes_read, nr);
+
+    // Comment header, then the first data record
+    while (data_off < nr && head[data_off] == '#') {
+        const char *nl = memchr(head + data_off, '\n', nr - data_off);
+        if (!nl) goto done;
+        data_off = nl - head + 1;
+    }
+    const char *nl = memchr(head + data_off, '\n', nr - data_off);
+    if (!nl) goto done;
+    rec_len = nl - (head + data_off) + 1;
+    if (rec_len * 2 > (long)sizeof(rec) || (st.st_size - data_off) % rec_len != 0) goto done;
+    count = (st.st_size - data_off) / rec_len;
+    if (count <= 2) goto done;
+    if (!parse_timing_record(head + data_off, rec_len - 1, &first_index, &t_first)) goto done;
+
+    char headerpath[1024];
+    char value[256];
+    header_sidecar_path(filepath, headerpath, sizeof(headerpath));
+    if (read_header_keyword(headerpath, "NAXIS3", value) || read_header_keyword(headerpath, "ZNAXIS3", value)) {
+        if (atol(value) != count) goto done;
+    }
+
+    // Last record
+    off_t last_off = data_off + (off_t)(count - 1) * rec_len;
+    if (pread(fd, rec, rec_len, last_off) != rec_len || rec[rec_len - 1] != '\n') goto done;
+    PROF_COUNT(bytes_read, rec_len);
+    if (!parse_timing_record(rec, rec_len - 1, &index, &t_last) || index != first_index + count - 1) goto done;
+    double dt = (t_last - t_first) / (count - 1);
+    if (!(dt > 0)) goto done;
+
+    // Pairs of records at stride: index, position on the line, and local interval
+    for (int k = 1; k <= PROBE_SAMPLES; k++) {
+        long i = (long)((double)k * (count - 2) / (PROBE_SAMPLES + 1));
+        if (pread(fd, rec, 2 * rec_len, data_off + (off_t)i * rec_len) != 2 * rec_len) goto done;
+        PROF_COUNT(bytes_read, 2 * rec_len);
+        if (rec[rec_len - 1] != '\n' || rec[2 * rec_len - 1] != '\n') goto done;
+        double t_next;
+        long index_next;
+        if (!parse_timing_record(rec, rec_len - 1, &index, &t) || index != first_index + i) goto done;
+        if (!parse_timing_record(rec + rec_len, rec_len - 1, &index_next, &t_next) || index_next != index + 1) goto done;
+        if (fabs(t - (t_first + i * dt)) > PROBE_MAX_DEVIATION * dt) goto done;
+        if (fabs((t_next - t) - dt) > 0.10 * dt) goto done;
+    }
+
+    summary->is_constant = 1;
+    summary->count = count;
+    summary->start = t_first;
+    summary->end = t_last;
+    summary->timestamps = NULL;
+    ok = 1;
+done:
+    close(fd);
+    return ok;
+}
+
+// Whether get_file_data tries the record probe on a cache miss: plain timing files, unless
+// every frame is needed (latency cache written from the same parse, interval jitter)
+int timing_probe_applies(const char *filepath) {
+    if (!g_timing_probe || g_rate_stats || (g_latency_stats && !g_no_cache)) return 0;
+    return timing_compression(filepath, strlen(filepath)) == TIMING_TXT;
+}
+
+// Whether the uncached timing files of a stream are worth reading ahead: not when the first
+// of them can be probed (the others most likely can too, from a few records each)
+int timing_readahead_wanted(const char *filepath) {
+    if (!timing_probe_applies(filepath)) return 1;
+    FileSummary fs;
+    return !probe_timing_file(filepath, &fs);
+}
+
+// Summary of timing file <timing_path> from all its records (latency cache written along
+// when collected). Returns the number of bytes read, -1 if the file cannot be read.
+static long parse_timing_file(const char *timing_path, FileSummary *summary, double t_parse_start) {
+    TimingParser parser;
+    timing_parser_init(&parser);
+    if (g_latency_stats && !g_no_cache) timing_parser_enable_latency(&parser);
+    // Whole file if it was read ahead, otherwise read (and decompressed) in chunks
+    char *ra_buf = NULL;
+    size_t ra_len = 0;
+    readahead_take(g_readahead, timing_path, &ra_buf, &ra_len);
+    long bytes = timing_parser_read_file(&parser, timing_path, ra_buf, ra_len);
+    if (bytes < 0) {
+        free(parser.timestamps);
+        free(parser.latencies);
+        return -1;
+    }
+    timing_parser_finish(&parser);
+
+    if (g_profile) {
+        double dt = get_current_time() - t_parse_start;
+        g_prof.file_parse_time += dt;
+        prof_hist_add(g_prof.parse_hist, dt);
+    }
+
+    // Latency summary from the same parse, so that -latency does not read the file again
+    if (parser.latencies) {
+        LatencySummary ls;
+        latency_summary_from_frames(&ls, parser.latencies, parser.count);
+        char latency_cache[8192];
+        aux_cache_path(timing_path, LATENCY_CACHE_EXT, latency_cache, sizeof(latency_cache));
+        write_latency_cache(latency_cache, bytes, &ls);
+        free_latency_summary(&ls);
+        free(parser.latencies);
+    }
+
+    long count = parser.count;
+    summary->count = count;
+    summary->timestamps = parser.timestamps;
+    if (count > 0) {
+        summary->start = parser.timestamps[0];
+        summary->end = parser.timestamps[count - 1];
+    }
+
+    // Analyze for constant frame rate
+    if (detect_constant_rate(summary->timestamps, count)) {
+        IntervalStats jitter = {0};
+        for (long k = 1; k < count; k++) interval_stats_add(&jitter, summary->timestamps[k] - summary->timestamps[k - 1]);
+        summary->has_jitter = 1;
+        summary->dt_std = interval_stats_std(&jitter);
+        summary->dt_min = jitter.min;
+        summary->dt_max = jitter.max;
+        summary->is_constant = 1;
+        free(summary->timestamps);
+        summary->timestamps = NULL;
+    }
+    return bytes;
+}
+
+void get_file_data(const char *timing_path, FileSummary *summary) {
+    // Caches are keyed by the uncompressed name (x.txt for x.txt.gz)
+    char filepath[4096];
+    timing_cache_key_path(timing_path, filepath, sizeof(filepath));
+
+    // Construct both potential cache paths
+    char local_cache_path[8192];
+    char export_cache_path[8192];
+    char *dir_sep = strrchr(filepath, '/');
+    double t_trace = trace_begin();
+    FileSummary *stale_entry = NULL; // binary cache entry to replace
+
+    if (!g_no_cache) {
+        g_cache_searched++;
+
+        // Binary Cache Logic
+        if (g_use_binary_cache) {
+            const char *key = binary_cache_key(filepath);
+
+            // Ensure correct binary cache file (root/date/telemetry.cache) is loaded
+            char bcache_path[8192];
+            binary_cache_path_for(filepath, bcache_path, sizeof(bcache_path));
+            if (!g_cache_export) ensure_path_exists(bcache_path);
+
+            // Check if loaded matches
+            if (!g_binary_cache || strcmp(g_binary_cache->filepath, bcache_path) != 0) {
+                load_binary_cache(bcache_path);
+            }
+
+            // Search
+            double t0 = 0;
+            if (g_profile) t0 = get_current_time();
+            FileSummary *s = find_in_binary_cache(key);
+            if (g_profile) {
+                double dt = get_current_time() - t0;
+                g_prof.cache_read_time += dt;
+                prof_hist_add(g_prof.cache_read_hist, dt);
+            }
+
+            // -rate needs the interval jitter of constant-rate files: summarize them again
+            // if it was not kept, replacing the entry
+            if (s && g_rate_stats && s->is_constant && !s->has_jitter) {
+                stale_entry = s;
+                s = NULL;
+            }
+            if (s) {
+                g_cache_found++;
+                PROF_COUNT(cache_hits_binary, 1);
+                *summary = *s;
+                // Deep copy timestamps for caller to own (if raw)
+                if (s->timestamps) {
+                    summary->timestamps = malloc(s->count * sizeof(double));
+                    memcpy(summary->timestamps, s->timestamps, s->count * sizeof(double));
+                }
+                trace_span("get_file_data", "file", t_trace, timing_path, 1, summary->count, -1);
+                return;
+            }
+        } else {
+            // Per-file Cache Logic
+            file_cache_paths(filepath, local_cache_path, export_cache_path, sizeof(local_cache_path));
+
+            // Try reading (Priority: Local, then Export)
+            // Actually, user said: "The program will look for the cache in both location, and report if found."
+            // We check local first.
+            double t0 = 0;
+            if (g_profile) t0 = get_current_time();
+            int found = 0;
+            if (read_cache(local_cache_path, summary)) {
+                found = 1;
+                PROF_COUNT(cache_hits_local, 1);
+            } else if (read_cache(export_cache_path, summary)) {
+                found = 1;
+                PROF_COUNT(cache_hits_export, 1);
+            }
+            if (g_profile) {
+                double dt = get_current_time() - t0;
+                g_prof.cache_read_time += dt;
+                prof_hist_add(g_prof.cache_read_hist, dt);
+            }
+
+            if (found && g_rate_stats && summary->is_constant && !summary->has_jitter) found = 0;
+            if (found) {
+                g_cache_found++;
+                trace_span("get_file_data", "file", t_trace, timing_path, 1, summary->count, -1);
+                return;
+            }
+        }
+    }
+
+    // Cache miss, process text file
+    if (!g_no_cache) PROF_COUNT(cache_misses, 1);
+    summary->is_constant = 0;
+    summary->count = 0;
+    summary->timestamps = NULL;
+    summary->start = 0;
+    summary->end = 0;
+    summary->has_jitter = 0;
+    summary->dt_std = summary->dt_min = summary->dt_max = 0.0;
+
+    double t_parse_start = 0;
+    if (g_profile) t_parse_start = get_current_time();
+
+    int probed = 0;
+    long bytes = 0; // not counted for probes
+    if (timing_probe_applies(timing_path)) {
+        PROF_COUNT(timing_probes, 1);
+        probed = probe_timing_file(timing_path, summary);
+        if (!probed) PROF_COUNT(timing_probe_fallbacks, 1);
+    }
+    if (probed) {
+        if (g_profile) {
+            double dt = get_current_time() - t_parse_start;
+            g_prof.file_parse_time += dt;
+            prof_hist_add(g_prof.parse_hist, dt);
+        }
+    } else {
+        bytes = parse_timing_file(timing_path, summary, t_parse_start);
+        if (bytes < 0) return;
+    }
+
+    // Write cache
+    if (!g_no_cache) {
+        if (g_use_binary_cache) {
+            // Add to binary cache
+            const char *key = binary_cache_key(filepath);
+            double t_write = 0;
+            if (g_profile) t_write = get_current_time();
+            if (stale_entry) {
+                *stale_entry = *summary;
+                if (summary->timestamps) {
+                    stale_entry->timestamps = malloc(summary->count * sizeof(double));
+                    memcpy(stale_entry->timestamps, summary->timestamps, summary->count * sizeof(double));
+                }
+                g_binary_cache->dirty = 1;
+            } else {
+                add_to_binary_cache(key, summary);
+            }
+            // Note: g_cache_created is incremented when FLUSHING binary cache, not here.
+            // But user might want to see count of files added?
+            // "created" implies files. For binary cache, we create 1 file per night.
+            // So we increment in flush_binary_cache.
+            if (g_profile) g_prof.cache_write_time += (get_current_time() - t_write);
+        } else {
+            if (g_cache_export) {
+                if (dir_sep) {
+                    char dir_path[4096];
+                    size_t dir_len = dir_sep - filepath;
+                    if (dir_len >= sizeof(dir_path)) dir_len = sizeof(dir_path) - 1;
+                    strncpy(dir_path, filepath, dir_len);
+                    dir_path[dir_len] = '\0';
+                    ensure_cache_dir_exists(dir_path);
+                } else {
+                    ensure_cache_dir_exists(".");
+                }
+                double t_write = 0;
+                if (g_profile) t_write = get_current_time();
+                write_cache(export_cache_path, summary);
+                if (g_profile) g_prof.cache_write_time += (get_current_time() - t_write);
+            } else {
+                ensure_path_exists(local_cache_path);
+                double t_write = 0;
+                if (g_profile) t_write = get_current_time();
+                write_cache(local_cache_path, summary);
+                if (g_profile) g_prof.cache_write_time += (get_current_time() - t_write);
+            }
+            g_cache_created++;
+        }
+    }
+    trace_span("get_file_data", "file", t_trace, timing_path, g_no_cache ? -1 : 0, summary->count, bytes);
+}
+
+// pass 0 = count frames and populate file list, pass 1 = binning and headers (using cached files)
+void scan_stream_dir(const char *path, const char *stream_name, double tstart, double tend, StreamList *streams, int num_bins, int pass, long *file_count) {
+    if (pass != 0) return; // Only used for pass 0 now
+
+    if (!g_quiet) printf("Scanning %s\n", path);
+    double t_trace = trace_begin();
+    // Timing files of the stream, sorted by name; listing buffers are reused across streams
+    static DirList files;
+    int n = dir_list_read(&files, path, TIMING_SUFFIXES);
+    if (n < 0) return;
+
+    // Get date from path (parent directory name)
+    // path format: .../YYYYMMDD/stream_name
+    char *path_copy = strdup(path);
+    // Remove trailing slash if any
+    size_t p_len = strlen(path_copy);
+    if (p_len > 0 && path_copy[p_len-1] == '/') path_copy[p_len-1] = '\0';
+
+    char *last_slash = strrchr(path_copy, '/');
+    char date_str[32] = {0};
+    if (last_slash) {
+        *last_slash = '\0'; // Terminate at stream_name slash
+        char *parent_slash = strrchr(path_copy, '/');
+        if (parent_slash) {
+             strncpy(date_str, parent_slash + 1, 31);
+        } else {
+             strncpy(date_str, path_copy, 31); // No parent slash, so this is the date dir?
+        }
+    } else {
+        // Should not happen given the structure, but fallback
+        strncpy(date_str, "19700101", 31);
+    }
+    free(path_copy);
+
+    // Pre-calculate timestamps for filtering (date epoch + HH:MM:SS.ns from the filename)
+    double date_epoch = date_dir_epoch(date_str);
+    double *timestamps = malloc((n > 0 ? n : 1) * sizeof(double));
+    for (int i = 0; i < n; i++) {
+        const char *name = dir_list_name(&files, i);
+        timestamps[i] = filename_time_from_epoch(name, strlen(name), date_epoch);
+    }
+
+    // Select timing files in range, and read ahead the ones without a cached summary
+    char *selected = calloc(n > 0 ? n : 1, 1);
+    char **prefetch = malloc((n > 0 ? n : 1) * sizeof(char *));
+    int prefetch_count = 0;
+    int want_readahead = -1; // not when the stream's timing files can be probed
+    for (int i = 0; i < n; i++) {
+        // Optimization: Skip files outside range
+        // 1. If this file starts after tend (filenames sort chronologically within a stream)
+        if (timestamps[i] > tend) continue;
+
+        // 2. If next file starts before tstart, then this file ends before tstart
+        // (assuming contiguous or close files)
+        int skip = 0;
+        for (int k = i + 1; k < n; k++) {
+            if (timestamps[k] > 0.0) {
+                if (timestamps[k] < tstart) skip = 1;
+                break;
+            }
+        }
+        if (skip) continue;
+
+        selected[i] = 1;
+        if (g_readahead_depth > 0) {
+            char filepath[1024];
+            snprintf(filepath, sizeof(filepath), "%s/%s", path, dir_list_name(&files, i));
+            if (!summary_cache_exists(filepath)) {
+                if (want_readahead < 0) want_readahead = timing_readahead_wanted(filepath);
+                if (want_readahead) prefetch[prefetch_count++] = strdup(filepath);
+            }
+        }
+    }
+    g_readahead = readahead_create(prefetch, prefetch_count, g_readahead_depth);
+    for (int i = 0; i < prefetch_count; i++) free(prefetch[i]);
+    free(prefetch);
+
+    for (int i = 0; i < n; i++) {
+        if (!selected[i]) continue;
+        double file_ts = timestamps[i];
+
+        if (file_count) {
+            (*file_count)++;
+        }
+
+        char filepath[1024];
+        snprintf(filepath, sizeof(filepath), "%s/%s", path, dir_list_name(&files, i));
+
+        Stream *s = get_or_create_stream(streams, stream_name);
+        add_file_to_stream(s, filepath, file_ts);
+
+        // Pass 0: Count frames
+        FileSummary summary;
+        get_file_data(filepath, &summary);
+
+        // If constant, we can check overlap with [tstart, tend] analytically
+        if (summary.is_constant) {
+            if (summary.count > 0) {
+                // Check if file range overlaps with scan range
+                if (summary.end >= tstart && summary.start <= tend) {
+                    // Count frames inside [tstart, tend]
+                    // Assume linear distribution
+                    if (summary.start >= tstart && summary.end <= tend) {
+                        s->total_frames += summary.count;
+                    } else {
+                        // Partial overlap
+                         double dt = (summary.end - summary.start) / (summary.count > 1 ? summary.count - 1 : 1);
+                         if (dt > 0) {
+                             double first_t = summary.start;
+                             long start_idx = 0;
+                             if (first_t < tstart) {
+                                 start_idx = (long)ceil((tstart - first_t) / dt);
+                             }
+                             long end_idx = summary.count - 1;
+                             if (summary.end > tend) {
+                                 end_idx = (long)floor((tend - first_t) / dt);
+                             }
+                             if (start_idx <= end_idx) {
+                                 s->total_frames += (end_idx - start_idx + 1);
+                             }
+                         } else {
+                             // Single frame
+                             if (summary.start >= tstart && summary.start <= tend) s->total_frames++;
+                         }
+                    }
+                }
+            }
+        } else {
+            if (summary.timestamps) {
+                s->total_frames += raw_count_in_range(&summary, tstart, tend);
+                free(summary.timestamps);
+            }
+        }
+    }
+    readahead_destroy(g_readahead);
+    g_readahead = NULL;
+    free(selected);
+    free(timestamps);
+    trace_span("scan_stream_dir", "discovery", t_trace, path, -1, n, -1);
+}
+
+void interval_stats_add(IntervalStats *st, double dt) {
+    st->n++;
+    double delta = dt - st->mean;
+    st->mean += delta / st->n;
+    st->m2 += delta * (dt - st->mean);
+    if (st->n == 1 || dt < st->min) st->min = dt;
+    if (st->n == 1 || dt > st->max) st->max = dt;
+}
+
+// Merge n intervals of a constant-rate segment in one step: mean dt, standard deviation std
+// and range [min, max] (those of the whole file)
+void interval_stats_add_constant(IntervalStats *st, long n, double dt, double std, double min, double max) {
+    if (n <= 0) return;
+    double m2 = std * std * (n - 1);
+    if (st->n == 0) {
+        st->n = n;
+        st->mean = dt;
+        st->m2 = m2;
+        st->min = min;
+        st->max = max;
+        return;
+    }
+    long n_tot = st->n + n;
+    double delta = dt - st->mean;
+    st->mean += delta * n / n_tot;
+    st->m2 += m2 + delta * delta * ((double)st->n * n / n_tot);
+    st->n = n_tot;
+    if (min < st->min) st->min = min;
+    if (max > st->max) st->max = max;
+}
+
+double interval_stats_std(const IntervalStats *st) {
+    if (st->n < 2) return 0.0;
+    return sqrt(st->m2 / (st->n - 1));
+}
+
+int time_to_bin(double timestamp, double tstart, double tend, int num_bins) {
+    int bin = (int)((timestamp - tstart) / (tend - tstart) * num_bins);
+    if (bin < 0) bin = 0;
+    if (bin >= num_bins) bin = num_bins - 1;
+    return bin;
+}
+
+// Interval statistics for frames [start_idx, end_idx] of a constant-rate file. Intervals
+// inside the file are taken as their mean dt with the jitter of the file, so each bin
+// receives one grouped update.
+void accumulate_constant_intervals(Stream *s, const FileSummary *summary, long start_idx, long end_idx,
+                                   double dt, double tstart, double tend, int num_bins) {
+    double first_t = summary->start;
+    if (start_idx == 0 && s->rate_last_ts > 0.0 && first_t > s->rate_last_ts &&
+        first_t - s->rate_last_ts < RATE_MAX_GAP_FRAMES * dt) {
+        interval_stats_add(&s->interval_stats[time_to_bin(first_t, tstart, tend, num_bins)], first_t - s->rate_last_ts);
+    }
+
+    long k = (start_idx < 1) ? 1 : start_idx;
+    double bin_width = (tend - tstart) / num_bins;
+    while (k <= end_idx) {
+        int bin = time_to_bin(first_t + k * dt, tstart, tend, num_bins);
+        long k_last = end_idx;
+        if (bin < num_bins - 1) {
+            double t_edge = tstart + (bin + 1) * bin_width;
+            k_last = (long)ceil((t_edge - first_t) / dt) - 1;
+            if (k_last < k) k_last = k;
+            if (k_last > end_idx) k_last = end_idx;
+        }
+        if (summary->has_jitter) {
+            interval_stats_add_constant(&s->interval_stats[bin], k_last - k + 1, dt, summary->dt_std,
+                                        summary->dt_min, summary->dt_max);
+        } else {
+            interval_stats_add_constant(&s->interval_stats[bin], k_last - k + 1, dt, 0.0, dt, dt);
+        }
+        k = k_last + 1;
+    }
+    s->rate_last_ts = summary->end;
+}
+
+void accumulate_raw_intervals(Stream *s, const FileSummary *summary, double tstart, double tend, int num_bins) {
+    double prev = s->rate_last_ts;
+    if (summary->count > 1 && summary->timestamps[0] - prev >= RATE_MAX_GAP_FRAMES * (summary->timestamps[1] - summary->timestamps[0])) {
+        prev = -1.0;
+    }
+    for (long k = 0; k < summary->count; k++) {
+        double timestamp = summary->timestamps[k];
+        if (timestamp >= tstart && timestamp <= tend && prev > 0.0 && timestamp > prev) {
+            interval_stats_add(&s->interval_stats[time_to_bin(timestamp, tstart, tend, num_bins)], timestamp - prev);
+        }
+        prev = timestamp;
+    }
+    s->rate_last_ts = prev;
+}
+
+void accumulate_intervals(Stream *s, const FileSummary *summary, double tstart, double tend, int num_bins) {
+    if (!summary->is_constant) {
+        if (summary->timestamps) accumulate_raw_intervals(s, summary, tstart, tend, num_bins);
+        return;
+    }
+    long start_idx = 0, end_idx = -1;
+    if (!summary_frame_range(summary, tstart, tend, &start_idx, &end_idx)) return;
+    double dt = (summary->end - summary->start) / (summary->count > 1 ? summary->count - 1 : 1);
+    if (dt > 0) {
+        accumulate_constant_intervals(s, summary, start_idx, end_idx, dt, tstart, tend, num_bins);
+    } else {
+        // No interval reference within a single-frame file: start a new sequence
+        s->rate_last_ts = summary->start;
+    }
+}
+
+void bin_add(int *bins, int *max_bin_count, int bin) {
+    bins[bin]++;
+    if (bins[bin] > *max_bin_count) {
+        *max_bin_count = bins[bin];
+    }
+}
+
+// RAW binning kernel. The in-range slice of sorted timestamps is found by binary search;
+// bin indices are computed in blocks by a branch-free loop the compiler vectorizes
+// (SIMD_CLONES: AVX-512 / AVX2 / baseline selected at load time). Indices of a sorted
+// block are nondecreasing and are counted run by run. Unsorted arrays (clock glitches)
+// take the whole array, frames out of range going to a discarded slot, and are counted
+// into RAW_HIST_COPIES interleaved sub-histograms, so that consecutive frames falling in
+// the same bin do not serialize on one counter.
+#define RAW_BIN_BLOCK 256
+#define RAW_HIST_COPIES 4
+#define RAW_HIST_STACK_BINS 512
+
+SIMD_CLONES
+int timestamps_sorted(const double *t, long n) {
+    int unsorted = 0;
+    for (long k = 1; k < n; k++) unsorted |= t[k] < t[k - 1];
+    return !unsorted;
+}
+
+// Bin of each of t[0..n-1] minus b0, as time_to_bin; frames out of [tstart, tend] get skip
+SIMD_CLONES
+void raw_bin_indices(const double *t, long n, double tstart, double tend, int num_bins, int b0, int skip, int *idx) {
+    double range = tend - tstart;
+    for (long k = 0; k < n; k++) {
+        int bin = (int)((t[k] - tstart) / range * num_bins);
+        bin = bin < 0 ? 0 : bin;
+        bin = bin >= num_bins ? num_bins - 1 : bin;
+        idx[k] = (t[k] >= tstart && t[k] <= tend) ? bin - b0 : skip;
+    }
+}
+
+// Adds the frames of t[0..n-1] within [tstart, tend] to bins, updating *max_bin_count.
+// Returns the number of frames binned.
+long bin_raw_timestamps(const double *t, long n, double tstart, double tend, int num_bins, int *bins, int *max_bin_count) {
+    long first = 0, last = n - 1;
+    int b0 = 0, b1 = num_bins - 1;
+    int sorted = timestamps_sorted(t, n);
+    if (sorted) {
+        FileSummary slice = {.is_constant = 0, .count = n, .start = n > 0 ? t[0] : 0.0, .end = n > 0 ? t[n - 1] : 0.0,
+                             .timestamps = (double *)t};
+        if (!summary_frame_range(&slice, tstart, tend, &first, &last)) return 0;
+        b0 = time_to_bin(t[first], tstart, tend, num_bins);
+        b1 = time_to_bin(t[last], tstart, tend, num_bins);
+    } else if (n <= 0) {
+        return 0;
+    }
+    int span = b1 - b0 + 1;
+    int stack_hist[RAW_HIST_COPIES * (RAW_HIST_STACK_BINS + 1)];
+    int *hist = stack_hist;
+    size_t hist_len = (size_t)RAW_HIST_COPIES * (span + 1); // + the out-of-range slot
+    if (span > RAW_HIST_STACK_BINS) hist = malloc(hist_len * sizeof(int));
+    memset(hist, 0, hist_len * sizeof(int));
+
+    int idx[RAW_BIN_BLOCK];
+    for (long k0 = first; k0 <= last; k0 += RAW_BIN_BLOCK) {
+        long nk = last - k0 + 1 < RAW_BIN_BLOCK ? last - k0 + 1 : RAW_BIN_BLOCK;
+        raw_bin_indices(t + k0, nk, tstart, tend, num_bins, b0, span, idx);
+        if (sorted) {
+            for (long k = 0; k < nk;) {
+                long lo = k + 1, hi = nk; // end of the run of idx[k]
+                while (lo < hi) {
+                    long mid = lo + (hi - lo) / 2;
+                    if (idx[mid] == idx[k]) lo = mid + 1; else hi = mid;
+                }
+                hist[idx[k]] += (int)(lo - k);
+                k = lo;
+            }
+            continue;
+        }
+        long k = 0;
+        for (; k + RAW_HIST_COPIES <= nk; k += RAW_HIST_COPIES) {
+            for (int j = 0; j < RAW_HIST_COPIES; j++) hist[j * (span + 1) + idx[k + j]]++;
+        }
+        for (; k < nk; k++) hist[idx[k]]++;
+    }
+
+    long total = 0;
+    for (int b = 0; b < span; b++) {
+        int c = 0;
+        for (int j = 0; j < RAW_HIST_COPIES; j++) c += hist[j * (span + 1) + b];
+        if (c == 0) continue;
+        total += c;
+        bins[b0 + b] += c;
+        if (bins[b0 + b] > *max_bin_count) *max_bin_count = bins[b0 + b];
+    }
+    if (hist != stack_hist) free(hist);
+    return total;
+}
+
+// Number of frames of a RAW summary within [tstart, tend]
+long raw_count_in_range(const FileSummary *summary, double tstart, double tend) {
+    long first, last;
+    const double *t = summary->timestamps;
+    if (timestamps_sorted(t, summary->count)) {
+        return summary_frame_range(summary, tstart, tend, &first, &last) ? last - first + 1 : 0;
+    }
+    long n = 0;
+    for (long k = 0; k < summary->count; k++) n += (t[k] >= tstart && t[k] <= tend);
+    return n;
+}
+
+// Histogram of the frames of one file within [tstart, tend] over num_bins timeline bins
+void bin_summary(const FileSummary *summary, double tstart, double tend, int num_bins, int *bins, int *max_bin_count) {
+    if (summary->is_constant) {
+        if (summary->count > 0 && summary->end >= tstart && summary->start <= tend) {
+            double dt = (summary->end - summary->start) / (summary->count > 1 ? summary->count - 1 : 1);
+            if (dt > 0) {
+                double first_t = summary->start;
+                long start_idx = 0;
+                if (first_t < tstart) {
+                    start_idx = (long)ceil((tstart - first_t) / dt);
+                }
+                long end_idx = summary->count - 1;
+                if (summary->end > tend) {
+                    end_idx = (long)floor((tend - first_t) / dt);
+                }
+                for (long k = start_idx; k <= end_idx; k++) {
+                    bin_add(bins, max_bin_count, time_to_bin(first_t + k * dt, tstart, tend, num_bins));
+                }
+            } else {
+                // Single frame
+                if (summary->start >= tstart && summary->start <= tend) {
+                    bin_add(bins, max_bin_count, time_to_bin(summary->start, tstart, tend, num_bins));
+                }
+            }
+        }
+    } else if (summary->timestamps) {
+        bin_raw_timestamps(summary->timestamps, summary->count, tstart, tend, num_bins, bins, max_bin_count);
+    }
+}
+
+// Sidecar header of a timing file: <name>.txt[.gz|.zst] -> <name>.fits.header
+void header_sidecar_path(const char *timing_path, char *out, size_t size) {
+    snprintf(out, size, "%.*s.fits.header", (int)timing_stem_len(timing_path), timing_path);
+}
+
+// Cube of a timing file: <name>.fits, or <name>.fits.fz. Returns 0 (out empty) if neither exists.
+int fits_cube_path(const char *timing_path, char *out, size_t size) {
+    snprintf(out, size, "%.*s.fits", (int)timing_stem_len(timing_path), timing_path);
+    PROF_COUNT(stat_calls, 1);
+    if (access(out, R_OK) == 0) return 1;
+    strncat(out, ".fz", size - strlen(out) - 1);
+    PROF_COUNT(stat_calls, 1);
+    if (access(out, R_OK) == 0) return 1;
+    out[0] = '\0';
+    return 0;
+}
+
+// First acquisition time (col5) of a timing file; returns 0 if it cannot be opened
+int timing_first_timestamp(const char *filepath, double *file_ts) {
+    *file_ts = 0.0;
+    FILE *fp = timing_fopen(filepath);
+    if (!fp) return 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        char *save = NULL;
+        char *token = strtok_r(line, " \t", &save);
+        int col = 0;
+        while (token) {
+            if (col == 4) { *file_ts = atof(token); break; }
+            token = strtok_r(NULL, " \t", &save);
+            col++;
+        }
+        if (*file_ts > 0) break;
+    }
+    timing_fclose(fp);
+    return 1;
+}
+
+typedef struct {
+    double file_ts;
+    int in_range;
+    char filename[256]; // header source reported for this file
+    HeaderCards cards;
+} HeaderJob;
+
+typedef struct {
+    Stream *s;
+    double tstart;
+    double tend;
+    HeaderJob *jobs;
+    int njobs;
+    int next;
+    Readahead *ra; // sidecars read ahead (single worker only)
+} HeaderWork;
+
+void *header_worker(void *arg) {
+    HeaderWork *w = (HeaderWork *)arg;
+    for (;;) {
+        int j = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (j >= w->njobs) break;
+        HeaderJob *job = &w->jobs[j];
+        const char *filepath = w->s->files[j].path;
+
+        char headerpath[1024];
+        header_sidecar_path(filepath, headerpath, sizeof(headerpath));
+
+        // Fall back to the cube itself when the sidecar header is missing
+        char fitspath[1024];
+        fitspath[0] = '\0';
+        PROF_COUNT(stat_calls, 1);
+        if (access(headerpath, R_OK) != 0) fits_cube_path(filepath, fitspath, sizeof(fitspath));
+
+        if (!timing_first_timestamp(filepath, &job->file_ts)) continue;
+        if (job->file_ts < w->tstart || job->file_ts > w->tend) continue;
+        job->in_range = 1;
+        const char *source = fitspath[0] != '\0' ? fitspath : headerpath;
+        const char *base = strrchr(source, '/');
+        snprintf(job->filename, sizeof(job->filename), "%s", base ? base + 1 : source);
+
+        double t_trace = trace_begin();
+        if (fitspath[0] != '\0') {
+            fits_header_cards(fitspath, &job->cards);
+        } else {
+            read_header_cards(headerpath, w->ra, &job->cards);
+        }
+        trace_span("header_scan", "header", t_trace, source, -1, -1, -1);
+    }
+    return NULL;
+}
+
+// -k scan of stream s: headers are read and matched by parallel workers, then the
+// matching values are tracked sequentially in file order, so that the report is the
+// same as that of a sequential scan
+void scan_stream_headers(Stream *s, double tstart, double tend) {
+    HeaderWork work;
+    work.s = s;
+    work.tstart = tstart;
+    work.tend = tend;
+    work.jobs = calloc(s->file_count > 0 ? s->file_count : 1, sizeof(HeaderJob));
+    work.njobs = s->file_count;
+    work.next = 0;
+    work.ra = NULL;
+
+    int nthreads = get_num_threads();
+    if (nthreads > work.njobs) nthreads = work.njobs;
+    if (nthreads <= 1) {
+        if (g_readahead_depth > 0 && s->file_count > 0) {
+            char **prefetch = malloc(s->file_count * sizeof(char *));
+            for (int j = 0; j < s->file_count; j++) {
+                char headerpath[1024];
+                header_sidecar_path(s->files[j].path, headerpath, sizeof(headerpath));
+                prefetch[j] = strdup(headerpath);
+            }
+            work.ra = readahead_create(prefetch, s->file_count, g_readahead_depth);
+            for (int j = 0; j < s->file_count; j++) free(prefetch[j]);
+            free(prefetch);
+        }
+        header_worker(&work);
+        readahead_destroy(work.ra);
+    } else {
+        pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+        for (int t = 0; t < nthreads; t++) pthread_create(&threads[t], NULL, header_worker, &work);
+        for (int t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+        free(threads);
+    }
+
+    for (int j = 0; j < work.njobs; j++) {
+        HeaderJob *job = &work.jobs[j];
+        if (job->in_range) reduce_header_cards(&job->cards, job->filename, s->name, job->file_ts);
+        header_cards_free(&job->cards);
+    }
+    free(work.jobs);
+}
+
+void process_stream_data(StreamList *stream_list, double tstart, double tend, int num_bins) {
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+
+        int scan_headers = (kscan_ctx.target_key_pattern[0] != '\0');
+        if (kscan_ctx.target_stream[0] != '\0' && strcmp(s->name, kscan_ctx.target_stream) != 0) {
+            scan_headers = 0;
+        }
+        if (scan_headers) scan_stream_headers(s, tstart, tend);
+
+        // Read ahead uncached timing files, in the order they are binned below
+        if (g_readahead_depth > 0 && s->file_count > 0) {
+            char **prefetch = malloc(s->file_count * sizeof(char *));
+            int prefetch_count = 0;
+            int want_readahead = -1;
+            for (int j = 0; j < s->file_count; j++) {
+                if (summary_cache_exists(s->files[j].path)) continue;
+                if (want_readahead < 0) want_readahead = timing_readahead_wanted(s->files[j].path);
+                if (!want_readahead) break;
+                prefetch[prefetch_count++] = strdup(s->files[j].path);
+            }
+            g_readahead = readahead_create(prefetch, prefetch_count, g_readahead_depth);
+            for (int j = 0; j < prefetch_count; j++) free(prefetch[j]);
+            free(prefetch);
+        }
+
+        for (int j = 0; j < s->file_count; j++) {
+            char *filepath = s->files[j].path;
+            FileSummary summary;
+            get_file_data(filepath, &summary);
+            bin_summary(&summary, tstart, tend, num_bins, s->bins, &s->max_bin_count);
+            if (s->interval_stats) {
+                accumulate_intervals(s, &summary, tstart, tend, num_bins);
+            }
+            if (s->latency) {
+                accumulate_latency(s, filepath, &summary, tstart, tend, num_bins);
+            }
+            if (summary.timestamps) free(summary.timestamps);
+        }
+        readahead_destroy(g_readahead);
+        g_readahead = NULL;
+    }
+}
+
+void get_date_bounds(const char *root_dir, const char *date_str, double *t_min, double *t_max) {
+    char date_path[1024];
+    snprintf(date_path, sizeof(date_path), "%s/%s", root_dir, date_str);
+
+    *t_min = -1.0;
+    *t_max = -1.0;
+
+    DirList streams;
+    DirList files;
+    dir_list_init(&streams);
+    dir_list_init(&files);
+    int n_stream = dir_list_read(&streams, date_path, NULL);
+
+    for (int i = 0; i < n_stream; i++) {
+        char stream_path[2048];
+        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, dir_list_name(&streams, i));
+
+        if (dir_list_is_dir(&streams, i, date_path)) {
+            int n_files = dir_list_read(&files, stream_path, TIMING_SUFFIXES);
+            if (n_files >= 0) {
+                for (int j = 0; j < n_files; j++) {
+                    char filepath[4096];
+                    snprintf(filepath, sizeof(filepath), "%s/%s", stream_path, dir_list_name(&files, j));
+                    FileSummary probe;
+                    if (timing_probe_applies(filepath) && probe_timing_file(filepath, &probe)) {
+                        if (*t_min < 0 || probe.start < *t_min) *t_min = probe.start;
+                        if (*t_max < 0 || probe.end > *t_max) *t_max = probe.end;
+                        continue;
+                    }
+                    FILE *fp = timing_fopen(filepath);
+                    if (fp) {
+                        char line[1024];
+                        while (fgets(line, sizeof(line), fp)) {
+                            if (line[0] == '#') continue;
+                            char *token = strtok(line, " \t");
+                            int col = 0;
+                            double ts = 0.0;
+                            int found = 0;
+                            while (token) {
+                                if (col == 4) { ts = atof(token); found = 1; break; }
+                                token = strtok(NULL, " \t");
+                                col++;
+                            }
+                            if (found && ts > 0.0) {
+                                if (*t_min < 0 || ts < *t_min) *t_min = ts;
+                                if (*t_max < 0 || ts > *t_max) *t_max = ts;
+                            }
+                        }
+                        timing_fclose(fp);
+                    }
+                }
+            }
+        }
+    }
+    dir_list_free(&files);
+    dir_list_free(&streams);
+}
+
+void process_all_dates(const char *root_dir, double tstart, double tend, StreamList *stream_list, int timeline_width, int pass, long *file_count) {
+    time_t current_t = (time_t)tstart;
+    time_t end_t = (time_t)tend;
+
+    struct tm start_tm_struct;
+    gmtime_r(&current_t, &start_tm_struct);
+    start_tm_struct.tm_hour = 0; start_tm_struct.tm_min = 0; start_tm_struct.tm_sec = 0;
+    time_t iter_t = timegm(&start_tm_struct);
+
+    struct tm end_tm_struct;
+    gmtime_r(&end_t, &end_tm_struct);
+    end_tm_struct.tm_hour = 0; end_tm_struct.tm_min = 0; end_tm_struct.tm_sec = 0;
+    time_t end_iter_t = timegm(&end_tm_struct);
+
+    DirList streams;
+    dir_list_init(&streams);
+    for (time_t t = iter_t; t <= end_iter_t + 10; t += 86400) {
+        if (t > end_iter_t) break;
+        struct tm tm_date;
+        gmtime_r(&t, &tm_date);
+        char date_str[32];
+        snprintf(date_str, sizeof(date_str), "%04d%02d%02d",
+                 tm_date.tm_year + 1900, tm_date.tm_mon + 1, tm_date.tm_mday);
+
+        char date_path[1024];
+        snprintf(date_path, sizeof(date_path), "%s/%s", root_dir, date_str);
+
+        // Stream directories; d_type avoids a stat per entry
+        double t_trace = trace_begin();
+        int n_stream = dir_list_read(&streams, date_path, NULL);
+        for (int i = 0; i < n_stream; i++) {
+            const char *name = dir_list_name(&streams, i);
+            char stream_path[2048];
+            snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, name);
+            if (stream_selected(name) && dir_list_is_dir(&streams, i, date_path)) {
+                scan_stream_dir(stream_path, name, tstart, tend, stream_list, timeline_width, pass, file_count);
+            }
+        }
+        if (n_stream >= 0) trace_span("scan_date", "discovery", t_trace, date_path, -1, n_stream, -1);
+    }
+    dir_list_free(&streams);
+}
+
+// Index range [*first, *last] of the frames of a file within [tstart, tend].
+// Analytic for constant-rate summaries, binary search for RAW ones. Returns 0 if empty.
+int summary_frame_range(const FileSummary *summary, double tstart, double tend, long *first, long *last) {
+    if (summary->count <= 0 || summary->end < tstart || summary->start > tend) return 0;
+
+    if (summary->is_constant) {
+        double dt = (summary->end - summary->start) / (summary->count > 1 ? summary->count - 1 : 1);
+        if (dt <= 0) {
+            *first = 0;
+            *last = 0;
+            return 1;
+        }
+        *first = 0;
+        if (summary->start < tstart) *first = (long)ceil((tstart - summary->start) / dt);
+        *last = summary->count - 1;
+        if (summary->end > tend) *last = (long)floor((tend - summary->start) / dt);
+        if (*last > summary->count - 1) *last = summary->count - 1;
+        return *first <= *last;
+    }
+
+    if (!summary->timestamps) return 0;
+    long lo = 0, hi = summary->count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (summary->timestamps[mid] < tstart) lo = mid + 1; else hi = mid;
+    }
+    *first = lo;
+    hi = summary->count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (summary->timestamps[mid] <= tend) lo = mid + 1; else hi = mid;
+    }
+    *last = lo - 1;
+    return *first <= *last;
+}
+
+// Copy len bytes between files in kernel space (copy_file_range, then sendfile, then read/write)
+int copy_file_bytes(int fd_in, off_t off_in, int fd_out, off_t off_out, size_t len) {
+    while (len > 0) {
+        loff_t in = off_in, out = off_out;
+        ssize_t n = copy_file_range(fd_in, &in, fd_out, &out, len, 0);
+        if (n <= 0) break;
+        off_in += n; off_out += n; len -= n;
+    }
+    if (len > 0) {
+        if (lseek(fd_out, off_out, SEEK_SET) < 0) return -1;
+        while (len > 0) {
+            ssize_t n = sendfile(fd_out, fd_in, &off_in, len);
+            if (n <= 0) break;
+            off_out += n; len -= n;
+        }
+    }
+    if (len > 0) {
+        char buf[1 << 16];
+        while (len > 0) {
+            ssize_t n = pread(fd_in, buf, len < sizeof(buf) ? len : sizeof(buf), off_in);
+            if (n <= 0) return -1;
+            if (pwrite(fd_out, buf, n, off_out) != n) return -1;
+            off_in += n; off_out += n; len -= n;
+        }
+    }
+    return 0;
+}
+
+// Append data lines [first, last] of a timing file to out, renumbering col1 and
+// recomputing col3 relative to the first extracted frame (*origin, set on first call).
+long append_timing_lines(FILE *out, const char *timing_path, long first, long last, long *out_index, double *origin) {
+    FILE *fp = timing_fopen(timing_path);
+    if (!fp) return -1;
+    char line[1024];
+    long k = 0, written = 0;
+    while (k <= last && fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        char *tok[7];
+        int ntok = 0;
+        char *token = strtok(line, " \t\n");
+        while (token && ntok < 7) {
+            tok[ntok++] = token;
+            token = strtok(NULL, " \t\n");
+        }
+        if (ntok < 5) continue;
+        if (k >= first) {
+            double t_log = atof(tok[3]);
+            if (*origin < 0) *origin = t_log;
+            fprintf(out, TIMING_LINE_FORMAT, *out_index, tok[1], t_log - *origin, tok[3], tok[4],
+                    ntok > 5 ? tok[5] : "0", ntok > 6 ? tok[6] : "0");
+            (*out_index)++;
+            written++;
+        }
+        k++;
+    }
+    timing_fclose(fp);
+    return written;
+}
+
+typedef struct {
+    char fits_path[1024];
+    char timing_path[1024];
+    long first;
+    long last;
+    long data_offset;
+} ExtractSlice;
+
+// Write frames of stream s within [tstart, tend] to a single FITS cube and matching timing file
+int extract_subcube(Stream *s, double tstart, double tend, const char *out_path) {
+    double t0 = get_current_time();
+    ExtractSlice *slices = calloc(s->file_count > 0 ? s->file_count : 1, sizeof(ExtractSlice));
+    int nslices = 0;
+    char *ref_cards = NULL;
+    int ref_ncards = 0;
+    long bitpix = 0, naxis1 = 0, naxis2 = 0;
+    long total_frames = 0;
+    int ret = 1;
+
+    for (int j = 0; j < s->file_count; j++) {
+        const char *filepath = s->files[j].path;
+        FileSummary summary;
+        get_file_data(filepath, &summary);
+        long first = 0, last = -1;
+        int has_frames = summary_frame_range(&summary, tstart, tend, &first, &last);
+        if (summary.timestamps) free(summary.timestamps);
+        if (!has_frames) continue;
+
+        ExtractSlice *sl = &slices[nslices];
+        strncpy(sl->timing_path, filepath, sizeof(sl->timing_path) - 1);
+        snprintf(sl->fits_path, sizeof(sl->fits_path), "%.*s.fits", (int)timing_stem_len(filepath), filepath);
+        if (access(sl->fits_path, R_OK) != 0) {
+            fprintf(stderr, "Error: %s not found (compressed .fits.fz cubes cannot be extracted)\n", sl->fits_path);
+            goto done;
+        }
+
+        int fd = open(sl->fits_path, O_RDONLY);
+        int ncards = 0;
+        long header_bytes = 0;
+        char *cards = (fd >= 0) ? read_fits_header_at(fd, 0, &ncards, &header_bytes) : NULL;
+        struct stat st;
+        int stat_ok = (fd >= 0 && fstat(fd, &st) == 0);
+        if (fd >= 0) close(fd);
+        long f_bitpix = 0, f_naxis1 = 0, f_naxis2 = 0, f_naxis3 = 0;
+        if (!cards || !stat_ok ||
+            !fits_cards_get_long(cards, ncards, "BITPIX", &f_bitpix) ||
+            !fits_cards_get_long(cards, ncards, "NAXIS1", &f_naxis1) ||
+            !fits_cards_get_long(cards, ncards, "NAXIS2", &f_naxis2) ||
+            !fits_cards_get_long(cards, ncards, "NAXIS3", &f_naxis3)) {
+            fprintf(stderr, "Error: Cannot read 3D FITS header of %s\n", sl->fits_path);
+            free(cards);
+            goto done;
+        }
+        if (!ref_cards) {
+            ref_cards = cards;
+            ref_ncards = ncards;
+            bitpix = f_bitpix; naxis1 = f_naxis1; naxis2 = f_naxis2;
+        } else {
+            free(cards);
+            if (f_bitpix != bitpix || f_naxis1 != naxis1 || f_naxis2 != naxis2) {
+                fprintf(stderr, "Error: %s has a different frame format (BITPIX/NAXIS1/NAXIS2)\n", sl->fits_path);
+                goto done;
+            }
+        }
+        long frame_bytes = labs(bitpix) / 8 * naxis1 * naxis2;
+        if (last >= f_naxis3 || (long)st.st_size < header_bytes + (last + 1) * frame_bytes) {
+            fprintf(stderr, "Error: %s is shorter than its timing file\n", sl->fits_path);
+            goto done;
+        }
+        sl->first = first;
+        sl->last = last;
+        sl->data_offset = header_bytes;
+        total_frames += last - first + 1;
+        nslices++;
+    }
+
+    if (nslices == 0) {
+        fprintf(stderr, "Error: No frames of stream %s in range\n", s->name);
+        goto done;
+    }
+
+    // Output header: reference header with combined NAXIS3
+    size_t hdr_len = ((size_t)(ref_ncards + 1) * FITS_CARD_SIZE + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE;
+    char *hdr = malloc(hdr_len);
+    memset(hdr, ' ', hdr_len);
+    memcpy(hdr, ref_cards, (size_t)ref_ncards * FITS_CARD_SIZE);
+    for (int c = 0; c < ref_ncards; c++) {
+        char *card = hdr + (size_t)c * FITS_CARD_SIZE;
+        if (strncmp(card, "NAXIS3  =", 9) == 0) {
+            char buf[FITS_CARD_SIZE + 1];
+            snprintf(buf, sizeof(buf), "%-8s= %20ld / length of data axis 3", "NAXIS3", total_frames);
+            memset(card, ' ', FITS_CARD_SIZE);
+            memcpy(card, buf, strlen(buf));
+        }
+    }
+    memcpy(hdr + (size_t)ref_ncards * FITS_CARD_SIZE, "END", 3);
+
+    int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: Cannot create %s: %s\n", out_path, strerror(errno));
+        free(hdr);
+        goto done;
+    }
+    if (write(out_fd, hdr, hdr_len) != (ssize_t)hdr_len) {
+        fprintf(stderr, "Error: Failed to write %s: %s\n", out_path, strerror(errno));
+        free(hdr);
+        close(out_fd);
+        goto done;
+    }
+    free(hdr);
+
+    char timing_out[4096];
+    size_t olen = strlen(out_path);
+    if (olen > 5 && strcmp(out_path + olen - 5, ".fits") == 0) {
+        snprintf(timing_out, sizeof(timing_out), "%.*s.txt", (int)(olen - 5), out_path);
+    } else {
+        snprintf(timing_out, sizeof(timing_out), "%s.txt", out_path);
+    }
+    FILE *tfp = fopen(timing_out, "w");
+    if (!tfp) {
+        fprintf(stderr, "Error: Cannot create %s: %s\n", timing_out, strerror(errno));
+        close(out_fd);
+        goto done;
+    }
+    fprintf(tfp, "# Telemetry stream timing data \n");
+    fprintf(tfp, "# Extracted from stream %s by milk-streamtelemetry-scan\n", s->name);
+    fprintf(tfp, "# \n# col1 : datacube frame index\n# col2 : Main index\n");
+    fprintf(tfp, "# col3 : Time since cube origin (logging)\n# col4 : Absolute time (logging)\n");
+    fprintf(tfp, "# col5 : Absolute time (acquisition)\n# col6 : stream cnt0 index\n# col7 : stream cnt1 index\n# \n");
+
+    long frame_bytes = labs(bitpix) / 8 * naxis1 * naxis2;
+    off_t out_off = hdr_len;
+    long out_index = 0;
+    double origin = -1.0;
+    for (int i = 0; i < nslices; i++) {
+        ExtractSlice *sl = &slices[i];
+        long nframes = sl->last - sl->first + 1;
+        int in_fd = open(sl->fits_path, O_RDONLY);
+        if (in_fd < 0 || copy_file_bytes(in_fd, sl->data_offset + sl->first * frame_bytes, out_fd, out_off, (size_t)nframes * frame_bytes) != 0) {
+            fprintf(stderr, "Error: Failed to copy frames from %s\n", sl->fits_path);
+            if (in_fd >= 0) close(in_fd);
+            fclose(tfp);
+            close(out_fd);
+            goto done;
+        }
+        close(in_fd);
+        out_off += (off_t)nframes * frame_bytes;
+        if (append_timing_lines(tfp, sl->timing_path, sl->first, sl->last, &out_index, &origin) != nframes) {
+            fprintf(stderr, "Warning: Timing lines of %s do not match frame count\n", sl->timing_path);
+        }
+        printf("  %s  frames %ld-%ld (%ld)\n", sl->fits_path, sl->first, sl->last, nframes);
+    }
+    fclose(tfp);
+
+    // Zero padding to a whole FITS block
+    off_t padded = (out_off + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE;
+    if (ftruncate(out_fd, padded) != 0) {
+        fprintf(stderr, "Warning: Failed to pad %s: %s\n", out_path, strerror(errno));
+    }
+    close(out_fd);
+
+    double elapsed = get_current_time() - t0;
+    double mbytes = (double)(out_off - hdr_len) / 1e6;
+    printf("\nExtracted %ld frames of %s from %d files to %s (%.1f MB, %.3f s, %.1f MB/s)\n",
+           total_frames, s->name, nslices, out_path, mbytes, elapsed, elapsed > 0 ? mbytes / elapsed : 0.0);
+    printf("Timing: %s\n", timing_out);
+    ret = 0;
+
+done:
+    free(ref_cards);
+    free(slices);
+    return ret;
+}
+
+// Frame-range manifest (--manifest): for every file of every stream with frames in
+// [tstart, tend], its cube and timing paths, the range of frame (cube slice) indices in range,
+// and their first and last timestamps. Ranges come from the summaries (analytic for
+// constant-rate files, binary search for RAW ones), so no timing file is parsed when cached.
+int write_manifest(StreamList *stream_list, double tstart, double tend, const char *out_path) {
+    int to_stdout = strcmp(out_path, "-") == 0;
+    FILE *fp = to_stdout ? stdout : fopen(out_path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write manifest %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+    fprintf(fp, "# stream\tfits\ttiming\tfirst\tlast\tnframes\ttfirst\ttlast\n");
+    long nfiles = 0, nframes = 0;
+    for (int i = 0; i < stream_list->count; i++) {
+        Stream *s = &stream_list->streams[i];
+        for (int j = 0; j < s->file_count; j++) {
+            const char *filepath = s->files[j].path;
+            FileSummary summary;
+            get_file_data(filepath, &summary);
+            long first = 0, last = -1;
+            if (summary_frame_range(&summary, tstart, tend, &first, &last)) {
+                char fitspath[1024];
+                if (!fits_cube_path(filepath, fitspath, sizeof(fitspath))) strcpy(fitspath, "-");
+                fprintf(fp, "%s\t%s\t%s\t%ld\t%ld\t%ld\t%.9f\t%.9f\n", s->name, fitspath, filepath, first, last,
+                        last - first + 1, summary_frame_time(&summary, first), summary_frame_time(&summary, last));
+                nfiles++;
+                nframes += last - first + 1;
+            }
+            free(summary.timestamps);
+        }
+    }
+    if (!to_stdout && fclose(fp) != 0) {
+        fprintf(stderr, "Error: Cannot write manifest %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "Manifest: %ld files, %ld frames in %d streams%s%s\n", nfiles, nframes, stream_list->count,
+            to_stdout ? "" : " written to ", to_stdout ? "" : out_path);
+    return 0;
+}
+
+// Logging latency (col4 - col5): per-file sketches and chunk maxima, cached next to the
+// timing caches and merged per stream
+
+void latency_sketch_init(LatencySketch *sk) {
+    memset(sk, 0, sizeof(*sk));
+}
+
+void latency_sketch_add(LatencySketch *sk, double latency) {
+    int bin = 0;
+    if (latency > LATENCY_SKETCH_MIN) {
+        bin = (int)ceil(log(latency / LATENCY_SKETCH_MIN) / log(LATENCY_SKETCH_GAMMA));
+        if (bin > LATENCY_SKETCH_BINS - 1) bin = LATENCY_SKETCH_BINS - 1;
+    }
+    sk->bins[bin]++;
+    if (sk->count == 0 || latency < sk->min) sk->min = latency;
+    if (sk->count == 0 || latency > sk->max) sk->max = latency;
+    sk->count++;
+}
+
+void latency_sketch_merge(LatencySketch *dst, const LatencySketch *src) {
+    if (src->count == 0) return;
+    for (int b = 0; b < LATENCY_SKETCH_BINS; b++) dst->bins[b] += src->bins[b];
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (dst->count == 0 || src->max > dst->max) dst->max = src->max;
+    dst->count += src->count;
+}
+
+// Value of rank q * (count - 1): middle of its bin (relative), clamped to the exact min and max
+double latency_sketch_quantile(const LatencySketch *sk, double q) {
+    if (sk->count == 0) return 0.0;
+    long rank = (long)(q * (sk->count - 1));
+    long seen = 0;
+    for (int b = 0; b < LATENCY_SKETCH_BINS; b++) {
+        seen += sk->bins[b];
+        if (seen <= rank) continue;
+        double value = (b == 0) ? sk->min
+                     : LATENCY_SKETCH_MIN * 2.0 * pow(LATENCY_SKETCH_GAMMA, b) / (LATENCY_SKETCH_GAMMA + 1.0);
+        if (value < sk->min) value = sk->min;
+        if (value > sk->max) value = sk->max;
+        return value;
+    }
+    return sk->max;
+}
+
+void latency_summary_from_frames(LatencySummary *ls, const double *latencies, long n) {
+    latency_sketch_init(&ls->sketch);
+    ls->nframes = n;
+    ls->nchunks = (n + LATENCY_CHUNK_FRAMES - 1) / LATENCY_CHUNK_FRAMES;
+    ls->chunk_max = malloc((ls->nchunks > 0 ? ls->nchunks : 1) * sizeof(double));
+    for (long k = 0; k < ls->nchunks; k++) {
+        long last = (k + 1) * LATENCY_CHUNK_FRAMES;
+        if (last > n) last = n;
+        double vmax = latencies[k * LATENCY_CHUNK_FRAMES];
+        for (long i = k * LATENCY_CHUNK_FRAMES; i < last; i++) {
+            latency_sketch_add(&ls->sketch, latencies[i]);
+            if (latencies[i] > vmax) vmax = latencies[i];
+        }
+        ls->chunk_max[k] = vmax;
+    }
+}
+
+void free_latency_summary(LatencySummary *ls) {
+    free(ls->chunk_max);
+    ls->chunk_max = NULL;
+}
+
+// Cache layout: magic, timing file size, frame count, min, max, chunk count, chunk maxima,
+// number of non-empty sketch bins, then (bin, count) pairs
+int read_latency_cache(const char *cache_path, long timing_size, LatencySummary *ls) {
+    FILE *fp = fopen(cache_path, "rb");
+    if (!fp) return 0;
+    PROF_COUNT(files_opened, 1);
+    char magic[sizeof(LATENCY_CACHE_MAGIC)];
+    long size = 0;
+    int nonzero = 0;
+    latency_sketch_init(&ls->sketch);
+    ls->chunk_max = NULL;
+    int ok = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && strcmp(magic, LATENCY_CACHE_MAGIC) == 0 &&
+             fread(&size, sizeof(long), 1, fp) == 1 && size == timing_size &&
+             fread(&ls->nframes, sizeof(long), 1, fp) == 1 && ls->nframes >= 0 &&
+             fread(&ls->sketch.min, sizeof(double), 1, fp) == 1 &&
+             fread(&ls->sketch.max, sizeof(double), 1, fp) == 1 &&
+             fread(&ls->nchunks, sizeof(long), 1, fp) == 1 &&
+             ls->nchunks == (ls->nframes + LATENCY_CHUNK_FRAMES - 1) / LATENCY_CHUNK_FRAMES;
+    if (ok) {
+        ls->chunk_max = malloc((ls->nchunks > 0 ? ls->nchunks : 1) * sizeof(double));
+        ok = fread(ls->chunk_max, sizeof(double), ls->nchunks, fp) == (size_t)ls->nchunks &&
+             fread(&nonzero, sizeof(int), 1, fp) == 1 && nonzero >= 0 && nonzero <= LATENCY_SKETCH_BINS;
+    }
+    for (int i = 0; ok && i < nonzero; i++) {
+        int bin;
+        long count;
+        ok = fread(&bin, sizeof(int), 1, fp) == 1 && fread(&count, sizeof(long), 1, fp) == 1 &&
+             bin >= 0 && bin < LATENCY_SKETCH_BINS;
+        if (ok) {
+            ls->sketch.bins[bin] = count;
+            ls->sketch.count += count;
+        }
+    }
+    PROF_COUNT(bytes_read, ftell(fp));
+    fclose(fp);
+    if (!ok || ls->sketch.count != ls->nframes) {
+        free_latency_summary(ls);
+        return 0;
+    }
+    return 1;
+}
+
+void write_latency_cache(const char *cache_path, long timing_size, const LatencySummary *ls) {
+    ensure_path_exists(cache_path);
+    char tmp_path[8300];
+    FILE *fp = open_cache_tmp(cache_path, tmp_path, sizeof(tmp_path));
+    if (!fp) return;
+    int nonzero = 0;
+    for (int b = 0; b < LATENCY_SKETCH_BINS; b++) {
+        if (ls->sketch.bins[b] > 0) nonzero++;
+    }
+    fwrite(LATENCY_CACHE_MAGIC, 1, sizeof(LATENCY_CACHE_MAGIC), fp);
+    fwrite(&timing_size, sizeof(long), 1, fp);
+    fwrite(&ls->nframes, sizeof(long), 1, fp);
+    fwrite(&ls->sketch.min, sizeof(double), 1, fp);
+    fwrite(&ls->sketch.max, sizeof(double), 1, fp);
+    fwrite(&ls->nchunks, sizeof(long), 1, fp);
+    fwrite(ls->chunk_max, sizeof(double), ls->nchunks, fp);
+    fwrite(&nonzero, sizeof(int), 1, fp);
+    for (int b = 0; b < LATENCY_SKETCH_BINS; b++) {
+        if (ls->sketch.bins[b] == 0) continue;
+        fwrite(&b, sizeof(int), 1, fp);
+        fwrite(&ls->sketch.bins[b], sizeof(long), 1, fp);
+    }
+    publish_cache_tmp(fp, tmp_path, cache_path);
+}
+
+// Per-frame col5 and col4 - col5 of a whole timing file (caller frees p->timestamps, p->latencies)
+int parse_timing_file_latency(const char *filepath, TimingParser *p) {
+    timing_parser_init(p);
+    timing_parser_enable_latency(p);
+    if (timing_parser_read_file(p, filepath, NULL, 0) < 0) {
+        free(p->timestamps);
+        free(p->latencies);
+        return 0;
+    }
+    timing_parser_finish(p);
+    return 1;
+}
+
+// Latency summary of a whole timing file, from its .latency cache or parsed (and cached)
+int get_latency_summary(const char *filepath, LatencySummary *ls) {
+    struct stat st;
+    PROF_COUNT(stat_calls, 1);
+    if (stat(filepath, &st) != 0) return 0;
+    char cache_path[8192];
+    aux_cache_path(filepath, LATENCY_CACHE_EXT, cache_path, sizeof(cache_path));
+    if (!g_no_cache && read_latency_cache(cache_path, (long)st.st_size, ls)) return 1;
+
+    TimingParser p;
+    if (!parse_timing_file_latency(filepath, &p)) return 0;
+    latency_summary_from_frames(ls, p.latencies, p.count);
+    free(p.timestamps);
+    free(p.latencies);
+    if (!g_no_cache) write_latency_cache(cache_path, (long)st.st_size, ls);
+    return 1;
+}
+
+double summary_frame_time(const FileSummary *summary, long i) {
+    if (!summary->is_constant) return summary->timestamps[i];
+    double dt = (summary->end - summary->start) / (summary->count > 1 ? summary->count - 1 : 1);
+    return summary->start + i * dt;
+}
+
+void latency_bin_max(Stream *s, int bin, double latency) {
+    if (s->latency_count[bin] == 0 || latency > s->latency_max[bin]) s->latency_max[bin] = latency;
+    s->latency_count[bin]++;
+}
+
+// Adds the frames of one file within [tstart, tend] to the stream latency sketch and per-bin
+// maxima. Files entirely in range use the cached summary (maxima at chunk resolution); the
+// files at the edges of the range are parsed, so that only frames in range are counted.
+void accumulate_latency(Stream *s, const char *filepath, const FileSummary *summary, double tstart, double tend, int num_bins) {
+    long first = 0, last = -1;
+    if (!summary_frame_range(summary, tstart, tend, &first, &last)) return;
+
+    if (first == 0 && last == summary->count - 1) {
+        LatencySummary ls;
+        if (!get_latency_summary(filepath, &ls)) return;
+        latency_sketch_merge(s->latency, &ls.sketch);
+        long n = (ls.nframes < summary->count) ? ls.nframes : summary->count;
+        for (long k = 0; k < ls.nchunks; k++) {
+            long i0 = k * LATENCY_CHUNK_FRAMES;
+            long i1 = i0 + LATENCY_CHUNK_FRAMES - 1;
+            if (i0 >= n) break;
+            if (i1 > n - 1) i1 = n - 1;
+            int b0 = time_to_bin(summary_frame_time(summary, i0), tstart, tend, num_bins);
+            int b1 = time_to_bin(summary_frame_time(summary, i1), tstart, tend, num_bins);
+            for (int b = b0; b <= b1; b++) latency_bin_max(s, b, ls.chunk_max[k]);
+        }
+        free_latency_summary(&ls);
+        return;
+    }
+
+    TimingParser p;
+    if (!parse_timing_file_latency(filepath, &p)) return;
+    for (long i = 0; i < p.count; i++) {
+        if (p.timestamps[i] < tstart || p.timestamps[i] > tend) continue;
+        latency_sketch_add(s->latency, p.latencies[i]);
+        latency_bin_max(s, time_to_bin(p.timestamps[i], tstart, tend, num_bins), p.latencies[i]);
+    }
+    free(p.timestamps);
+    free(p.latencies);
+}
+
+int get_num_threads() {
+    if (g_num_threads > 0) return g_num_threads;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+// Auxiliary per-file cache path (e.g. flux series), next to the per-file timing cache
+void aux_cache_path(const char *filepath, const char *ext, char *out, size_t size) {
+    const char *dir_sep = strrchr(filepath, '/');
+    if (g_cache_export && dir_sep) {
+        snprintf(out, size, "%.*s/%s/%s%s", (int)(dir_sep - filepath), filepath, CACHE_DIR, dir_sep + 1, ext);
+    } else {
+        snprintf(out, size, "%s/%s%s", g_cache_root, filepath, ext);
+    }
+}
+
+// Per-frame statistics of a cube, valid while its size and mtime are those of st
+int read_flux_cache(const char *cache_path, const struct stat *st, FluxSeries *fs) {
+    FILE *fp = fopen(cache_path, "rb");
+    if (!fp) return 0;
+    char magic[sizeof(FLUX_CACHE_MAGIC)];
+    long size = 0, mtime_sec = 0, mtime_nsec = 0, n = 0;
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || strcmp(magic, FLUX_CACHE_MAGIC) != 0 ||
+        fread(&size, sizeof(long), 1, fp) != 1 || size != (long)st->st_size ||
+        fread(&mtime_sec, sizeof(long), 1, fp) != 1 || mtime_sec != (long)st->st_mtim.tv_sec ||
+        fread(&mtime_nsec, sizeof(long), 1, fp) != 1 || mtime_nsec != (long)st->st_mtim.tv_nsec ||
+        fread(&n, sizeof(long), 1, fp) != 1 || n < 0) {
+        fclose(fp);
+        return 0;
+    }
+    fs->nframes = n;
+    fs->mean = malloc((n > 0 ? n : 1) * sizeof(double));
+    fs->max = malloc((n > 0 ? n : 1) * sizeof(double));
+    if (fread(fs->mean, sizeof(double), n, fp) != (size_t)n || fread(fs->max, sizeof(double), n, fp) != (size_t)n) {
+        free(fs->mean);
+        free(fs->max);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    return 1;
+}
+
+void write_flux_cache(const char *cache_path, const struct stat *st, const FluxSeries *fs) {
+    ensure_path_exists(cache_path);
+    char tmp_path[8300];
+    FILE *fp = open_cache_tmp(cache_path, tmp_path, sizeof(tmp_path));
+    if (!fp) return;
+    long size = (long)st->st_size;
+    long mtime_sec = (long)st->st_mtim.tv_sec;
+    long mtime_nsec = (long)st->st_mtim.tv_nsec;
+    fwrite(FLUX_CACHE_MAGIC, 1, sizeof(FLUX_CACHE_MAGIC), fp);
+    fwrite(&size, sizeof(long), 1, fp);
+    fwrite(&mtime_sec, sizeof(long), 1, fp);
+    fwrite(&mtime_nsec, sizeof(long), 1, fp);
+    fwrite(&fs->nframes, sizeof(long), 1, fp);
+    fwrite(fs->mean, sizeof(double), fs->nframes, fp);
+    fwrite(fs->max, sizeof(double), fs->nframes, fp);
+    publish_cache_tmp(fp, tmp_path, cache_path);
+}
+
+// Byte-swap-and-accumulate kernels over one frame of big-endian FITS pixels.
+// Independent lane accumulators let the compiler vectorize the swap, sum and max;
+// SIMD_CLONES selects the AVX-512 / AVX2 / baseline version at load time.
+#define FLUX_LANES 16
+
+#define DEFINE_FLUX_KERNEL(NAME, UTYPE, VTYPE, ACCTYPE, SWAP, MINVAL)                       \
+SIMD_CLONES                                                                                 \
+void NAME(const unsigned char *p, long n, double *sum_out, double *max_out) {              \
+    ACCTYPE acc[FLUX_LANES];                                                                \
+    VTYPE mx[FLUX_LANES];                                                                   \
+    for (int l = 0; l < FLUX_LANES; l++) { acc[l] = 0; mx[l] = MINVAL; }                   \
+    long i = 0;                                                                             \
+    for (; i + FLUX_LANES <= n; i += FLUX_LANES) {                                          \
+        for (int l = 0; l < FLUX_LANES; l++) {                                              \
+            UTYPE u;                                                                        \
+            memcpy(&u, p + sizeof(UTYPE) * (i + l), sizeof(UTYPE));                         \
+            u = SWAP(u);                                                                    \
+            VTYPE v;                                                                        \
+            memcpy(&v, &u, sizeof(VTYPE));                                                  \
+            acc[l] += v;                                                                    \
+            mx[l] = v > mx[l] ? v : mx[l];                                                  \
+        }                                                                                   \
+    }                                                                                       \
+    for (; i < n; i++) {                                                                    \
+        UTYPE u;                                                                            \
+        memcpy(&u, p + sizeof(UTYPE) * i, sizeof(UTYPE));                                   \
+        u = SWAP(u);                                                                        \
+        VTYPE v;                                                                            \
+        memcpy(&v, &u, sizeof(VTYPE));                                                      \
+        acc[0] += v;                                                                        \
+        mx[0] = v > mx[0] ? v : mx[0];                                                      \
+    }                                                                                       \
+    double sum = 0;                                                                         \
+    VTYPE m = MINVAL;                                                                       \
+    for (int l = 0; l < FLUX_LANES; l++) { sum += (double)acc[l]; if (mx[l] > m) m = mx[l]; } \
+    *sum_out = sum;                                                                         \
+    *max_out = (double)m;                                                                   \
+}
+
+#define FLUX_NOSWAP(x) (x)
+DEFINE_FLUX_KERNEL(flux_kernel_u8, uint8_t, uint8_t, int64_t, FLUX_NOSWAP, 0)
+DEFINE_FLUX_KERNEL(flux_kernel_i16, uint16_t, int16_t, int64_t, __builtin_bswap16, INT16_MIN)
+DEFINE_FLUX_KERNEL(flux_kernel_i32, uint32_t, int32_t, int64_t, __builtin_bswap32, INT32_MIN)
+DEFINE_FLUX_KERNEL(flux_kernel_f32, uint32_t, float, double, __builtin_bswap32, -INFINITY)
+DEFINE_FLUX_KERNEL(flux_kernel_f64, uint64_t, double, double, __builtin_bswap64, -INFINITY)
+
+// Per-frame mean and max of an uncompressed FITS cube, read through mmap
+int compute_fits_flux(const char *fits_path, FluxSeries *fs) {
+    int fd = open(fits_path, O_RDONLY);
+    if (fd < 0) return 0;
+    PROF_COUNT(files_opened, 1);
+    int ncards = 0;
+    long header_bytes = 0;
+    char *cards = read_fits_header_at(fd, 0, &ncards, &header_bytes);
+    long bitpix = 0, naxis1 = 0, naxis2 = 0, naxis3 = 1;
+    double bzero = 0.0, bscale = 1.0;
+    struct stat st;
+    if (!cards || fstat(fd, &st) != 0 ||
+        !fits_cards_get_long(cards, ncards, "BITPIX", &bitpix) ||
+        !fits_cards_get_long(cards, ncards, "NAXIS1", &naxis1) ||
+        !fits_cards_get_long(cards, ncards, "NAXIS2", &naxis2)) {
+        free(cards);
+        close(fd);
+        return 0;
+    }
+    fits_cards_get_long(cards, ncards, "NAXIS3", &naxis3);
+    fits_cards_get_double(cards, ncards, "BZERO", &bzero);
+    fits_cards_get_double(cards, ncards, "BSCALE", &bscale);
+    free(cards);
+
+    void (*kernel)(const unsigned char *, long, double *, double *) = NULL;
+    switch (bitpix) {
+        case 8: kernel = flux_kernel_u8; break;
+        case 16: kernel = flux_kernel_i16; break;
+        case 32: kernel = flux_kernel_i32; break;
+        case -32: kernel = flux_kernel_f32; break;
+        case -64: kernel = flux_kernel_f64; break;
+        default: close(fd); return 0;
+    }
+
+    long npix = naxis1 * naxis2;
+    long frame_bytes = labs(bitpix) / 8 * npix;
+    long avail = (frame_bytes > 0) ? ((long)st.st_size - header_bytes) / frame_bytes : 0;
+    if (naxis3 > avail) naxis3 = avail;
+    if (naxis3 <= 0 || npix <= 0) {
+        close(fd);
+        return 0;
+    }
+
+    size_t map_len = header_bytes + (size_t)naxis3 * frame_bytes;
+    unsigned char *map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    PROF_COUNT(bytes_read, (long)naxis3 * frame_bytes);
+
+    fs->nframes = naxis3;
+    fs->mean = malloc(naxis3 * sizeof(double));
+    fs->max = malloc(naxis3 * sizeof(double));
+    for (long k = 0; k < naxis3; k++) {
+        double sum = 0, mx = 0;
+        kernel(map + header_bytes + k * frame_bytes, npix, &sum, &mx);
+        fs->mean[k] = bzero + bscale * sum / npix;
+        fs->max[k] = bzero + bscale * mx;
+    }
+    munmap(map, map_len);
+    return 1;
+}
+
+typedef struct {
+    char fits_path[1024];
+    FluxSeries flux;
+    int ok;
+    int from_cache;
+} FluxJob;
+
+typedef struct {
+    FluxJob *jobs;
+    int njobs;
+    int next;
+} FluxWork;
+
+void *flux_worker(void *arg) {
+    FluxWork *w = (FluxWork *)arg;
+    for (;;) {
+        int j = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (j >= w->njobs) break;
+        FluxJob *job = &w->jobs[j];
+        double t_trace = trace_begin();
+        struct stat st;
+        PROF_COUNT(stat_calls, 1);
+        if (stat(job->fits_path, &st) != 0) continue;
+
+        char cache_path[8192];
+        aux_cache_path(job->fits_path, FLUX_CACHE_EXT, cache_path, sizeof(cache_path));
+        if (!g_no_cache && read_flux_cache(cache_path, &st, &job->flux)) {
+            job->ok = 1;
+            job->from_cache = 1;
+            trace_span("flux_cube", "flux", t_trace, job->fits_path, 1, job->flux.nframes, -1);
+            continue;
+        }
+        if (compute_fits_flux(job->fits_path, &job->flux)) {
+            job->ok = 1;
+            if (!g_no_cache) write_flux_cache(cache_path, &st, &job->flux);
+        }
+        trace_span("flux_cube", "flux", t_trace, job->fits_path, g_no_cache ? -1 : 0, job->ok ? job->flux.nframes : -1, (long)st.st_size);
+    }
+    return NULL;
+}
+
+// Flux timeline for stream s: per-frame statistics computed in parallel over cubes,
+// then aggregated sequentially into the timeline bins
+void process_stream_flux(Stream *s, double tstart, double tend, int num_bins) {
+    FluxWork work;
+    work.jobs = calloc(s->file_count > 0 ? s->file_count : 1, sizeof(FluxJob));
+    work.njobs = s->file_count;
+    work.next = 0;
+    for (int j = 0; j < s->file_count; j++) {
+        const char *filepath = s->files[j].path;
+        snprintf(work.jobs[j].fits_path, sizeof(work.jobs[j].fits_path), "%.*s.fits", (int)timing_stem_len(filepath), filepath);
+    }
+
+    int nthreads = get_num_threads();
+    if (nthreads > work.njobs) nthreads = work.njobs;
+    if (nthreads <= 1) {
+        flux_worker(&work);
+    } else {
+        pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+        for (int t = 0; t < nthreads; t++) pthread_create(&threads[t], NULL, flux_worker, &work);
+        for (int t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+        free(threads);
+    }
+
+    long nframes = 0, ncached = 0, nmissing = 0;
+    for (int j = 0; j < s->file_count; j++) {
+        FluxJob *job = &work.jobs[j];
+        if (!job->ok) {
+            nmissing++;
+            continue;
+        }
+        if (job->from_cache) ncached++;
+
+        FileSummary summary;
+        get_file_data(s->files[j].path, &summary);
+        long first = 0, last = -1;
+        if (summary_frame_range(&summary, tstart, tend, &first, &last)) {
+            if (last >= job->flux.nframes) last = job->flux.nframes - 1;
+            double dt = (summary.count > 1) ? (summary.end - summary.start) / (summary.count - 1) : 0.0;
+            for (long k = first; k <= last; k++) {
+                double timestamp = summary.is_constant ? summary.start + k * dt : summary.timestamps[k];
+                int bin = time_to_bin(timestamp, tstart, tend, num_bins);
+                if (s->flux_count[bin] == 0 || job->flux.max[k] > s->flux_max[bin]) s->flux_max[bin] = job->flux.max[k];
+                s->flux_sum[bin] += job->flux.mean[k];
+                s->flux_count[bin]++;
+                nframes++;
+            }
+        }
+        if (summary.timestamps) free(summary.timestamps);
+        free(job->flux.mean);
+        free(job->flux.max);
+    }
+    free(work.jobs);
+
+    printf("Flux %s: %ld frames from %d cubes (%ld cached), %ld cubes unavailable (missing or compressed)\n",
+           s->name, nframes, s->file_count - (int)nmissing, ncached, nmissing);
+}
+
+// Timeline header: D/H/M/S where the day, hour, minute or second changes within a bin
+// (finer units only when bins are short enough to show them)
+void render_time_axis(FILE *out, int prefix_width, double tstart, double tend, int timeline_width) {
+    double dt_per_char = (tend - tstart) / timeline_width;
+    fprintf(out, "%-*s ", prefix_width, "");
+
+    int show_s = (dt_per_char < 2.0);
+    int show_m = (dt_per_char < 120.0);
+    int show_h = (dt_per_char < 7200.0);
+
+    for (int i = 0; i < timeline_width; i++) {
+        char marker = ' ';
+        double t0 = tstart + i * dt_per_char;
+        double t1 = tstart + (i + 1) * dt_per_char;
+
+        time_t time0 = (time_t)t0;
+        time_t time1 = (time_t)t1;
+
+        if (time0 != time1) {
+            struct tm tm0;
+            struct tm tm1;
+            gmtime_r(&time0, &tm0);
+            gmtime_r(&time1, &tm1);
+
+            if (tm0.tm_year != tm1.tm_year || tm0.tm_yday != tm1.tm_yday) {
+                marker = 'D';
+            } else if (tm0.tm_hour != tm1.tm_hour) {
+                if (show_h) marker = 'H';
+            } else if (tm0.tm_min != tm1.tm_min) {
+                if (show_m) marker = 'M';
+            } else if (tm0.tm_sec != tm1.tm_sec) {
+                if (show_s) marker = 'S';
+            }
+        }
+
+        if (marker == 'H') {
+            fprintf(out, BG_HIGHLIGHT_H "%c" RESET_COLOR, marker);
+        } else if (marker == 'M') {
+            fprintf(out, BG_HIGHLIGHT_M "%c" RESET_COLOR, marker);
+        } else {
+            fputc(marker, out);
+        }
+    }
+    fputc('\n', out);
+}
+
+// Keyword row of <tk> over [tstart, tend] in timeline_width bins (key_line holds width + 1 chars):
+// '|' where the value changes, followed by the new value spelled out. Returns 0 if no change is in range.
+int build_key_line(const TrackedKey *tk, double tstart, double tend, int timeline_width, char *key_line) {
+    double dt_per_char = (tend - tstart) / timeline_width;
+    memset(key_line, ' ', timeline_width);
+    key_line[timeline_width] = '\0';
+
+    int has_key_entries = 0;
+
+    // Pass 1: Pipes
+    for (int r = 0; r < kscan_ctx.report.count; r++) {
+        ReportLine *l = &kscan_ctx.report.lines[r];
+        if (l->is_count_line) continue;
+        if (strcmp(l->stream_name, tk->stream_name) != 0) continue;
+        if (strcmp(l->keyname, tk->key) != 0) continue;
+
+        if (l->ts >= tstart && l->ts <= tend) {
+            int bin = (int)((l->ts - tstart) / (tend - tstart) * timeline_width);
+            if (bin >= 0 && bin < timeline_width) {
+                key_line[bin] = '|';
+                has_key_entries = 1;
+            }
+        }
+    }
+    if (!has_key_entries) return 0;
+
+    // Pass 2: Values
+    for (int b = 0; b < timeline_width; b++) {
+        if (key_line[b] == '|') continue;
+
+        double bin_time = tstart + (b + 0.5) * dt_per_char;
+
+        const char *val = NULL;
+        for (int r = 0; r < kscan_ctx.report.count; r++) {
+            ReportLine *l = &kscan_ctx.report.lines[r];
+            if (l->is_count_line) continue;
+            if (strcmp(l->stream_name, tk->stream_name) != 0) continue;
+            if (strcmp(l->keyname, tk->key) != 0) continue;
+
+            if (l->ts <= bin_time) {
+                val = l->value;
+            } else {
+                break;
+            }
+        }
+
+        if (val) {
+            int prev_pipe = -1;
+            for (int p = b - 1; p >= 0; p--) {
+                if (key_line[p] == '|') {
+                    prev_pipe = p;
+                    break;
+                }
+            }
+            int dist = b - (prev_pipe == -1 ? -1 : prev_pipe);
+            int char_idx = dist - 1;
+            if (char_idx >= 0 && char_idx < (int)strlen(val)) {
+                key_line[b] = val[char_idx];
+            }
+        }
+    }
+    return 1;
+}
+
+// Render one row of per-bin values scaled between their min and max over the row
+void print_value_row(const char *label_fmt, int prefix_width, const double *values, const long *counts, int num_bins) {
+    double vmin = 0.0, vmax = 0.0;
+    int has_value = 0;
+    for (int b = 0; b < num_bins; b++) {
+        if (counts[b] == 0) continue;
+        if (!has_value || values[b] < vmin) vmin = values[b];
+        if (!has_value || values[b] > vmax) vmax = values[b];
+        has_value = 1;
+    }
+    if (!has_value) return;
+
+    char label[64];
+    snprintf(label, sizeof(label), label_fmt, vmin, vmax);
+    printf("%*s ", prefix_width, label);
+    for (int b = 0; b < num_bins; b++) {
+        if (counts[b] == 0) {
+            printf("%s %s", BG_BLACK, RESET_COLOR);
+            continue;
+        }
+        int idx = 4;
+        if (vmax > vmin) {
+            idx = 1 + (int)((values[b] - vmin) / (vmax - vmin) * 7.999);
+            if (idx < 1) idx = 1;
+            if (idx > 8) idx = 8;
+        }
+        printf("%s%s%s%s", BG_SCALE, COLORS[idx], BLOCKS[idx], RESET_COLOR);
+    }
+    printf("\n");
+}
+
+// Density row of one stream: name, frame count, peak rate and one block per timeline bin
+void render_stream_row(FILE *out, const Stream *s, int max_name_len, int max_count_len, double dt_per_char, int timeline_width) {
+    // Calculate max FPS
+    double max_fps = 0.0;
+    if (dt_per_char > 0.0) {
+        max_fps = (double)s->max_bin_count / dt_per_char;
+    }
+
+    // Print prefix: Name(Bold) Count FPS
+    fprintf(out, BOLD_COLOR "%-*s" RESET_COLOR "   %*ld   %6.1f Hz ",
+            max_name_len, s->name,
+            max_count_len, s->total_frames,
+            max_fps);
+
+    for (int b = 0; b < timeline_width; b++) {
+        int count = s->bins[b];
+        int idx = 0;
+        if (count > 0) {
+            if (s->max_bin_count > 0) {
+                idx = 1 + (int)((double)count * 7.999 / s->max_bin_count);
+                if (idx > 8) idx = 8;
+                if (idx < 1) idx = 1;
+            } else {
+                idx = 1;
+            }
+        }
+        if (idx == 0) fputs(BG_BLACK, out);
+        else fputs(BG_SCALE, out);
+
+        if (idx > 0) fputs(COLORS[idx], out);
+        fputs(BLOCKS[idx], out);
+        fputs(RESET_COLOR, out);
+    }
+    fputc('\n', out);
+}
@@ -0,0 +1,598 @@
+#ifndef MILK_TELEMETRY_H
+#define MILK_TELEMETRY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <regex.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/file.h>
+
+// Unicode Block Elements
+extern const char *BLOCKS[];
+// ANSI Colors (Blue -> Cyan -> Green -> Yellow -> Red)
+extern const char *COLORS[];
+#define RESET_COLOR "\033[0m"
+#define BOLD_COLOR "\033[1m"
+#define BG_HIGHLIGHT_H "\033[41m" // Red background
+#define BG_HIGHLIGHT_M "\033[44m" // Blue background
+#define BG_SCALE "\033[48;5;237m" // Dark Grey background
+#define BG_BLACK "\033[40m"       // Black background
+
+// Vectorized kernels: AVX-512 / AVX2 / baseline clones selected at load time on x86-64,
+// a single baseline version elsewhere
+#if defined(__x86_64__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+// Cache constants
+#define CACHE_DIR "cache"
+#define CACHE_EXT ".cache"
+#define BINARY_CACHE_FILENAME "telemetry.cache"
+#define BINARY_CACHE_MAGIC "MILKCACHE_V2"
+#define BINARY_CACHE_MAGIC_V1 "MILKCACHE_V1" // read only: constant entries without jitter
+#define FLUX_CACHE_EXT ".flux"
+#define FLUX_CACHE_MAGIC "MILKFLUX_V2"
+#define LATENCY_CACHE_EXT ".latency"
+#define LATENCY_CACHE_MAGIC "MILKLAT_V1"
+#define KEYS_CACHE_EXT ".keys"
+#define KEYS_CACHE_MAGIC "MILKKEYS_V1"
+
+// Timing file names, plain or compressed (timingz.c): suffix alternatives for dir_list_read
+#define TIMING_SUFFIXES ".txt|.txt.gz|.txt.zst"
+#define TIMING_NONE 0
+#define TIMING_TXT 1
+#define TIMING_GZ 2
+#define TIMING_ZST 3
+
+// Timing file probe: records sampled at stride, max deviation from the constant-rate line
+// (in frame periods; a dropped frame shifts the samples around it by ~0.5 period or more)
+#define PROBE_SAMPLES 16
+#define PROBE_HEAD_BYTES 4096
+#define PROBE_MAX_DEVIATION 0.25
+
+// Logging latency sketch: bin i holds latencies in (MIN * GAMMA^(i-1), MIN * GAMMA^i] seconds,
+// so quantiles are within 1% relative error up to MIN * GAMMA^(BINS-1) (~60 s)
+#define LATENCY_SKETCH_BINS 1024
+#define LATENCY_SKETCH_GAMMA 1.02
+#define LATENCY_SKETCH_MIN 1e-7
+// Frames per cached max latency, for the timeline row
+#define LATENCY_CHUNK_FRAMES 100
+
+// FITS constants
+#define FITS_BLOCK_SIZE 2880
+#define FITS_CARD_SIZE 80
+#define FITS_MAX_HEADER_BLOCKS 1000
+
+// Intervals across files longer than this many frame periods are logging gaps, not frame intervals
+#define RATE_MAX_GAP_FRAMES 100
+// Coverage: logging gaps up to this many frame periods (dropped frames) do not split an interval
+#define COVERAGE_MAX_GAP_FRAMES 5
+
+// Timing line layout written by save_telemetry_fits_function (milk logshmim.c)
+#define TIMING_LINE_FORMAT "%10ld  %10s  %15.9f   %20s  %17s   %10s   %10s\n"
+
+typedef struct {
+    int is_constant;
+    long count;
+    double start;
+    double end;
+    double *timestamps; // NULL if is_constant, otherwise array of size count
+    // Frame interval jitter of a constant-rate file: sample std, min and max of its intervals
+    // (has_jitter 0 if unknown: summary from the record probe, or from an older cache)
+    int has_jitter;
+    double dt_std;
+    double dt_min;
+    double dt_max;
+} FileSummary;
+
+// Incremental col5 parser state (see timing_parser_feed)
+typedef struct {
+    double *timestamps;
+    double *latencies; // col4 - col5 per frame, NULL unless timing_parser_enable_latency
+    long count;
+    long capacity;
+    char partial[1024];
+    size_t partial_len;
+} TimingParser;
+
+// Fixed-size, mergeable quantile sketch of logging latencies (log-bucketed counts)
+typedef struct {
+    long count;
+    double min;
+    double max;
+    long bins[LATENCY_SKETCH_BINS];
+} LatencySketch;
+
+// Logging latency of one timing file (cached as <file>.latency)
+typedef struct {
+    LatencySketch sketch;
+    long nframes;
+    long nchunks;
+    double *chunk_max; // max latency of each LATENCY_CHUNK_FRAMES frames
+} LatencySummary;
+
+typedef struct {
+    char *key; // stream/filename
+    FileSummary summary;
+} BinaryCacheEntry;
+
+typedef struct {
+    BinaryCacheEntry *entries;
+    int count;
+    int capacity;
+    int dirty;
+    char filepath[4096];
+} BinaryCache;
+
+typedef struct {
+    char *path;
+    double timestamp;
+} FileEntry;
+
+// Data roots (roots.c)
+#define MAX_ROOTS 64
+
+typedef struct {
+    char *paths[MAX_ROOTS];
+    int count;
+} RootList;
+
+// One range of a batch query (--ranges)
+typedef struct {
+    double tstart;
+    double tend;
+    char label[256];
+    int index; // line order in the ranges file
+} RangeQuery;
+
+// Discovery by a per-device worker process (shared with the parent)
+typedef struct {
+    dev_t dev;
+    char roots[1024]; // ':'-separated roots on the device
+    long files;
+    long bytes;       // bytes read by the worker
+    double seconds;
+    int failed;
+} DeviceStats;
+
+// Running statistics of frame intervals (Welford accumulator)
+typedef struct {
+    long n;
+    double mean;
+    double m2;
+    double min;
+    double max;
+} IntervalStats;
+
+typedef struct {
+    char name[256];
+    long total_frames;
+    int *bins;
+    int max_bin_count;
+    IntervalStats *interval_stats; // per-bin, NULL unless -rate
+    double rate_last_ts; // timestamp of previous frame, for intervals across files
+    double *flux_sum; // per-bin sum of frame means, NULL unless -flux selects this stream
+    double *flux_max; // per-bin max pixel value
+    long *flux_count; // per-bin number of frames with flux
+    LatencySketch *latency; // logging latency of frames in range, NULL unless -latency
+    double *latency_max; // per-bin max logging latency
+    long *latency_count; // per-bin number of latency samples (frames, or chunks of cached files)
+    FileEntry *files;
+    int file_count;
+    int file_capacity;
+} Stream;
+
+typedef struct {
+    Stream *streams;
+    int count;
+    int capacity;
+} StreamList;
+
+typedef struct {
+    int is_count_line; // 1 if this is "XX files", 0 if change line
+    int count; // Used if is_count_line
+    // Used if !is_count_line
+    char stream_name[256];
+    char keyname[80];
+    double ts;
+    char status[16];
+    char value[256];
+    char filename[256];
+} ReportLine;
+
+typedef struct {
+    ReportLine *lines;
+    int count;
+    int capacity;
+} Report;
+
+typedef struct {
+    char stream_name[256];
+    char key[80];
+    char last_value[256];
+    int count_same_val;
+    int has_last_value;
+} TrackedKey;
+
+typedef struct {
+    char target_key_pattern[256];
+    regex_t key_regex;
+    char target_stream[256]; // Empty if scanning all
+
+    TrackedKey *tracked_keys;
+    int tracked_count;
+    int tracked_capacity;
+
+    Report report;
+} KeyScanContext;
+
+// Cards of one header whose keyword matches the -k pattern, in card order. Headers are
+// read and matched in parallel; the tracking of values (INITIAL/CHANGE) runs afterwards
+// over these, in file order.
+typedef struct {
+    char key[81];
+    char value[256];
+} HeaderCard;
+
+typedef struct {
+    HeaderCard *cards;
+    int count;
+    int capacity;
+} HeaderCards;
+
+#define PROF_HIST_BUCKETS 24
+
+// Adds n to a g_prof counter when profiling (atomic: flux workers run in parallel)
+#define PROF_COUNT(field, n) do { if (g_profile) __atomic_fetch_add(&g_prof.field, (long)(n), __ATOMIC_RELAXED); } while (0)
+
+// Directory listing (dirlist.c): sorted entries, names stored in one arena
+typedef struct {
+    uint64_t key;       // sort key: 8 name bytes after the common prefix
+    size_t name;        // offset in names
+    unsigned char type; // d_type
+} DirEntry;
+
+typedef struct {
+    char *buf;          // getdents64 buffer, reused across reads
+    char *names;
+    size_t names_size;
+    size_t names_capacity;
+    DirEntry *entries;
+    int count;
+    int capacity;
+} DirList;
+
+// Whole-file readahead queue (readahead.c)
+typedef struct Readahead Readahead;
+
+// Trace events (--trace): preallocated ring, grown between scan phases (trace_reserve);
+// the oldest events are overwritten when full
+#define TRACE_RING_SIZE 65536
+
+typedef struct {
+    const char *name; // static strings
+    const char *cat;
+    double ts;
+    double dur;
+    int tid;
+    int cache;        // -1: n/a, 0: miss, 1: hit
+    long count;       // frames, directory or cache entries; -1: n/a
+    long bytes;       // -1: n/a
+    char detail[112];
+} TraceEvent;
+
+// Per-frame pixel statistics of one FITS cube
+typedef struct {
+    long nframes;
+    double *mean;
+    double *max;
+} FluxSeries;
+
+typedef struct {
+    double start_time;
+    double discovery_time;
+    double processing_time;
+    double cache_read_time;
+    double cache_write_time;
+    double file_parse_time;
+    double flux_time;
+
+    // I/O counters
+    long files_opened;
+    long bytes_read;
+    long stat_calls;
+    long scandir_calls;
+    long cache_hits_local;
+    long cache_hits_export;
+    long cache_hits_binary;
+    long cache_misses;
+    long timing_probes;          // cache misses summarized from a few fixed-width records
+    long timing_probe_fallbacks; // probed, then parsed in full
+
+    // Per-file latency histograms, bucket i counts latencies in [2^i, 2^(i+1)) us
+    long parse_hist[PROF_HIST_BUCKETS];
+    long cache_read_hist[PROF_HIST_BUCKETS];
+} ProfileTimes;
+
+// Globals
+extern KeyScanContext kscan_ctx;
+extern int g_cache_export;
+extern int g_no_cache;
+extern char g_cache_root[4096];
+extern long g_cache_searched;
+extern long g_cache_found;
+extern long g_cache_created;
+
+// Binary Cache Globals
+extern int g_use_binary_cache;
+extern BinaryCache *g_binary_cache;
+
+// Frame interval statistics
+extern int g_rate_stats;
+extern char g_rate_export_path[4096];
+
+// Logging latency (col4 - col5)
+extern int g_latency_stats;
+void latency_sketch_init(LatencySketch *sk);
+void latency_sketch_add(LatencySketch *sk, double latency);
+void latency_sketch_merge(LatencySketch *dst, const LatencySketch *src);
+double latency_sketch_quantile(const LatencySketch *sk, double q);
+void latency_summary_from_frames(LatencySummary *ls, const double *latencies, long n);
+void free_latency_summary(LatencySummary *ls);
+int read_latency_cache(const char *cache_path, long timing_size, LatencySummary *ls);
+void write_latency_cache(const char *cache_path, long timing_size, const LatencySummary *ls);
+int parse_timing_file_latency(const char *filepath, TimingParser *p);
+int get_latency_summary(const char *filepath, LatencySummary *ls);
+double summary_frame_time(const FileSummary *summary, long i);
+void accumulate_latency(Stream *s, const char *filepath, const FileSummary *summary, double tstart, double tend, int num_bins);
+
+// Pixel statistics (flux) timeline
+extern char g_flux_stream[256];
+extern int g_flux_show_max;
+
+// Scan options
+extern int g_num_threads; // 0: number of online CPUs
+extern int g_timing_probe; // summarize constant-rate timing files from a few records
+extern char g_stream_select[4096]; // comma-separated streams to scan, empty for all
+extern int g_quiet; // no progress lines on stdout (--manifest -)
+
+// Profiling globals
+extern int g_profile;
+extern int g_profile_json;
+extern ProfileTimes g_prof;
+extern long g_alloc_count; // malloc/calloc/realloc/strdup calls (alloc_count.c)
+
+// Readahead globals
+extern Readahead *g_readahead;
+extern int g_readahead_depth; // files in flight, 0 disables
+
+// Trace globals
+extern int g_trace;
+extern char g_trace_path[4096];
+
+// Per-device discovery workers (roots.c), NULL / 0 when roots are scanned serially
+extern DeviceStats *g_device_stats;
+extern int g_device_count;
+
+// Reports and stream lists
+void init_report(Report *r);
+void add_report_line(Report *r, ReportLine line);
+void free_report(Report *r);
+int compare_report_lines(const void *a, const void *b);
+void init_stream_list(StreamList *list);
+Stream* get_or_create_stream(StreamList *list, const char *name);
+void add_file_to_stream(Stream *s, const char *path, double timestamp);
+void free_stream_list(StreamList *list);
+
+// Time and path helpers
+int is_directory(const char *path);
+double parse_time_arg(const char *arg);
+double get_current_time();
+void format_time_iso(double ts, char *buf, size_t size);
+
+// Profiling
+void prof_hist_add(long *hist, double seconds);
+long get_peak_rss_kb();
+void print_profile_json(FILE *out, double total_time);
+
+// Tracing
+int trace_init();
+int trace_reserve(long n);
+double trace_begin();
+void trace_span(const char *name, const char *cat, double t0, const char *detail, int cache, long count, long bytes);
+void trace_write_string(FILE *fp, const char *str);
+int trace_write(const char *path);
+
+// FITS headers
+void trim_fits_value(char *val);
+int read_header_keyword(const char *filepath, const char *key, char *value_out);
+int fits_cards_find_value(const char *cards, int ncards, const char *key, char *buf);
+int fits_cards_get_long(const char *cards, int ncards, const char *key, long *value_out);
+int fits_cards_get_double(const char *cards, int ncards, const char *key, double *value_out);
+long fits_data_size(const char *cards, int ncards);
+char *read_fits_header_at(int fd, off_t offset, int *ncards, long *header_bytes);
+char *read_fits_image_header(const char *fits_path, int *ncards);
+
+// Summary caches (per-file text cache and per-night binary cache)
+void ensure_cache_dir_exists(const char *parent_dir);
+void ensure_path_exists(const char *filepath);
+int read_cache_fp(FILE *fp, FileSummary *summary);
+int read_cache(const char *cache_path, FileSummary *summary);
+int compare_bcache_entries(const void *a, const void *b);
+void write_binary_cache_fp(FILE *fp, BinaryCache *cache);
+void read_binary_cache_fp(FILE *fp, BinaryCache *cache);
+void free_binary_cache(BinaryCache *cache);
+FILE *open_cache_tmp(const char *path, char *tmp_path, size_t size);
+int publish_cache_tmp(FILE *fp, const char *tmp_path, const char *path);
+void merge_binary_cache_from_disk(BinaryCache *cache);
+long save_binary_cache(BinaryCache *cache);
+void flush_binary_cache();
+void load_binary_cache(const char *filepath);
+void add_to_binary_cache(const char *key, const FileSummary *summary);
+FileSummary* find_in_binary_cache(const char *key);
+void write_cache_fp(FILE *fp, const FileSummary *summary);
+void write_cache(const char *cache_path, const FileSummary *summary);
+const char *binary_cache_key(const char *filepath);
+void binary_cache_path_for(const char *filepath, char *out, size_t size);
+void night_cache_path(const char *date_path, char *out, size_t size);
+int is_date_name(const char *name);
+void file_cache_paths(const char *filepath, char *local_cache_path, char *export_cache_path, size_t size);
+int summary_cache_exists(const char *filepath);
+
+// Directory listing
+void dir_list_init(DirList *dl);
+void dir_list_free(DirList *dl);
+int dir_list_read(DirList *dl, const char *path, const char *suffix);
+const char *dir_list_name(const DirList *dl, int i);
+int dir_list_is_dir(const DirList *dl, int i, const char *parent);
+double date_dir_epoch(const char *date_str);
+double filename_time_from_epoch(const char *filename, size_t len, double date_epoch);
+
+// Readahead
+Readahead *readahead_create(char **paths, int count, int depth);
+int readahead_take(Readahead *ra, const char *path, char **buf, size_t *len);
+void readahead_destroy(Readahead *ra);
+
+// Keyword tracking
+TrackedKey* get_tracked_key(const char *stream, const char *key);
+const char *header_card_key(const char *line, char *key);
+void header_card_value(const char *eq_pos, char *value);
+int header_card_match(const char *line, char *key, char *value);
+void header_cards_add(HeaderCards *hc, const char *key, const char *value);
+void track_key_value(const char *key, const char *value, const char *filename, const char *stream_name, double file_timestamp);
+void header_cards_free(HeaderCards *hc);
+void header_buffer_cards(const char *buf, size_t len, HeaderCards *hc);
+int read_header_cards(const char *header_path, Readahead *ra, HeaderCards *hc);
+int fits_header_cards(const char *fits_path, HeaderCards *hc);
+void reduce_header_cards(const HeaderCards *hc, const char *filename, const char *stream_name, double file_timestamp);
+void scan_stream_headers(Stream *s, double tstart, double tend);
+void process_header_buffer_for_key(const char *buf, size_t len, const char *filename, const char *stream_name, double file_timestamp);
+
+// Timing files
+double parse_filename_time(const char *filename, const char *date_str);
+void timing_parser_init(TimingParser *p);
+void timing_parser_enable_latency(TimingParser *p);
+void timing_parser_line(TimingParser *p, const char *line, const char *end);
+void timing_parser_feed(TimingParser *p, const char *buf, size_t len);
+void timing_parser_finish(TimingParser *p);
+int detect_constant_rate(const double *ts_arr, long count);
+void get_file_data(const char *filepath, FileSummary *summary);
+
+// Fixed-width record probe of timing files
+int parse_timing_record(const char *rec, size_t len, long *index, double *timestamp);
+int probe_timing_file(const char *filepath, FileSummary *summary);
+int timing_probe_applies(const char *filepath);
+int timing_readahead_wanted(const char *filepath);
+
+// Compressed timing files (timingz.c)
+int timing_compression(const char *name, size_t len);
+size_t timing_stem_len(const char *path);
+void timing_cache_key_path(const char *path, char *out, size_t size);
+FILE *timing_fopen(const char *path);
+void timing_fclose(FILE *fp);
+long timing_parser_read_file(TimingParser *p, const char *path, char *buf, size_t len);
+
+// Discovery, binning and interval statistics
+void scan_stream_dir(const char *path, const char *stream_name, double tstart, double tend, StreamList *streams, int num_bins, int pass, long *file_count);
+void interval_stats_add(IntervalStats *st, double dt);
+void interval_stats_add_constant(IntervalStats *st, long n, double dt, double std, double min, double max);
+double interval_stats_std(const IntervalStats *st);
+int time_to_bin(double timestamp, double tstart, double tend, int num_bins);
+void accumulate_constant_intervals(Stream *s, const FileSummary *summary, long start_idx, long end_idx,
+                                   double dt, double tstart, double tend, int num_bins);
+void accumulate_raw_intervals(Stream *s, const FileSummary *summary, double tstart, double tend, int num_bins);
+void accumulate_intervals(Stream *s, const FileSummary *summary, double tstart, double tend, int num_bins);
+void bin_add(int *bins, int *max_bin_count, int bin);
+int timestamps_sorted(const double *t, long n);
+long bin_raw_timestamps(const double *t, long n, double tstart, double tend, int num_bins, int *bins, int *max_bin_count);
+long raw_count_in_range(const FileSummary *summary, double tstart, double tend);
+void bin_summary(const FileSummary *summary, double tstart, double tend, int num_bins, int *bins, int *max_bin_count);
+void header_sidecar_path(const char *timing_path, char *out, size_t size);
+int fits_cube_path(const char *timing_path, char *out, size_t size);
+int timing_first_timestamp(const char *filepath, double *file_ts);
+void process_stream_data(StreamList *stream_list, double tstart, double tend, int num_bins);
+void get_date_bounds(const char *root_dir, const char *date_str, double *t_min, double *t_max);
+void process_all_dates(const char *root_dir, double tstart, double tend, StreamList *stream_list, int timeline_width, int pass, long *file_count);
+
+// Subcube extraction
+int summary_frame_range(const FileSummary *summary, double tstart, double tend, long *first, long *last);
+int copy_file_bytes(int fd_in, off_t off_in, int fd_out, off_t off_out, size_t len);
+long append_timing_lines(FILE *out, const char *timing_path, long first, long last, long *out_index, double *origin);
+int extract_subcube(Stream *s, double tstart, double tend, const char *out_path);
+int write_manifest(StreamList *stream_list, double tstart, double tend, const char *out_path);
+
+// Pixel statistics (flux)
+int get_num_threads();
+void aux_cache_path(const char *filepath, const char *ext, char *out, size_t size);
+int read_flux_cache(const char *cache_path, const struct stat *st, FluxSeries *fs);
+void write_flux_cache(const char *cache_path, const struct stat *st, const FluxSeries *fs);
+void flux_kernel_u8(const unsigned char *p, long n, double *sum_out, double *max_out);
+void flux_kernel_i16(const unsigned char *p, long n, double *sum_out, double *max_out);
+void flux_kernel_i32(const unsigned char *p, long n, double *sum_out, double *max_out);
+void flux_kernel_f32(const unsigned char *p, long n, double *sum_out, double *max_out);
+void flux_kernel_f64(const unsigned char *p, long n, double *sum_out, double *max_out);
+int compute_fits_flux(const char *fits_path, FluxSeries *fs);
+void *flux_worker(void *arg);
+void process_stream_flux(Stream *s, double tstart, double tend, int num_bins);
+
+// Interactive timeline
+long tui_first_frame_at(const FileSummary *fs, double t, long lo, long hi);
+long tui_bin_summary(const FileSummary *fs, double t0, double t1, int num_bins, int *bins);
+int tui_run(StreamList *streams, double tstart, double tend);
+
+// Header diff
+uint64_t header_hash_bytes(const void *data, size_t len, uint64_t h);
+int header_diff(StreamList *stream_list, const char *stream_name, double tstart, double tend);
+
+// Batch range queries (ranges.c)
+int read_ranges(const char *path, RangeQuery **out);
+int ranges_report(StreamList *stream_list, RangeQuery *ranges, int nranges, int term_width);
+
+// Frames per keyword value (keystats.c)
+int header_source_path(const char *timing_path, char *out, size_t size, struct stat *st);
+long build_header_index(const char *source, char **blob);
+int read_keys_cache(const char *cache_path, const struct stat *st, char **blob, long *len);
+void write_keys_cache(const char *cache_path, const struct stat *st, const char *blob, long len);
+void header_index_cards(const char *blob, long len, HeaderCards *hc);
+int keystats_report(StreamList *stream_list, double tstart, double tend);
+
+// Multiple roots and per-device workers (roots.c)
+int root_list_add(RootList *rl, const char *path);
+int root_list_add_paths(RootList *rl, const char *list);
+int root_list_read(RootList *rl, const char *file);
+void root_list_free(RootList *rl);
+void process_all_roots(const RootList *rl, double tstart, double tend, StreamList *stream_list, int timeline_width, int pass, long *file_count);
+void get_roots_date_bounds(const RootList *rl, const char *date_str, double *t_min, double *t_max);
+void device_worker(const RootList *rl, const int *root_dev, int d, double tstart, double tend);
+int scan_devices(const RootList *rl, double tstart, double tend);
+void print_device_stats(FILE *out);
+void print_device_stats_json(FILE *out);
+
+// Multi-stream coverage (coverage.c)
+int stream_selected(const char *name);
+int coverage_report(StreamList *stream_list, const char *names, double tstart, double tend);
+
+// Rendering
+void render_time_axis(FILE *out, int prefix_width, double tstart, double tend, int timeline_width);
+int build_key_line(const TrackedKey *tk, double tstart, double tend, int timeline_width, char *key_line);
+void print_value_row(const char *label_fmt, int prefix_width, const double *values, const long *counts, int num_bins);
+void render_stream_row(FILE *out, const Stream *s, int max_name_len, int max_count_len, double dt_per_char, int timeline_width);
+
+#endif
@@ -0,0 +1,378 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <errno.h>
+#include <stdint.h>
+
+// Synthetic telemetry archive generator.
+// Writes teldir/YYYYMMDD/<stream>/<stream>_hh:mm:ss.sssssssss.{txt,fits.header,fits}
+// following TelemetryFormat.md. Output is fully determined by the parameters and seed.
+
+#define FITS_BLOCK_SIZE 2880
+#define FITS_CARD_SIZE 80
+
+typedef struct {
+    char outdir[4096];
+    int num_streams;
+    int num_nights;
+    int start_year, start_month, start_day;
+    double night_start; // seconds after 00:00 UT
+    int files_per_night;
+    long frames_per_file;
+    double rate;
+    double jitter;      // interval standard deviation, relative to the nominal interval
+    double drop_prob;   // probability that a frame is dropped
+    int rate_changes;   // number of rate changes per stream and night
+    int key_every;      // OBJECT changes every <key_every> files (0: never)
+    int write_header;
+    int write_fits;
+    int naxis1, naxis2;
+    int bitpix;
+    uint64_t seed;
+} GenParams;
+
+typedef struct {
+    uint64_t state;
+} Rng;
+
+uint64_t rng_next(Rng *r) {
+    // splitmix64
+    uint64_t z = (r->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double rng_uniform(Rng *r) {
+    return (rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double rng_gauss(Rng *r) {
+    double u1 = rng_uniform(r);
+    double u2 = rng_uniform(r);
+    if (u1 < 1e-300) u1 = 1e-300;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+void ensure_dir(const char *path) {
+    char temp[4096];
+    strncpy(temp, path, sizeof(temp) - 1);
+    temp[sizeof(temp) - 1] = '\0';
+    for (char *p = temp + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(temp, 0755);
+            *p = '/';
+        }
+    }
+    if (mkdir(temp, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Warning: Failed to create directory %s: %s\n", temp, strerror(errno));
+    }
+}
+
+void add_card(char *buf, int *ncards, const char *fmt_card) {
+    char *card = buf + (size_t)(*ncards) * FITS_CARD_SIZE;
+    memset(card, ' ', FITS_CARD_SIZE);
+    size_t len = strlen(fmt_card);
+    if (len > FITS_CARD_SIZE) len = FITS_CARD_SIZE;
+    memcpy(card, fmt_card, len);
+    (*ncards)++;
+}
+
+// Header cards for one cube, without END. Returns number of cards written into buf.
+int build_header_cards(char *buf, const GenParams *p, long naxis3, const char *object, double det_tmp, const char *date_obs) {
+    int n = 0;
+    char card[FITS_CARD_SIZE + 1];
+    add_card(buf, &n, "SIMPLE  =                    T / file does conform to FITS standard");
+    snprintf(card, sizeof(card), "BITPIX  = %20d / number of bits per data pixel", p->bitpix);
+    add_card(buf, &n, card);
+    add_card(buf, &n, "NAXIS   =                    3 / number of data axes");
+    snprintf(card, sizeof(card), "NAXIS1  = %20d / length of data axis 1", p->naxis1);
+    add_card(buf, &n, card);
+    snprintf(card, sizeof(card), "NAXIS2  = %20d / length of data axis 2", p->naxis2);
+    add_card(buf, &n, card);
+    snprintf(card, sizeof(card), "NAXIS3  = %20ld / length of data axis 3", naxis3);
+    add_card(buf, &n, card);
+    add_card(buf, &n, "EXTEND  =                    T / FITS dataset may contain extensions");
+    snprintf(card, sizeof(card), "DATE-OBS= '%s'         / UT date of Observation (yyyy-mm-dd)", date_obs);
+    add_card(buf, &n, card);
+    snprintf(card, sizeof(card), "DET-TMP = %20.2f / [K] Detector temperature", det_tmp);
+    add_card(buf, &n, card);
+    snprintf(card, sizeof(card), "OBJECT  = '%-8s'           / Target name", object);
+    add_card(buf, &n, card);
+    snprintf(card, sizeof(card), "EXPTIME = %20.9f / [s] Frame interval", 1.0 / p->rate);
+    add_card(buf, &n, card);
+    return n;
+}
+
+void write_header_sidecar(const char *path, const char *cards, int ncards) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return;
+    for (int i = 0; i < ncards; i++) {
+        fwrite(cards + (size_t)i * FITS_CARD_SIZE, 1, FITS_CARD_SIZE, fp);
+        fputc('\n', fp);
+    }
+    fclose(fp);
+}
+
+// FITS cube with a real header and a sparse (unwritten) data unit
+void write_sparse_fits(const char *path, const char *cards, int ncards, const GenParams *p, long naxis3) {
+    size_t hdr_len = ((size_t)(ncards + 1) * FITS_CARD_SIZE + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE;
+    char *hdr = malloc(hdr_len);
+    memset(hdr, ' ', hdr_len);
+    memcpy(hdr, cards, (size_t)ncards * FITS_CARD_SIZE);
+    memcpy(hdr + (size_t)ncards * FITS_CARD_SIZE, "END", 3);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp) {
+        fwrite(hdr, 1, hdr_len, fp);
+        fclose(fp);
+        off_t data_len = (off_t)abs(p->bitpix) / 8 * p->naxis1 * p->naxis2 * naxis3;
+        off_t total = hdr_len + (data_len + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE;
+        if (truncate(path, total) != 0) {
+            fprintf(stderr, "Warning: Failed to size %s: %s\n", path, strerror(errno));
+        }
+    }
+    free(hdr);
+}
+
+const char *OBJECTS[] = {"ABAUR", "HD163296", "HR8799", "VEGA", "BETAPIC", "SKY", "DARK", "FLAT"};
+#define NUM_OBJECTS (sizeof(OBJECTS) / sizeof(OBJECTS[0]))
+
+// One stream over one night: files_per_night consecutive files
+long generate_stream_night(const GenParams *p, int stream_idx, int night_idx, long *bytes_out) {
+    struct tm tm_val;
+    memset(&tm_val, 0, sizeof(tm_val));
+    tm_val.tm_year = p->start_year - 1900;
+    tm_val.tm_mon = p->start_month - 1;
+    tm_val.tm_mday = p->start_day + night_idx;
+    time_t day_t = timegm(&tm_val);
+    gmtime_r(&day_t, &tm_val);
+
+    char date_str[16];
+    char date_obs[16];
+    snprintf(date_str, sizeof(date_str), "%04d%02d%02d", tm_val.tm_year + 1900, tm_val.tm_mon + 1, tm_val.tm_mday);
+    snprintf(date_obs, sizeof(date_obs), "%04d-%02d-%02d", tm_val.tm_year + 1900, tm_val.tm_mon + 1, tm_val.tm_mday);
+
+    char stream_name[64];
+    snprintf(stream_name, sizeof(stream_name), "stream%02d", stream_idx);
+    char stream_dir[4096];
+    snprintf(stream_dir, sizeof(stream_dir), "%s/%s/%s", p->outdir, date_str, stream_name);
+    ensure_dir(stream_dir);
+
+    // Independent generator per (stream, night) so output does not depend on generation order
+    Rng rng;
+    rng.state = p->seed ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(stream_idx + 1)) ^ ((uint64_t)(night_idx + 1) << 40);
+    rng_next(&rng);
+
+    // Streams run at different multiples of the base rate, like WFS / science cameras
+    double rate = p->rate * (1.0 + 0.25 * stream_idx);
+    double t_acq = (double)day_t + p->night_start + 0.1 * stream_idx + rng_uniform(&rng);
+    long main_index = (long)(rng_uniform(&rng) * 1e7);
+
+    long total_frames = (long)p->files_per_night * p->frames_per_file;
+    long *change_at = calloc(p->rate_changes > 0 ? p->rate_changes : 1, sizeof(long));
+    for (int c = 0; c < p->rate_changes; c++) {
+        change_at[c] = (long)(rng_uniform(&rng) * total_frames);
+    }
+
+    int object_idx = stream_idx % NUM_OBJECTS;
+    double det_tmp = 80.0 + 10.0 * stream_idx;
+    long frame_global = 0;
+    long nfiles = 0;
+    char *cards = malloc(64 * FITS_CARD_SIZE);
+
+    for (int f = 0; f < p->files_per_night; f++) {
+        if (p->key_every > 0 && f > 0 && f % p->key_every == 0) {
+            object_idx = (object_idx + 1 + (int)(rng_uniform(&rng) * (NUM_OBJECTS - 1))) % NUM_OBJECTS;
+        }
+        det_tmp += 0.01 * rng_gauss(&rng);
+
+        double t_log0 = t_acq + 0.0003;
+        time_t t_sec = (time_t)t_log0;
+        struct tm tm_file;
+        gmtime_r(&t_sec, &tm_file);
+        char base[4096];
+        snprintf(base, sizeof(base), "%s/%s_%02d:%02d:%02d.%09ld", stream_dir, stream_name,
+                 tm_file.tm_hour, tm_file.tm_min, tm_file.tm_sec, (long)((t_log0 - (double)t_sec) * 1e9));
+
+        char path[4200];
+        snprintf(path, sizeof(path), "%s.txt", base);
+        FILE *fp = fopen(path, "w");
+        if (!fp) {
+            fprintf(stderr, "Error: Cannot create %s: %s\n", path, strerror(errno));
+            break;
+        }
+        fprintf(fp, "# Telemetry stream timing data \n");
+        fprintf(fp, "# File written by function save_telemetry_fits_function in file /home/scexao/src/milk/src/COREMOD_memory/logshmim.c\n");
+        fprintf(fp, "# \n# col1 : datacube frame index\n# col2 : Main index\n");
+        fprintf(fp, "# col3 : Time since cube origin (logging)\n# col4 : Absolute time (logging)\n");
+        fprintf(fp, "# col5 : Absolute time (acquisition)\n# col6 : stream cnt0 index\n# col7 : stream cnt1 index\n# \n");
+
+        double t_log_origin = 0.0;
+        for (long k = 0; k < p->frames_per_file; k++) {
+            for (int c = 0; c < p->rate_changes; c++) {
+                if (change_at[c] == frame_global) rate *= 0.9 + 0.2 * rng_uniform(&rng);
+            }
+            double dt = 1.0 / rate;
+            while (p->drop_prob > 0 && rng_uniform(&rng) < p->drop_prob) {
+                t_acq += dt;
+                main_index++;
+            }
+            double t_log = t_acq + 0.0003 + 0.00005 * fabs(rng_gauss(&rng));
+            if (k == 0) t_log_origin = t_log;
+            fprintf(fp, "%10ld  %10ld  %15.9f   %20.9f  %17.6f   %10ld   %10ld\n",
+                    k, main_index, t_log - t_log_origin, t_log, t_acq, main_index, 0L);
+            double step = dt * (1.0 + p->jitter * rng_gauss(&rng));
+            if (step < 0.05 * dt) step = 0.05 * dt;
+            t_acq += step;
+            main_index++;
+            frame_global++;
+        }
+        *bytes_out += ftell(fp);
+        fclose(fp);
+
+        if (p->write_header || p->write_fits) {
+            int ncards = build_header_cards(cards, p, p->frames_per_file, OBJECTS[object_idx], det_tmp, date_obs);
+            if (p->write_header) {
+                snprintf(path, sizeof(path), "%s.fits.header", base);
+                write_header_sidecar(path, cards, ncards);
+            }
+            if (p->write_fits) {
+                snprintf(path, sizeof(path), "%s.fits", base);
+                write_sparse_fits(path, cards, ncards, p, p->frames_per_file);
+            }
+        }
+        nfiles++;
+    }
+    free(cards);
+    free(change_at);
+    return nfiles;
+}
+
+void print_help(const char *progname) {
+    fprintf(stderr, "Usage: %s [options] <outdir>\n", progname);
+    fprintf(stderr, "\nGenerate a synthetic telemetry archive (see TelemetryFormat.md) in <outdir>.\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -streams <N>          Number of streams (default 2).\n");
+    fprintf(stderr, "  -nights <N>           Number of consecutive nights (default 1).\n");
+    fprintf(stderr, "  -date <YYYYMMDD>      First night (default 20251106).\n");
+    fprintf(stderr, "  -start <HH:MM:SS>     UT start time of logging each night (default 05:00:00).\n");
+    fprintf(stderr, "  -files <N>            Files per stream and night (default 100).\n");
+    fprintf(stderr, "  -frames <N>           Frames per file (default 5000).\n");
+    fprintf(stderr, "  -rate <Hz>            Base frame rate; stream i runs at rate*(1+0.25*i) (default 2000).\n");
+    fprintf(stderr, "  -jitter <f>           Interval standard deviation relative to nominal (default 0).\n");
+    fprintf(stderr, "  -drop <p>             Probability of a dropped frame (default 0).\n");
+    fprintf(stderr, "  -ratechanges <N>      Rate changes (+/-10%%) per stream and night (default 0).\n");
+    fprintf(stderr, "  -keyevery <N>         Change OBJECT keyword every N files (default 0: never).\n");
+    fprintf(stderr, "  -header               Write .fits.header sidecar files.\n");
+    fprintf(stderr, "  -fits                 Write sparse .fits cubes (header + unallocated data).\n");
+    fprintf(stderr, "  -size <W>x<H>         Frame size for headers and cubes (default 160x160).\n");
+    fprintf(stderr, "  -bitpix <B>           BITPIX for headers and cubes (default -32).\n");
+    fprintf(stderr, "  -seed <S>             Random seed (default 1).\n");
+    fprintf(stderr, "  -h, --help            Show this help message.\n");
+}
+
+int main(int argc, char *argv[]) {
+    GenParams p;
+    memset(&p, 0, sizeof(p));
+    p.num_streams = 2;
+    p.num_nights = 1;
+    p.start_year = 2025; p.start_month = 11; p.start_day = 6;
+    p.night_start = 5 * 3600.0;
+    p.files_per_night = 100;
+    p.frames_per_file = 5000;
+    p.rate = 2000.0;
+    p.naxis1 = 160;
+    p.naxis2 = 160;
+    p.bitpix = -32;
+    p.seed = 1;
+
+    int pos_arg_count = 0;
+    for (int i = 1; i < argc; i++) {
+        const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "-header") == 0) {
+            p.write_header = 1;
+        } else if (strcmp(argv[i], "-fits") == 0) {
+            p.write_fits = 1;
+        } else if (argv[i][0] == '-' && !next) {
+            fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+            return 1;
+        } else if (strcmp(argv[i], "-streams") == 0) {
+            p.num_streams = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-nights") == 0) {
+            p.num_nights = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-date") == 0) {
+            if (sscanf(argv[++i], "%4d%2d%2d", &p.start_year, &p.start_month, &p.start_day) != 3) {
+                fprintf(stderr, "Error: Invalid date %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-start") == 0) {
+            int hh = 0, mm = 0, ss = 0;
+            if (sscanf(argv[++i], "%d:%d:%d", &hh, &mm, &ss) < 1) {
+                fprintf(stderr, "Error: Invalid start time %s\n", argv[i]);
+                return 1;
+            }
+            p.night_start = hh * 3600.0 + mm * 60.0 + ss;
+        } else if (strcmp(argv[i], "-files") == 0) {
+            p.files_per_night = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-frames") == 0) {
+            p.frames_per_file = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-rate") == 0) {
+            p.rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-jitter") == 0) {
+            p.jitter = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-drop") == 0) {
+            p.drop_prob = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-ratechanges") == 0) {
+            p.rate_changes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-keyevery") == 0) {
+            p.key_every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-size") == 0) {
+            if (sscanf(argv[++i], "%dx%d", &p.naxis1, &p.naxis2) != 2) {
+                fprintf(stderr, "Error: Invalid size %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-bitpix") == 0) {
+            p.bitpix = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0) {
+            p.seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            if (pos_arg_count == 0) strncpy(p.outdir, argv[i], sizeof(p.outdir) - 1);
+            pos_arg_count++;
+        }
+    }
+
+    if (pos_arg_count < 1) {
+        print_help(argv[0]);
+        return 1;
+    }
+    if (p.rate <= 0 || p.frames_per_file <= 0 || p.files_per_night < 0 || p.num_streams < 0 || p.num_nights < 0) {
+        fprintf(stderr, "Error: Invalid parameters\n");
+        return 1;
+    }
+    if (p.bitpix != 8 && p.bitpix != 16 && p.bitpix != 32 && p.bitpix != -32 && p.bitpix != -64) {
+        fprintf(stderr, "Error: Unsupported BITPIX %d\n", p.bitpix);
+        return 1;
+    }
+
+    long nfiles = 0;
+    long bytes = 0;
+    for (int n = 0; n < p.num_nights; n++) {
+        for (int s = 0; s < p.num_streams; s++) {
+            nfiles += generate_stream_night(&p, s, n, &bytes);
+        }
+    }
+    printf("Generated %ld timing files (%.1f MB) for %d streams over %d nights in %s\n",
+           nfiles, bytes / 1e6, p.num_streams, p.num_nights, p.outdir);
+    return 0;
+}
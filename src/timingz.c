@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Compressed timing files: <name>.txt.gz and <name>.txt.zst stand for <name>.txt. They are
+// decompressed in chunks, straight into the timing parser (or behind a stdio stream for the
+// line readers), without temporary files. Summary caches are keyed by the uncompressed
+// name, so that a night keeps its caches when its timing files are compressed.
+
+#define TIMINGZ_CHUNK 65536
+
+typedef struct {
+    int type;
+    const char *path;
+    int fd;                   // -1 when decompressing from memory
+    char *mem;                // whole compressed file (read ahead), owned
+    unsigned char *in;        // compressed input: chunk buffer, or mem
+    size_t in_len;
+    size_t in_pos;
+    int eof;                  // no more input to read
+    int error;
+    int ended;                // the last gzip member / zstd frame is complete
+    long raw_bytes;           // compressed bytes read
+#ifdef HAVE_ZLIB
+    z_stream z;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zs;
+#endif
+} TimingZ;
+
+// Suffix of a timing file name, of length len
+int timing_compression(const char *name, size_t len) {
+    if (len > 4 && memcmp(name + len - 4, ".txt", 4) == 0) return TIMING_TXT;
+    if (len > 7 && memcmp(name + len - 7, ".txt.gz", 7) == 0) return TIMING_GZ;
+    if (len > 8 && memcmp(name + len - 8, ".txt.zst", 8) == 0) return TIMING_ZST;
+    return TIMING_NONE;
+}
+
+// Length of <path> without its .txt[.gz|.zst] suffix (".txt" assumed for other names)
+size_t timing_stem_len(const char *path) {
+    size_t len = strlen(path);
+    int type = timing_compression(path, len);
+    size_t suffix = (type == TIMING_GZ) ? 7 : (type == TIMING_ZST) ? 8 : 4;
+    return len >= suffix ? len - suffix : 0;
+}
+
+// Uncompressed name of a timing file, used for its summary cache entries
+void timing_cache_key_path(const char *path, char *out, size_t size) {
+    snprintf(out, size, "%.*s.txt", (int)timing_stem_len(path), path);
+}
+
+void timingz_warn_unsupported(int type) {
+    static int warned[TIMING_ZST + 1];
+    if (warned[type]) return;
+    warned[type] = 1;
+    fprintf(stderr, "Warning: Built without %s support, %s timing files are skipped\n",
+            type == TIMING_GZ ? "zlib" : "zstd", type == TIMING_GZ ? ".txt.gz" : ".txt.zst");
+}
+
+void timingz_close(TimingZ *tz) {
+    if (!tz) return;
+#ifdef HAVE_ZLIB
+    if (tz->type == TIMING_GZ) inflateEnd(&tz->z);
+#endif
+#ifdef HAVE_ZSTD
+    if (tz->type == TIMING_ZST) ZSTD_freeDStream(tz->zs);
+#endif
+    if (tz->fd >= 0) close(tz->fd);
+    if (!tz->mem) free(tz->in);
+    free(tz->mem);
+    free(tz);
+}
+
+// Decompressor of <path> (type TIMING_GZ or TIMING_ZST), reading the file, or mem if not
+// NULL (taken over). Returns NULL if the file cannot be opened or the format is not built in.
+TimingZ *timingz_open(const char *path, int type, char *mem, size_t mem_len) {
+#ifndef HAVE_ZLIB
+    if (type == TIMING_GZ) {
+        timingz_warn_unsupported(type);
+        free(mem);
+        return NULL;
+    }
+#endif
+#ifndef HAVE_ZSTD
+    if (type == TIMING_ZST) {
+        timingz_warn_unsupported(type);
+        free(mem);
+        return NULL;
+    }
+#endif
+    TimingZ *tz = calloc(1, sizeof(TimingZ));
+    tz->type = type;
+    tz->path = path;
+    tz->fd = -1;
+    if (mem) {
+        tz->mem = mem;
+        tz->in = (unsigned char *)mem;
+        tz->in_len = mem_len;
+        tz->eof = 1;
+        tz->raw_bytes = (long)mem_len;
+    } else {
+        tz->fd = open(path, O_RDONLY);
+        if (tz->fd < 0) {
+            free(tz);
+            return NULL;
+        }
+        PROF_COUNT(files_opened, 1);
+        tz->in = malloc(TIMINGZ_CHUNK);
+    }
+#ifdef HAVE_ZLIB
+    if (type == TIMING_GZ && inflateInit2(&tz->z, 15 + 32) != Z_OK) tz->error = 1; // gzip or zlib header
+#endif
+#ifdef HAVE_ZSTD
+    if (type == TIMING_ZST) tz->zs = ZSTD_createDStream();
+    if (type == TIMING_ZST && (!tz->zs || ZSTD_isError(ZSTD_initDStream(tz->zs)))) tz->error = 1;
+#endif
+    return tz;
+}
+
+void timingz_fill(TimingZ *tz) {
+    ssize_t nr = read(tz->fd, tz->in, TIMINGZ_CHUNK);
+    if (nr <= 0) {
+        tz->eof = 1;
+        nr = 0;
+    }
+    PROF_COUNT(bytes_read, nr);
+    tz->raw_bytes += nr;
+    tz->in_len = (size_t)nr;
+    tz->in_pos = 0;
+}
+
+// Decompressed bytes into out: > 0, 0 at the end of the file, -1 on corrupt or truncated
+// input (the file ends within a gzip member or zstd frame)
+ssize_t timingz_read(TimingZ *tz, char *out, size_t size) {
+    const char *problem = "Corrupt";
+    while (!tz->error) {
+        if (tz->in_pos == tz->in_len && !tz->eof) timingz_fill(tz);
+        size_t in_before = tz->in_pos;
+        size_t produced = 0;
+#ifdef HAVE_ZLIB
+        if (tz->type == TIMING_GZ) {
+            tz->z.next_in = tz->in + tz->in_pos;
+            tz->z.avail_in = (uInt)(tz->in_len - tz->in_pos);
+            tz->z.next_out = (Bytef *)out;
+            tz->z.avail_out = (uInt)size;
+            int ret = inflate(&tz->z, Z_NO_FLUSH);
+            tz->in_pos = tz->in_len - tz->z.avail_in;
+            produced = size - tz->z.avail_out;
+            if (ret == Z_STREAM_END) {
+                inflateReset(&tz->z); // concatenated gzip members
+                tz->ended = 1;
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                tz->error = 1;
+            } else if (produced > 0 || tz->in_pos != in_before) {
+                tz->ended = 0;
+            }
+        }
+#endif
+#ifdef HAVE_ZSTD
+        if (tz->type == TIMING_ZST) {
+            ZSTD_inBuffer in = { tz->in, tz->in_len, tz->in_pos };
+            ZSTD_outBuffer ob = { out, size, 0 };
+            size_t ret = ZSTD_decompressStream(tz->zs, &ob, &in);
+            if (ZSTD_isError(ret)) tz->error = 1;
+            tz->in_pos = in.pos;
+            produced = ob.pos;
+            if (ret == 0) tz->ended = 1; // frame decoded and flushed
+            else if (produced > 0 || tz->in_pos != in_before) tz->ended = 0;
+        }
+#endif
+        if (produced > 0) return (ssize_t)produced;
+        if (tz->error) break;
+        if (tz->in_pos == in_before && tz->in_pos == tz->in_len && tz->eof) {
+            if (tz->ended) return 0;
+            tz->error = 1;
+            problem = "Truncated";
+        }
+    }
+    fprintf(stderr, "Warning: %s compressed timing file %s\n", problem, tz->path);
+    return -1;
+}
+
+ssize_t timingz_cookie_read(void *cookie, char *buf, size_t size) {
+    return timingz_read((TimingZ *)cookie, buf, size);
+}
+
+int timingz_cookie_close(void *cookie) {
+    timingz_close((TimingZ *)cookie);
+    return 0;
+}
+
+// Timing file as a text stream, decompressed on the fly if needed; close with timing_fclose
+FILE *timing_fopen(const char *path) {
+    int type = timing_compression(path, strlen(path));
+    if (type != TIMING_GZ && type != TIMING_ZST) {
+        FILE *fp = fopen(path, "r");
+        if (fp) PROF_COUNT(files_opened, 1);
+        return fp;
+    }
+    TimingZ *tz = timingz_open(path, type, NULL, 0);
+    if (!tz) return NULL;
+    cookie_io_functions_t io = { timingz_cookie_read, NULL, NULL, timingz_cookie_close };
+    FILE *fp = fopencookie(tz, "r", io);
+    if (!fp) timingz_close(tz);
+    return fp;
+}
+
+void timing_fclose(FILE *fp) {
+    // Plain files: bytes consumed (compressed streams count their reads and cannot tell)
+    long pos = ftell(fp);
+    if (pos > 0) PROF_COUNT(bytes_read, pos);
+    fclose(fp);
+}
+
+// Feeds timing file <path> to p, decompressing it in chunks if needed. buf: the whole file
+// when it was read ahead (freed here), NULL to read it. Returns the number of bytes of the
+// file as stored (compressed), or -1 if it cannot be read, or is corrupt or truncated.
+long timing_parser_read_file(TimingParser *p, const char *path, char *buf, size_t len) {
+    int type = timing_compression(path, strlen(path));
+    if (type == TIMING_GZ || type == TIMING_ZST) {
+        TimingZ *tz = timingz_open(path, type, buf, len);
+        if (!tz) return -1;
+        char out[65536];
+        ssize_t nr;
+        while ((nr = timingz_read(tz, out, sizeof(out))) > 0) timing_parser_feed(p, out, nr);
+        long bytes = nr < 0 ? -1 : tz->raw_bytes;
+        timingz_close(tz);
+        return bytes;
+    }
+
+    if (buf) {
+        timing_parser_feed(p, buf, len);
+        free(buf);
+        return (long)len;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    PROF_COUNT(files_opened, 1);
+    long bytes = 0;
+    char chunk[65536];
+    ssize_t nr;
+    while ((nr = read(fd, chunk, sizeof(chunk))) > 0) {
+        PROF_COUNT(bytes_read, nr);
+        bytes += nr;
+        timing_parser_feed(p, chunk, nr);
+    }
+    close(fd);
+    return bytes;
+}
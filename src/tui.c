@@ -0,0 +1,374 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <termios.h>
+#include <signal.h>
+
+// Interactive timeline (-tui). The summaries of all files in the loaded range are kept in
+// memory and re-binned on every key: frames per bin are counted between bin edges by frame
+// index (constant rate) or binary search (raw timestamps), so the cost of a redraw depends
+// on the number of files and bins in view, not on the number of frames.
+
+#define TUI_MIN_SPAN 1e-3 // seconds
+#define TUI_PAN_FRACTION 0.125
+
+typedef struct {
+    FileSummary *summaries; // in file (time) order
+    int count;
+    int hidden;
+} TuiStream;
+
+typedef struct {
+    StreamList *streams;
+    TuiStream *index;
+    double t_min; // loaded range
+    double t_max;
+    double t0; // view
+    double t1;
+    int selected;
+    int show_keys;
+    int width;
+    double render_ms;
+    char message[256];
+} TuiState;
+
+volatile sig_atomic_t g_tui_signal = 0;
+
+void tui_signal_handler(int sig) {
+    g_tui_signal = sig;
+}
+
+// First frame index in [lo, hi) with time >= t (hi if none)
+long tui_first_frame_at(const FileSummary *fs, double t, long lo, long hi) {
+    if (fs->is_constant) {
+        double dt = (fs->end - fs->start) / (fs->count > 1 ? fs->count - 1 : 1);
+        if (dt <= 0) return (fs->start >= t) ? lo : hi;
+        double k = ceil((t - fs->start) / dt);
+        if (k < lo) return lo;
+        if (k > hi) return hi;
+        return (long)k;
+    }
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (fs->timestamps[mid] < t) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// Adds the frames of one file within [t0, t1] to bins; returns the number of frames added
+long tui_bin_summary(const FileSummary *fs, double t0, double t1, int num_bins, int *bins) {
+    long first, last;
+    if (!summary_frame_range(fs, t0, t1, &first, &last)) return 0;
+    double width = (t1 - t0) / num_bins;
+    int b0 = time_to_bin(summary_frame_time(fs, first), t0, t1, num_bins);
+    int b1 = time_to_bin(summary_frame_time(fs, last), t0, t1, num_bins);
+    long k = first;
+    for (int b = b0; b <= b1 && k <= last; b++) {
+        long k_end = (b == b1) ? last + 1 : tui_first_frame_at(fs, t0 + (b + 1) * width, k, last + 1);
+        // Frames right at the edge: follow time_to_bin, as bin_summary does
+        while (k_end <= last && time_to_bin(summary_frame_time(fs, k_end), t0, t1, num_bins) <= b) k_end++;
+        while (k_end > k && time_to_bin(summary_frame_time(fs, k_end - 1), t0, t1, num_bins) > b) k_end--;
+        bins[b] += k_end - k;
+        k = k_end;
+    }
+    return last - first + 1;
+}
+
+void tui_terminal_size(int *rows, int *cols) {
+    struct winsize w;
+    *rows = 24;
+    *cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) != -1 && w.ws_row > 0 && w.ws_col > 0) {
+        *rows = w.ws_row;
+        *cols = w.ws_col;
+    }
+}
+
+int tui_key_rows(const TuiState *st, const Stream *s) {
+    if (!st->show_keys) return 0;
+    int rows = 0;
+    for (int k = 0; k < kscan_ctx.tracked_count; k++) {
+        if (strcmp(kscan_ctx.tracked_keys[k].stream_name, s->name) == 0) rows++;
+    }
+    return rows;
+}
+
+void tui_render(TuiState *st) {
+    double t_render = get_current_time();
+    int rows, cols;
+    tui_terminal_size(&rows, &cols);
+
+    int max_name_len = 10;
+    for (int i = 0; i < st->streams->count; i++) {
+        int len = strlen(st->streams->streams[i].name);
+        if (len > max_name_len) max_name_len = len;
+    }
+    int max_count_len = 9;
+    // "> " + Name + "   " + Count + "   " + " 123.4 Hz "
+    int prefix_width = 2 + max_name_len + 3 + max_count_len + 3 + 10 + 1;
+    int timeline_width = cols - prefix_width - 1;
+    if (timeline_width < 10) timeline_width = 10;
+
+    // Re-bin visible streams over the view
+    for (int i = 0; i < st->streams->count; i++) {
+        Stream *s = &st->streams->streams[i];
+        if (st->width != timeline_width) {
+            free(s->bins);
+            s->bins = malloc(timeline_width * sizeof(int));
+        }
+        memset(s->bins, 0, timeline_width * sizeof(int));
+        s->max_bin_count = 0;
+        s->total_frames = 0;
+        if (st->index[i].hidden) continue;
+        for (int j = 0; j < st->index[i].count; j++) {
+            const FileSummary *fs = &st->index[i].summaries[j];
+            if (fs->count <= 0 || fs->end < st->t0 || fs->start > st->t1) continue;
+            s->total_frames += tui_bin_summary(fs, st->t0, st->t1, timeline_width, s->bins);
+        }
+        for (int b = 0; b < timeline_width; b++) {
+            if (s->bins[b] > s->max_bin_count) s->max_bin_count = s->bins[b];
+        }
+    }
+    st->width = timeline_width;
+
+    char *frame = NULL;
+    size_t frame_len = 0;
+    FILE *out = open_memstream(&frame, &frame_len);
+    char start_str[64], end_str[64];
+    format_time_iso(st->t0, start_str, sizeof(start_str));
+    format_time_iso(st->t1, end_str, sizeof(end_str));
+    double dt_per_char = (st->t1 - st->t0) / timeline_width;
+    fprintf(out, "\033[H\033[J" BOLD_COLOR "Start: %s  End: %s  Span: %.3f s  Bin: %.6f s" RESET_COLOR "  (redraw %.2f ms)\n",
+            start_str, end_str, st->t1 - st->t0, dt_per_char, st->render_ms);
+    render_time_axis(out, prefix_width, st->t0, st->t1, timeline_width);
+
+    // Scroll so that the selected stream is visible
+    int available = rows - 4;
+    int first = 0;
+    int used = 0;
+    for (int i = st->selected; i >= 0; i--) {
+        used += 1 + tui_key_rows(st, &st->streams->streams[i]);
+        if (used > available) break;
+        first = i;
+    }
+    used = 0;
+    for (int i = first; i < st->streams->count; i++) {
+        Stream *s = &st->streams->streams[i];
+        int height = 1 + tui_key_rows(st, s);
+        if (used + height > available) break;
+        used += height;
+        fputs(i == st->selected ? "> " : "  ", out);
+        if (st->index[i].hidden) {
+            fprintf(out, "%-*s   (hidden)\n", max_name_len, s->name);
+            continue;
+        }
+        render_stream_row(out, s, max_name_len, max_count_len, dt_per_char, timeline_width);
+        for (int k = 0; st->show_keys && k < kscan_ctx.tracked_count; k++) {
+            TrackedKey *tk = &kscan_ctx.tracked_keys[k];
+            if (strcmp(tk->stream_name, s->name) != 0) continue;
+            char *key_line = malloc(timeline_width + 1);
+            if (!build_key_line(tk, st->t0, st->t1, timeline_width, key_line)) memset(key_line, ' ', timeline_width);
+            fprintf(out, "%*s %s\n", prefix_width, tk->key, key_line);
+            free(key_line);
+        }
+    }
+    for (; used < available; used++) fputc('\n', out);
+    fprintf(out, "\033[7m \u2190\u2192 pan  \u2191\u2193 select  +/- zoom  space hide  a all  w keys  r reset  c copy  q quit \033[0m %s",
+            st->message);
+    fclose(out);
+
+    ssize_t done = 0;
+    while (done < (ssize_t)frame_len) {
+        ssize_t nw = write(STDOUT_FILENO, frame + done, frame_len - done);
+        if (nw <= 0) break;
+        done += nw;
+    }
+    free(frame);
+    st->render_ms = (get_current_time() - t_render) * 1e3;
+}
+
+// View as UT arguments (whole seconds, enclosing the view)
+void tui_range_args(const TuiState *st, char *out, size_t size) {
+    char start_str[64], end_str[64];
+    format_time_iso(floor(st->t0), start_str, sizeof(start_str));
+    format_time_iso(ceil(st->t1), end_str, sizeof(end_str));
+    snprintf(out, size, "%s %s", start_str, end_str);
+}
+
+// Copies text to the terminal clipboard (OSC 52, supported by most terminal emulators)
+void tui_copy(const char *text) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char buf[512];
+    size_t len = strlen(text);
+    size_t n = snprintf(buf, sizeof(buf), "\033]52;c;");
+    for (size_t i = 0; i < len && n + 5 < sizeof(buf); i += 3) {
+        unsigned v = (unsigned char)text[i] << 16;
+        if (i + 1 < len) v |= (unsigned char)text[i + 1] << 8;
+        if (i + 2 < len) v |= (unsigned char)text[i + 2];
+        buf[n++] = b64[(v >> 18) & 63];
+        buf[n++] = b64[(v >> 12) & 63];
+        buf[n++] = (i + 1 < len) ? b64[(v >> 6) & 63] : '=';
+        buf[n++] = (i + 2 < len) ? b64[v & 63] : '=';
+    }
+    buf[n++] = '\a';
+    if (write(STDOUT_FILENO, buf, n) < 0) return;
+}
+
+void tui_set_view(TuiState *st, double center, double span) {
+    double full = st->t_max - st->t_min;
+    if (span > full) span = full;
+    if (span < TUI_MIN_SPAN) span = TUI_MIN_SPAN;
+    st->t0 = center - span / 2;
+    st->t1 = center + span / 2;
+    if (st->t0 < st->t_min) {
+        st->t1 += st->t_min - st->t0;
+        st->t0 = st->t_min;
+    }
+    if (st->t1 > st->t_max) {
+        st->t0 -= st->t1 - st->t_max;
+        st->t1 = st->t_max;
+    }
+}
+
+// Zoom and pan over the streams of [tstart, tend], whose files were found by discovery.
+// Returns 0 on normal exit. The last view is printed as UT arguments on exit.
+int tui_run(StreamList *streams, double tstart, double tend) {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "Error: -tui requires a terminal\n");
+        return 1;
+    }
+
+    // In-memory index: summaries of every file, loaded once
+    TuiState st;
+    memset(&st, 0, sizeof(st));
+    st.streams = streams;
+    st.index = calloc(streams->count > 0 ? streams->count : 1, sizeof(TuiStream));
+    long nfiles = 0;
+    for (int i = 0; i < streams->count; i++) {
+        Stream *s = &streams->streams[i];
+        st.index[i].summaries = calloc(s->file_count > 0 ? s->file_count : 1, sizeof(FileSummary));
+        st.index[i].count = s->file_count;
+        for (int j = 0; j < s->file_count; j++) get_file_data(s->files[j].path, &st.index[i].summaries[j]);
+        nfiles += s->file_count;
+    }
+    flush_binary_cache();
+    st.t_min = st.t0 = tstart;
+    st.t_max = st.t1 = tend;
+    st.show_keys = (kscan_ctx.tracked_count > 0);
+    snprintf(st.message, sizeof(st.message), "%ld files in memory", nfiles);
+
+    struct termios saved, raw;
+    tcgetattr(STDIN_FILENO, &saved);
+    raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+    // No SA_RESTART: a resize or interrupt wakes up the blocking read
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = tui_signal_handler;
+    sigaction(SIGWINCH, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("\033[?1049h\033[?25l\033[?7l"); // alternate screen, hide cursor, clip long lines
+    fflush(stdout);
+
+    int running = 1;
+    while (running) {
+        tui_render(&st);
+        st.message[0] = '\0';
+
+        unsigned char key[8];
+        ssize_t n = read(STDIN_FILENO, key, sizeof(key));
+        if (n < 0 && errno == EINTR) {
+            if (g_tui_signal == SIGINT || g_tui_signal == SIGTERM) break;
+            g_tui_signal = 0;
+            continue; // resized
+        }
+        if (n <= 0) break;
+
+        int code = key[0];
+        if (n >= 3 && key[0] == 27 && key[1] == '[') {
+            if (key[2] == 'A') code = 'k';
+            else if (key[2] == 'B') code = 'j';
+            else if (key[2] == 'C') code = 'l';
+            else if (key[2] == 'D') code = 'h';
+            else code = 0;
+        } else if (n > 1) {
+            code = 0;
+        }
+
+        double center = (st.t0 + st.t1) / 2;
+        double span = st.t1 - st.t0;
+        switch (code) {
+        case 'q':
+        case 27:
+            running = 0;
+            break;
+        case 'h':
+            tui_set_view(&st, center - span * TUI_PAN_FRACTION, span);
+            break;
+        case 'l':
+            tui_set_view(&st, center + span * TUI_PAN_FRACTION, span);
+            break;
+        case '+':
+        case '=':
+        case 'i':
+            tui_set_view(&st, center, span / 2);
+            break;
+        case '-':
+        case 'o':
+            tui_set_view(&st, center, span * 2);
+            break;
+        case 'k':
+            if (st.selected > 0) st.selected--;
+            break;
+        case 'j':
+            if (st.selected < streams->count - 1) st.selected++;
+            break;
+        case ' ':
+            if (streams->count > 0) st.index[st.selected].hidden = !st.index[st.selected].hidden;
+            break;
+        case 'a':
+            for (int i = 0; i < streams->count; i++) st.index[i].hidden = 0;
+            break;
+        case 'w':
+            st.show_keys = !st.show_keys;
+            if (kscan_ctx.tracked_count == 0) snprintf(st.message, sizeof(st.message), "no keywords (use -k)");
+            break;
+        case 'r':
+            st.t0 = st.t_min;
+            st.t1 = st.t_max;
+            break;
+        case 'c': {
+            char args[160];
+            tui_range_args(&st, args, sizeof(args));
+            tui_copy(args);
+            snprintf(st.message, sizeof(st.message), "copied: %s", args);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    printf("\033[?7h\033[?25h\033[?1049l"); // restore line wrap, cursor and screen
+    fflush(stdout);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+    signal(SIGWINCH, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    char args[160];
+    tui_range_args(&st, args, sizeof(args));
+    printf("Last view: %s\n", args);
+
+    for (int i = 0; i < streams->count; i++) {
+        for (int j = 0; j < st.index[i].count; j++) free(st.index[i].summaries[j].timestamps);
+        free(st.index[i].summaries);
+    }
+    free(st.index);
+    return 0;
+}
@@ -0,0 +1,451 @@
+#define _GNU_SOURCE
+#include "telemetry.h"
+#include <sys/wait.h>
+#include <signal.h>
+#include <limits.h>
+#include <linux/ioprio.h>
+
+// Builds the binary night caches (as written by -bcache) of whole archives ahead of
+// queries, with one worker process per night. Nights warmed by an earlier run and not
+// modified since are skipped using a checkpoint file, so an interrupted run resumes
+// where it stopped, and files already in a night cache are never parsed again.
+
+#define WARM_SAVE_INTERVAL 30.0 // seconds between intermediate saves of a night cache
+#define WARM_LOAD_POLL 5        // seconds between load average checks (-maxload)
+
+// Changes whenever timing files are added to a night: latest mtime of the stream
+// directories, and their number
+typedef struct {
+    long long mtime_ns;
+    int nstreams;
+} NightSignature;
+
+// Last completed warm of a night: the date directory and its signature at that time
+typedef struct {
+    char *date_path;
+    NightSignature signature;
+} WarmCheckpointEntry;
+
+typedef struct {
+    WarmCheckpointEntry *entries;
+    int count;
+    int capacity;
+} WarmCheckpoint;
+
+typedef struct {
+    char date[16];
+    NightSignature signature;
+    pid_t pid;
+} WarmNight;
+
+double g_warm_iolimit = 0.0; // bytes/s per worker, 0: unlimited
+volatile sig_atomic_t g_warm_stop = 0; // SIGINT/SIGTERM: save the work done and stop
+
+void warm_stop_handler(int sig) {
+    (void)sig;
+    g_warm_stop = 1;
+}
+
+void print_help(const char *progname) {
+    fprintf(stderr, "Usage: %s [options] <dir> [<YYYYMMDD> ...]\n", progname);
+    fprintf(stderr, "\nBuilds the binary night caches used by milk-streamtelemetry-scan -bcache.\n");
+    fprintf(stderr, "\nArguments:\n");
+    fprintf(stderr, "  <dir>                 Root directory for telemetry data (same as for queries).\n");
+    fprintf(stderr, "  <YYYYMMDD>            Nights to warm (default: all date directories in <dir>).\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -cacheexport          Write night caches to <dir>/<YYYYMMDD>/ instead of local cache/.\n");
+    fprintf(stderr, "  -cacheroot <dir>      Shared cache tree instead of local cache/ (as for queries).\n");
+    fprintf(stderr, "  -j <N>                Nights warmed in parallel (default: number of CPUs).\n");
+    fprintf(stderr, "  -nice <N>             CPU scheduling priority of the workers (default 10).\n");
+    fprintf(stderr, "  -ioidle               Run in the idle I/O scheduling class.\n");
+    fprintf(stderr, "  -iolimit <MB/s>       Total read bandwidth budget, shared between workers.\n");
+    fprintf(stderr, "  -maxload <L>          Do not start a night while the 1 min load average exceeds <L>.\n");
+    fprintf(stderr, "  -readahead <N>        Timing files read ahead of the parser (default 16, 0 disables).\n");
+    fprintf(stderr, "  -checkpoint <file>    Checkpoint file (default <cache root>/warm.checkpoint).\n");
+    fprintf(stderr, "  -force                Ignore the checkpoint and check every night.\n");
+    fprintf(stderr, "  -h, --help            Show this help message.\n");
+}
+
+void warm_checkpoint_set(WarmCheckpoint *cp, const char *date_path, NightSignature signature) {
+    for (int i = 0; i < cp->count; i++) {
+        if (strcmp(cp->entries[i].date_path, date_path) == 0) {
+            cp->entries[i].signature = signature;
+            return;
+        }
+    }
+    if (cp->count == cp->capacity) {
+        cp->capacity = (cp->capacity == 0) ? 64 : cp->capacity * 2;
+        cp->entries = realloc(cp->entries, cp->capacity * sizeof(WarmCheckpointEntry));
+    }
+    cp->entries[cp->count].date_path = strdup(date_path);
+    cp->entries[cp->count].signature = signature;
+    cp->count++;
+}
+
+// Lines "<mtime_ns> <nstreams> <date_path>", appended as nights complete; the last line of a night wins
+void warm_checkpoint_load(WarmCheckpoint *cp, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    char line[4200];
+    while (fgets(line, sizeof(line), fp)) {
+        NightSignature signature;
+        int offset = 0;
+        if (sscanf(line, "%lld %d %n", &signature.mtime_ns, &signature.nstreams, &offset) != 2 || offset == 0) continue;
+        line[strcspn(line, "\n")] = '\0';
+        if (line[offset] != '\0') warm_checkpoint_set(cp, line + offset, signature);
+    }
+    fclose(fp);
+}
+
+int warm_checkpoint_find(const WarmCheckpoint *cp, const char *date_path, NightSignature *signature) {
+    for (int i = 0; i < cp->count; i++) {
+        if (strcmp(cp->entries[i].date_path, date_path) == 0) {
+            *signature = cp->entries[i].signature;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void warm_checkpoint_free(WarmCheckpoint *cp) {
+    for (int i = 0; i < cp->count; i++) free(cp->entries[i].date_path);
+    free(cp->entries);
+}
+
+// The date directory's own mtime is not used, since -cacheexport writes the night cache there.
+// Returns 0 if <date_path> cannot be read.
+int night_signature(const char *date_path, NightSignature *signature) {
+    static DirList streams;
+    if (dir_list_read(&streams, date_path, NULL) < 0) return 0;
+    long long latest = 0;
+    int nstreams = 0;
+    for (int i = 0; i < streams.count; i++) {
+        if (!dir_list_is_dir(&streams, i, date_path)) continue;
+        char stream_path[4096];
+        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, dir_list_name(&streams, i));
+        struct stat st;
+        if (stat(stream_path, &st) != 0) continue;
+        long long mtime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        if (mtime > latest) latest = mtime;
+        nstreams++;
+    }
+    signature->mtime_ns = latest;
+    signature->nstreams = nstreams;
+    return 1;
+}
+
+// Sleeps while reads are ahead of the -iolimit budget
+void warm_throttle(double t_start) {
+    double ahead = g_prof.bytes_read / g_warm_iolimit - (get_current_time() - t_start);
+    if (ahead <= 0) return;
+    struct timespec ts;
+    ts.tv_sec = (time_t)ahead;
+    ts.tv_nsec = (long)((ahead - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+// Adds every timing file of <root>/<date> missing from the night cache. Runs in a worker process.
+int warm_night(const char *root, const char *date) {
+    double t_start = get_current_time();
+    char date_path[4096];
+    snprintf(date_path, sizeof(date_path), "%s/%s", root, date);
+
+    DirList streams;
+    DirList files;
+    dir_list_init(&streams);
+    dir_list_init(&files);
+    if (dir_list_read(&streams, date_path, NULL) < 0) {
+        fprintf(stderr, "Error: Cannot read %s: %s\n", date_path, strerror(errno));
+        return 1;
+    }
+
+    char **paths = NULL;
+    int npaths = 0;
+    int capacity = 0;
+    int nstreams = 0;
+    for (int i = 0; i < streams.count; i++) {
+        if (!dir_list_is_dir(&streams, i, date_path)) continue;
+        char stream_path[4096];
+        snprintf(stream_path, sizeof(stream_path), "%s/%s", date_path, dir_list_name(&streams, i));
+        int n = dir_list_read(&files, stream_path, TIMING_SUFFIXES);
+        if (n <= 0) continue;
+        nstreams++;
+        for (int k = 0; k < n; k++) {
+            if (npaths == capacity) {
+                capacity = (capacity == 0) ? 1024 : capacity * 2;
+                paths = realloc(paths, capacity * sizeof(char *));
+            }
+            char filepath[8192];
+            snprintf(filepath, sizeof(filepath), "%s/%s", stream_path, dir_list_name(&files, k));
+            paths[npaths++] = strdup(filepath);
+        }
+    }
+    dir_list_free(&streams);
+    dir_list_free(&files);
+
+    int ret = 0;
+    int nmissing = 0;
+    long frames = 0;
+    if (npaths > 0) {
+        char bcache_path[8192];
+        binary_cache_path_for(paths[0], bcache_path, sizeof(bcache_path));
+        if (!g_cache_export) ensure_path_exists(bcache_path);
+        load_binary_cache(bcache_path);
+
+        // Look up every file before adding any: appended entries are not in key order
+        char **missing = malloc(npaths * sizeof(char *));
+        for (int k = 0; k < npaths; k++) {
+            char key_path[4096];
+            timing_cache_key_path(paths[k], key_path, sizeof(key_path));
+            if (!find_in_binary_cache(binary_cache_key(key_path))) missing[nmissing++] = paths[k];
+        }
+
+        // No read-ahead when the timing files can be probed from a few records
+        int want_readahead = nmissing > 0 && g_readahead_depth > 0 && timing_readahead_wanted(missing[0]);
+        g_readahead = want_readahead ? readahead_create(missing, nmissing, g_readahead_depth) : NULL;
+        double t_save = get_current_time();
+        for (int k = 0; k < nmissing; k++) {
+            if (g_warm_stop) {
+                ret = 1; // incomplete, not checkpointed
+                nmissing = k;
+                break;
+            }
+            FileSummary summary;
+            get_file_data(missing[k], &summary);
+            frames += summary.count;
+            free(summary.timestamps);
+            if (g_warm_iolimit > 0) warm_throttle(t_start);
+
+            // Keep the work done so far if the run is interrupted
+            if (get_current_time() - t_save > WARM_SAVE_INTERVAL) {
+                if (save_binary_cache(g_binary_cache) < 0) {
+                    fprintf(stderr, "Warning: Failed to write binary cache %s: %s\n", bcache_path, strerror(errno));
+                }
+                t_save = get_current_time();
+            }
+        }
+        readahead_destroy(g_readahead);
+        g_readahead = NULL;
+
+        if (g_binary_cache->dirty && save_binary_cache(g_binary_cache) < 0) {
+            fprintf(stderr, "Error: Failed to write binary cache %s: %s\n", bcache_path, strerror(errno));
+            ret = 1;
+        }
+        free_binary_cache(g_binary_cache);
+        g_binary_cache = NULL;
+        free(missing);
+    }
+
+    printf("%s: %d streams, %d files, %d summarized (%ld frames, %.1f MB read), %.3f s\n",
+           date, nstreams, npaths, nmissing, frames, g_prof.bytes_read / 1e6, get_current_time() - t_start);
+    fflush(stdout);
+    for (int k = 0; k < npaths; k++) free(paths[k]);
+    free(paths);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    char *root_dir = NULL;
+    char checkpoint_path[4096] = "";
+    int shared_cache = 0;
+    char root_real[PATH_MAX];
+    int jobs = 0;
+    int nice_value = 10;
+    int io_idle = 0;
+    double max_load = 0.0;
+    int force = 0;
+    char **dates = malloc(argc * sizeof(char *));
+    int ndates = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "-cacheexport") == 0) {
+            g_cache_export = 1;
+        } else if (strcmp(argv[i], "-ioidle") == 0) {
+            io_idle = 1;
+        } else if (strcmp(argv[i], "-force") == 0) {
+            force = 1;
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "-nice") == 0 || strcmp(argv[i], "-iolimit") == 0 ||
+                   strcmp(argv[i], "-maxload") == 0 || strcmp(argv[i], "-readahead") == 0 ||
+                   strcmp(argv[i], "-checkpoint") == 0 || strcmp(argv[i], "-cacheroot") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+                return 1;
+            }
+            const char *opt = argv[i];
+            const char *val = argv[++i];
+            if (strcmp(opt, "-j") == 0) jobs = atoi(val);
+            else if (strcmp(opt, "-nice") == 0) nice_value = atoi(val);
+            else if (strcmp(opt, "-iolimit") == 0) g_warm_iolimit = atof(val) * 1e6;
+            else if (strcmp(opt, "-maxload") == 0) max_load = atof(val);
+            else if (strcmp(opt, "-readahead") == 0) g_readahead_depth = atoi(val);
+            else if (strcmp(opt, "-checkpoint") == 0) strncpy(checkpoint_path, val, sizeof(checkpoint_path) - 1);
+            else {
+                strncpy(g_cache_root, val, sizeof(g_cache_root) - 1);
+                shared_cache = 1;
+            }
+        } else if (!root_dir) {
+            root_dir = argv[i];
+        } else if (is_date_name(argv[i])) {
+            dates[ndates++] = argv[i];
+        } else {
+            fprintf(stderr, "Error: Invalid date %s (expected YYYYMMDD)\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!root_dir) {
+        print_help(argv[0]);
+        return 1;
+    }
+    if (shared_cache) {
+        if (!realpath(root_dir, root_real)) {
+            fprintf(stderr, "Error: Cannot resolve %s: %s\n", root_dir, strerror(errno));
+            return 1;
+        }
+        root_dir = root_real;
+    }
+    if (checkpoint_path[0] == '\0') snprintf(checkpoint_path, sizeof(checkpoint_path), "%s/warm.checkpoint", g_cache_root);
+    g_num_threads = jobs;
+    jobs = get_num_threads();
+
+    // Budget, inherited by the workers
+    if (setpriority(PRIO_PROCESS, 0, nice_value) != 0) {
+        fprintf(stderr, "Warning: Failed to set priority %d: %s\n", nice_value, strerror(errno));
+    }
+    if (io_idle && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)) != 0) {
+        fprintf(stderr, "Warning: Failed to set idle I/O class: %s\n", strerror(errno));
+    }
+    g_warm_iolimit /= jobs;
+
+    // Interrupted workers save their night cache before exiting
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = warm_stop_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Nights: given on the command line, or all date directories of the archive
+    DirList root_list;
+    dir_list_init(&root_list);
+    if (ndates == 0) {
+        if (dir_list_read(&root_list, root_dir, NULL) < 0) {
+            fprintf(stderr, "Error: Cannot read %s: %s\n", root_dir, strerror(errno));
+            return 1;
+        }
+        for (int i = 0; i < root_list.count; i++) {
+            const char *name = dir_list_name(&root_list, i);
+            if (is_date_name(name) && dir_list_is_dir(&root_list, i, root_dir)) dates[ndates++] = (char *)name;
+        }
+    }
+
+    WarmCheckpoint checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    if (!force) warm_checkpoint_load(&checkpoint, checkpoint_path);
+    ensure_path_exists(checkpoint_path);
+    FILE *cp_fp = fopen(checkpoint_path, "a");
+    if (!cp_fp) {
+        fprintf(stderr, "Warning: Failed to open checkpoint %s: %s\n", checkpoint_path, strerror(errno));
+    }
+
+    // Skip nights unchanged since their last complete warm
+    WarmNight *nights = calloc(ndates > 0 ? ndates : 1, sizeof(WarmNight));
+    int nnights = 0;
+    int skipped = 0;
+    for (int i = 0; i < ndates; i++) {
+        char date_path[4096];
+        snprintf(date_path, sizeof(date_path), "%s/%s", root_dir, dates[i]);
+        NightSignature signature;
+        if (!night_signature(date_path, &signature)) {
+            fprintf(stderr, "Warning: Cannot read %s, skipped\n", date_path);
+            continue;
+        }
+        NightSignature done;
+        char bcache_path[8192];
+        night_cache_path(date_path, bcache_path, sizeof(bcache_path));
+        if (warm_checkpoint_find(&checkpoint, date_path, &done) && done.mtime_ns == signature.mtime_ns &&
+            done.nstreams == signature.nstreams && access(bcache_path, R_OK) == 0) {
+            skipped++;
+            continue;
+        }
+        strncpy(nights[nnights].date, dates[i], sizeof(nights[nnights].date) - 1);
+        nights[nnights].signature = signature;
+        nnights++;
+    }
+    printf("Warming %d nights (%d up to date) with %d workers\n", nnights, skipped, jobs);
+    fflush(stdout);
+
+    g_use_binary_cache = 1;
+    int next = 0;
+    int running = 0;
+    int failed = 0;
+    int stopping = 0;
+    while (next < nnights || running > 0) {
+        if (g_warm_stop && !stopping) {
+            // Forward to the workers (a signal sent to this process only, e.g. by timeout)
+            stopping = 1;
+            next = nnights;
+            for (int i = 0; i < nnights; i++) {
+                if (nights[i].pid > 0) kill(nights[i].pid, SIGTERM);
+            }
+            if (running == 0) break;
+        }
+        double load = 0.0;
+        int over_load = (max_load > 0 && getloadavg(&load, 1) == 1 && load > max_load);
+        if (next < nnights && running < jobs && !over_load) {
+            WarmNight *night = &nights[next++];
+            pid_t pid = fork();
+            if (pid == 0) {
+                g_profile = 1; // bytes read, for -iolimit and the night summary
+                exit(warm_night(root_dir, night->date));
+            }
+            if (pid < 0) {
+                fprintf(stderr, "Error: fork failed: %s\n", strerror(errno));
+                failed++;
+                continue;
+            }
+            night->pid = pid;
+            running++;
+            continue;
+        }
+        if (running == 0) {
+            if (g_warm_stop) break;
+            sleep(WARM_LOAD_POLL); // waiting for the load to drop
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        running--;
+        for (int i = 0; i < nnights; i++) {
+            if (nights[i].pid != pid) continue;
+            nights[i].pid = 0;
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                char date_path[4096];
+                snprintf(date_path, sizeof(date_path), "%s/%s", root_dir, nights[i].date);
+                if (cp_fp) {
+                    fprintf(cp_fp, "%lld %d %s\n", nights[i].signature.mtime_ns, nights[i].signature.nstreams, date_path);
+                    fflush(cp_fp);
+                }
+            } else if (!g_warm_stop) {
+                fprintf(stderr, "Error: Warming %s failed\n", nights[i].date);
+                failed++;
+            }
+            break;
+        }
+    }
+
+    if (g_warm_stop) printf("Interrupted, run again to resume\n");
+    else printf("Warmed %d nights, %d up to date, %d failed\n", nnights - failed, skipped, failed);
+    if (cp_fp) fclose(cp_fp);
+    warm_checkpoint_free(&checkpoint);
+    dir_list_free(&root_list);
+    free(nights);
+    free(dates);
+    return failed > 0 ? 1 : 0;
+}